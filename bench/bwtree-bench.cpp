@@ -0,0 +1,389 @@
+
+/*
+ * bwtree-bench.cpp - YCSB style multi-threaded benchmark of the BwTree
+ *
+ * Workloads (the same mixes as YCSB core workloads):
+ *   A: 50% read, 50% update
+ *   B: 95% read, 5% update
+ *   C: 100% read
+ *   D: 95% read (latest distribution), 5% insert
+ *   E: 95% short scan, 5% insert
+ *   F: 50% read, 50% read-modify-write
+ *
+ * 1. Records are loaded with HashKey() of their sequence numbers, such that
+ *    the insertion order is not the key order. Keys are chosen by sequence
+ *    number using the requested distribution and then hashed
+ * 2. The tree does not support in-place update. Update is implemented as a
+ *    delete followed by an insert of the same key, and is timed as a whole
+ * 3. Each thread runs warmup operations before the measured phase. Threads
+ *    wait for each other before the measured phase starts
+ *
+ * Usage: bwtree-bench-bin [--workload=a,b,c,d,e,f] [--threads=1,2,4]
+ *                         [--records=N] [--ops=N] [--warmup=N]
+ *                         [--dist=uniform|zipfian] [--theta=0.99]
+ *                         [--scan-length=N] [--histogram] [--stats] [--analyze]
+ *                         [--perf] [--checkpoint=path]
+ *                         [--wal=path] [--wal-interval=us] [--wal-sync=none|group]
+ *
+ * --ops and --warmup are the total number of operations of all threads. If built
+ * with LATENCY=1, latency recorded by the tree itself is also printed. --stats
+ * prints the statistics snapshot and memory usage of the tree after each run.
+ * --analyze verifies the tree after each run using the same number of threads.
+ * --perf counts hardware events of the measured phase and prints them per
+ * operation. Nothing is printed if perf_event_open() is not available.
+ * --checkpoint writes the tree into the file after each run and times reloading
+ * it into a new tree, by copying and by using the leaves in the mapped file.
+ * --wal logs inserts and deletes of the load and measured phases into a new log
+ * file, which is written by the group commit flusher every --wal-interval 
+ * microseconds (default 1000) and synced per group unless --wal-sync=none
+ */
+
+#include "bwtree/bwtree.h"
+#include "test-util.h"
+#include "bench-util.h"
+
+using namespace wangziqi2013;
+using namespace index_building_block;
+using namespace bwtree;
+
+using KeyType = uint64_t;
+using ValueType = uint64_t;
+using BwTreeType = \
+  BwTree<KeyType, ValueType, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+
+// * enum class OpType - Operation types that are timed separately
+enum class OpType : int {
+  Read = 0,
+  Update,
+  Insert,
+  Scan,
+  ReadModifyWrite,
+  Count,
+};
+
+static const char *op_name_list[] = {"read", "update", "insert", "scan", "rmw"};
+
+/*
+ * class Workload - Describes the proportion of operations
+ */
+class Workload {
+ public:
+  char name;
+  double read_ratio;
+  double update_ratio;
+  double insert_ratio;
+  double scan_ratio;
+  double rmw_ratio;
+  // If true then reads choose recently inserted records
+  bool latest;
+
+  // * Get() - Returns the workload of a given name
+  static Workload Get(char name) {
+    switch(name) {
+      case 'a': return Workload{'a', 0.50, 0.50, 0.00, 0.00, 0.00, false};
+      case 'b': return Workload{'b', 0.95, 0.05, 0.00, 0.00, 0.00, false};
+      case 'c': return Workload{'c', 1.00, 0.00, 0.00, 0.00, 0.00, false};
+      case 'd': return Workload{'d', 0.95, 0.00, 0.05, 0.00, 0.00, true};
+      case 'e': return Workload{'e', 0.00, 0.00, 0.05, 0.95, 0.00, false};
+      case 'f': return Workload{'f', 0.50, 0.00, 0.00, 0.00, 0.50, false};
+      default: err_printf("Unknown workload '%c'\n", name);
+    }
+
+    return Workload{};
+  }
+
+  // * Choose() - Maps a uniform random number in [0, 1) to an operation
+  OpType Choose(double r) const {
+    if((r -= read_ratio) < 0.0) { return OpType::Read; }
+    if((r -= update_ratio) < 0.0) { return OpType::Update; }
+    if((r -= insert_ratio) < 0.0) { return OpType::Insert; }
+    if((r -= scan_ratio) < 0.0) { return OpType::Scan; }
+    return OpType::ReadModifyWrite;
+  }
+};
+
+/*
+ * class BenchConfig - Parameters of one run
+ */
+class BenchConfig {
+ public:
+  uint64_t thread_num;
+  uint64_t record_num;
+  uint64_t op_num;
+  uint64_t warmup_num;
+  uint64_t scan_length;
+  double theta;
+  bool zipfian;
+  bool histogram;
+  bool stats;
+  bool analyze;
+  bool perf;
+  std::string checkpoint_path;
+  std::string wal_path;
+  WriteAheadLog::Config wal_config;
+};
+
+/*
+ * class ThreadResult - Per-thread histograms and hardware events
+ */
+class ThreadResult {
+ public:
+  LatencyHistogram histogram_list[static_cast<int>(OpType::Count)];
+  PerfCounter::Result perf_result;
+};
+
+/*
+ * class BenchContext - Shared state of threads in one run
+ */
+class BenchContext {
+ public:
+  BenchContext(const BenchConfig &pconfig, const Workload &pworkload, BwTreeType *ptree_p) :
+    config{pconfig}, workload{pworkload}, tree_p{ptree_p},
+    insert_seq{pconfig.record_num}, ready_num{0}, start_time{0},
+    end_time_list(pconfig.thread_num), result_list(pconfig.thread_num) {}
+
+  const BenchConfig &config;
+  const Workload &workload;
+  BwTreeType *tree_p;
+  // Sequence number of the next inserted record
+  std::atomic<uint64_t> insert_seq;
+  // Number of threads that have finished warmup
+  std::atomic<uint64_t> ready_num;
+  std::atomic<uint64_t> start_time;
+  std::vector<uint64_t> end_time_list;
+  std::vector<ThreadResult> result_list;
+};
+
+/*
+ * NextSeq() - Chooses the sequence number of an existing record
+ */
+static uint64_t NextSeq(BenchContext &context, KeyGenerator *gen_p) {
+  uint64_t record_num = context.insert_seq.load(std::memory_order_relaxed);
+  if(context.workload.latest == true) {
+    // Most recently inserted records are the most popular
+    return record_num - 1 - gen_p->Next(record_num);
+  }
+
+  return gen_p->Next(record_num);
+}
+
+/*
+ * RunOp() - Runs one operation of the given type with the thread context of the worker
+ */
+static void RunOp(BenchContext &context, OpType type, KeyGenerator *gen_p,
+                  std::vector<std::pair<KeyType, ValueType>> *scan_buffer_p, 
+                  typename BwTreeType::ThreadContext *thread_p) {
+  BwTreeType *tree_p = context.tree_p;
+  ValueType value = 0;
+  switch(type) {
+    case OpType::Read: {
+      tree_p->GetValue(HashKey(NextSeq(context, gen_p)), &value, thread_p);
+      break;
+    }
+    case OpType::Update: {
+      KeyType key = HashKey(NextSeq(context, gen_p));
+      if(tree_p->Delete(key, thread_p) == true) { tree_p->Insert(key, key + 1, thread_p); }
+      break;
+    }
+    case OpType::Insert: {
+      uint64_t seq = context.insert_seq.fetch_add(1);
+      tree_p->Insert(HashKey(seq), seq, thread_p);
+      break;
+    }
+    case OpType::Scan: {
+      scan_buffer_p->clear();
+      uint64_t length = gen_p->NextDouble() * context.config.scan_length + 1;
+      tree_p->Scan(HashKey(NextSeq(context, gen_p)), length, scan_buffer_p, DeltaVersion::LATEST, thread_p);
+      break;
+    }
+    case OpType::ReadModifyWrite: {
+      KeyType key = HashKey(NextSeq(context, gen_p));
+      if(tree_p->GetValue(key, &value, thread_p) == true && tree_p->Delete(key, thread_p) == true) {
+        tree_p->Insert(key, value + 1, thread_p);
+      }
+      break;
+    }
+    default: assert(false);
+  }
+
+  return;
+}
+
+/*
+ * WorkerThread() - Runs warmup and measured operations
+ */
+static void WorkerThread(size_t thread_id, BenchContext &context) {
+  const BenchConfig &config = context.config;
+  KeyGenerator *gen_p = nullptr;
+  if(config.zipfian == true) {
+    gen_p = new ZipfianGenerator{config.record_num, config.theta, thread_id + 1};
+  } else {
+    gen_p = new UniformGenerator{thread_id + 1};
+  }
+
+  UniformGenerator op_gen{(thread_id + 1) * 7919};
+  std::vector<std::pair<KeyType, ValueType>> scan_buffer{};
+  scan_buffer.reserve(config.scan_length + 1);
+  typename BwTreeType::ThreadContext *thread_p = context.tree_p->RegisterThread();
+
+  for(uint64_t i = 0;i < config.warmup_num / config.thread_num;i++) {
+    RunOp(context, context.workload.Choose(op_gen.NextDouble()), gen_p, &scan_buffer, thread_p);
+  }
+
+  // The last thread that finishes warmup starts the clock
+  PerfCounter perf{config.perf};
+  if(context.ready_num.fetch_add(1) + 1 == config.thread_num) {
+    context.start_time.store(Timer::GetNanoseconds());
+  }
+  while(context.ready_num.load() != config.thread_num) {}
+
+  ThreadResult &result = context.result_list[thread_id];
+  perf.Start();
+  for(uint64_t i = 0;i < config.op_num / config.thread_num;i++) {
+    OpType type = context.workload.Choose(op_gen.NextDouble());
+    uint64_t start = Timer::GetNanoseconds();
+    RunOp(context, type, gen_p, &scan_buffer, thread_p);
+    result.histogram_list[static_cast<int>(type)].Record(Timer::GetNanoseconds() - start);
+  }
+
+  context.end_time_list[thread_id] = Timer::GetNanoseconds();
+  perf.Stop();
+  result.perf_result = perf.Read();
+  context.tree_p->UnregisterThread(thread_p);
+  delete gen_p;
+  return;
+}
+
+/*
+ * LoadThread() - Inserts records whose sequence number belongs to the thread
+ */
+static void LoadThread(size_t thread_id, BenchContext &context) {
+  const BenchConfig &config = context.config;
+  for(uint64_t seq = thread_id;seq < config.record_num;seq += config.thread_num) {
+    context.tree_p->Insert(HashKey(seq), seq);
+  }
+
+  return;
+}
+
+/*
+ * RunWorkload() - Loads the tree, runs the workload and prints the result
+ */
+static void RunWorkload(const BenchConfig &config, const Workload &workload) {
+  BwTreeType *tree_p = new BwTreeType{};
+  BenchContext context{config, workload, tree_p};
+  if(config.wal_path.empty() == false) {
+    remove(config.wal_path.c_str());
+    if(tree_p->EnableLog(config.wal_path, config.wal_config) == false) { err_printf("Cannot open log \"%s\"\n", config.wal_path.c_str()); }
+  }
+
+  Timer timer{};
+  StartThread(config.thread_num, LoadThread, context);
+  double load_time = timer.GetElapsedSeconds();
+
+  StartThread(config.thread_num, WorkerThread, context);
+  uint64_t end_time = *std::max_element(context.end_time_list.begin(), context.end_time_list.end());
+  double run_time = (end_time - context.start_time.load()) / 1e9;
+  uint64_t measured = config.op_num / config.thread_num * config.thread_num;
+
+  fprintf(stdout, "workload %c threads %lu records %lu dist %s | load %.2f Mops/s | run %lu ops in %.3f s, %.3f Mops/s\n",
+          workload.name, config.thread_num, config.record_num, config.zipfian ? "zipfian" : "uniform",
+          config.record_num / load_time / 1e6, measured, run_time, measured / run_time / 1e6);
+
+  for(int type = 0;type < static_cast<int>(OpType::Count);type++) {
+    LatencyHistogram merged{};
+    for(const ThreadResult &result : context.result_list) { merged.Merge(result.histogram_list[type]); }
+    if(merged.GetCount() != 0) { merged.Print(stdout, op_name_list[type], config.histogram); }
+  }
+
+  PerfCounter::Result perf_result{};
+  for(const ThreadResult &result : context.result_list) { perf_result.Merge(result.perf_result); }
+  if(perf_result.IsAnyAvailable()) {
+    fprintf(stdout, "perf per op: ");
+    perf_result.Print(stdout, measured);
+    fprintf(stdout, "\n");
+  }
+
+  if(tree_p->GetLog() != nullptr) {
+    WriteAheadLog *log_p = tree_p->GetLog();
+    fprintf(stdout, "log records %lu; groups %lu; syncs %lu\n", 
+            log_p->GetRecordCount(), log_p->GetGroupCount(), log_p->GetSyncCount());
+    tree_p->DisableLog();
+  }
+  if(config.stats == true) { 
+    tree_p->GetStatistics().Print(stdout); 
+    tree_p->GetMemoryUsage().Print(stdout);
+  }
+  if(config.analyze == true) { 
+    Timer analyze_timer{};
+    typename BwTreeType::Analysis result = tree_p->Analyze(config.thread_num);
+    fprintf(stdout, "analyze %s in %.3f s\n", result.IsValid() ? "OK" : "FAILED", analyze_timer.GetElapsedSeconds());
+    result.Print(stdout);
+  }
+  if(config.checkpoint_path.empty() == false) {
+    Timer checkpoint_timer{};
+    if(tree_p->Checkpoint(config.checkpoint_path) == false) { err_printf("Checkpoint to \"%s\" failed\n", config.checkpoint_path.c_str()); }
+    double checkpoint_time = checkpoint_timer.GetElapsedSeconds();
+    BwTreeType *load_tree_p = new BwTreeType{};
+    checkpoint_timer.Reset();
+    if(load_tree_p->Load(config.checkpoint_path) == false) { err_printf("Load from \"%s\" failed\n", config.checkpoint_path.c_str()); }
+    double load_time = checkpoint_timer.GetElapsedSeconds();
+    BwTreeType *resident_tree_p = new BwTreeType{};
+    checkpoint_timer.Reset();
+    if(resident_tree_p->Load(config.checkpoint_path, BwTreeType::LoadMode::Resident) == false) { 
+      err_printf("Load from \"%s\" failed\n", config.checkpoint_path.c_str()); 
+    }
+    fprintf(stdout, "checkpoint %.3f s; load %.3f s; resident load %.3f s%s\n", checkpoint_time, load_time, 
+            checkpoint_timer.GetElapsedSeconds(), resident_tree_p->IsResident() ? "" : " (copied)");
+    delete load_tree_p;
+    delete resident_tree_p;
+  }
+
+#ifdef BWTREE_LATENCY
+  // Latency recorded inside the tree, including the load phase
+  fprintf(stdout, "tree internal latency:\n");
+  tree_p->PrintLatency(stdout);
+#endif
+
+  fflush(stdout);
+  delete tree_p;
+  return;
+}
+
+int main(int argc, char **argv) {
+  ArgParser parser{argc, argv};
+  std::string workload_list = parser.GetString("workload", "a,b,c,d,e,f");
+  std::vector<uint64_t> thread_list = parser.GetUIntList("threads", {1, 2, 4});
+  std::string dist = parser.GetString("dist", "zipfian");
+  if(dist != "zipfian" && dist != "uniform") { err_printf("Unknown distribution \"%s\"\n", dist.c_str()); }
+
+  BenchConfig config{};
+  config.record_num = parser.GetUInt("records", 1000000);
+  config.op_num = parser.GetUInt("ops", 1000000);
+  config.warmup_num = parser.GetUInt("warmup", 100000);
+  config.scan_length = parser.GetUInt("scan-length", 100);
+  config.theta = parser.GetDouble("theta", ZipfianGenerator::DEFAULT_THETA);
+  config.zipfian = dist == "zipfian";
+  config.histogram = parser.Has("histogram");
+  config.stats = parser.Has("stats");
+  config.analyze = parser.Has("analyze");
+  config.perf = parser.Has("perf");
+  config.checkpoint_path = parser.GetString("checkpoint", "");
+  config.wal_path = parser.GetString("wal", "");
+  config.wal_config.flush_interval_us = parser.GetUInt("wal-interval", config.wal_config.flush_interval_us);
+  std::string wal_sync = parser.GetString("wal-sync", "group");
+  if(wal_sync != "none" && wal_sync != "group") { err_printf("Unknown log sync mode \"%s\"\n", wal_sync.c_str()); }
+  config.wal_config.sync_mode = wal_sync == "none" ? WriteAheadLog::SyncMode::None : WriteAheadLog::SyncMode::Group;
+  always_assert(config.record_num > 1 && config.scan_length > 0);
+
+  for(uint64_t thread_num : thread_list) {
+    always_assert(thread_num > 0);
+    config.thread_num = thread_num;
+    for(char name : workload_list) {
+      if(name == ',') { continue; }
+      RunWorkload(config, Workload::Get(static_cast<char>(tolower(name))));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,462 @@
+
+/*
+ * bwtree-microbench.cpp - Microbenchmarks of BwTree building blocks in isolation
+ *
+ * Each block is measured without the rest of the tree, such that a regression
+ * can be attributed to a specific block:
+ *   mapping_table:  AllocateNodeID() and CAS() under contention
+ *   append_helper:  AppendLeafInsert() per chain height, and under contention
+ *   traverser:      DeltaChainTraverser driving the ValueSearcher per chain height
+ *   consolidator:   DefaultConsolidator per chain height and base node size
+ *   base_node:      DefaultBaseNode::Search() and PointSearch() per node size
+ *   huge_page:      Random mapping table lookups and node accesses per huge page mode
+ *
+ * Usage: bwtree-microbench-bin [--format=csv|json] [--block=name,name]
+ *                              [--threads=1,2,4] [--ops=N] [--perf]
+ *
+ * Results are written to stdout in the format of BenchReport. --ops is the
+ * approximate number of operations of each row. --perf adds hardware event
+ * counts per operation, which are only counted in the timed sections
+ */
+
+#include "bwtree/bwtree.h"
+#include "test-util.h"
+#include "bench-util.h"
+
+using namespace wangziqi2013;
+using namespace index_building_block;
+using namespace bwtree;
+
+using KeyType = uint64_t;
+using ValueType = uint64_t;
+using BwTreeType = \
+  BwTree<KeyType, ValueType, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+using NodeIDType = typename BwTreeType::NodeIDType;
+using NodeSizeType = typename BwTreeType::NodeSizeType;
+using NodeBaseType = typename BwTreeType::NodeBaseType;
+using BoundKeyType = typename BwTreeType::BoundKeyType;
+using DeltaChainType = typename BwTreeType::DeltaChainType;
+using MappingTableType = typename BwTreeType::MappingTableType;
+using LeafBaseType = typename BwTreeType::LeafBaseType;
+using LeafInsertType = typename BwTreeType::LeafInsertType;
+using AppendHelperType = typename BwTreeType::AppendHelperType;
+using FreeTraverserType = typename BwTreeType::FreeTraverserType;
+using DeltaChainFreeHelperType = typename BwTreeType::DeltaChainFreeHelperType;
+using ValueSearcherType = typename BwTreeType::ValueSearcherType;
+using ValueSearchTraverserType = typename BwTreeType::ValueSearchTraverserType;
+
+// The consolidator is instanciated with a larger threshold than the tree
+// such that chain heights above the tree's threshold can be measured
+static constexpr size_t MAX_CHAIN_HEIGHT = 256;
+using ConsolidatorType = \
+  DefaultConsolidator<KeyType, ValueType, NodeIDType, DeltaChainType, DefaultBaseNode, MAX_CHAIN_HEIGHT>;
+using ConsolidationTraverserType = \
+  DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, DefaultBaseNode, ConsolidatorType>;
+
+// Parameters of the benchmarks
+static const std::vector<uint64_t> chain_height_list = {0, 1, 2, 4, 8, 16, 24, 32, 64, 128, 256};
+static const std::vector<uint64_t> node_size_list = {16, 32, 64, 128, 256, 512, 1024};
+// Total number of deltas appended to a node before the chain is freed (fits in NodeHeightType)
+static constexpr uint64_t CONTENDED_CHAIN_HEIGHT = 32768;
+// Set by --perf
+static bool perf_enabled = false;
+
+/*
+ * class ThreadSync - Lets threads start at the same time and records wall clock time
+ */
+class ThreadSync {
+ public:
+  ThreadSync(size_t pthread_num) : thread_num{pthread_num}, ready_num{0}, start_time{0}, end_time_list(pthread_num) {}
+
+  size_t thread_num;
+  std::atomic<size_t> ready_num;
+  std::atomic<uint64_t> start_time;
+  std::vector<uint64_t> end_time_list;
+};
+
+/*
+ * TimeThreads() - Runs fn(thread_id) on each thread and returns the wall clock
+ *                 time between the start of the last thread and the end of the
+ *                 last thread, excluding thread creation
+ *
+ * Hardware events of fn() on all threads are added to the perf result
+ */
+template <typename Function>
+static uint64_t TimeThreads(size_t thread_num, PerfCounter::Result *perf_result_p, Function &&fn) {
+  ThreadSync sync{thread_num};
+  std::vector<PerfCounter::Result> perf_result_list(thread_num);
+  auto wrapper = [&fn, &perf_result_list](size_t thread_id, ThreadSync &thread_sync) {
+    PerfCounter perf{perf_enabled};
+    if(thread_sync.ready_num.fetch_add(1) + 1 == thread_sync.thread_num) {
+      thread_sync.start_time.store(Timer::GetNanoseconds());
+    }
+    while(thread_sync.ready_num.load() != thread_sync.thread_num) {}
+    perf.Start();
+    fn(thread_id);
+    perf.Stop();
+    thread_sync.end_time_list[thread_id] = Timer::GetNanoseconds();
+    perf_result_list[thread_id] = perf.Read();
+  };
+
+  StartThread(thread_num, wrapper, sync);
+  for(const PerfCounter::Result &perf_result : perf_result_list) { perf_result_p->Merge(perf_result); }
+  return *std::max_element(sync.end_time_list.begin(), sync.end_time_list.end()) - sync.start_time.load();
+}
+
+/*
+ * GetLeafBase() - Returns a leaf base node of the given size with keys 0, 2, 4, ...
+ */
+static LeafBaseType *GetLeafBase(uint64_t size) {
+  LeafBaseType *node_p = LeafBaseType::Get(NodeType::LeafBase, size, BoundKeyType::GetInf(), BoundKeyType::GetInf());
+  for(uint64_t i = 0;i < size;i++) {
+    node_p->KeyAt(static_cast<int>(i)) = i * 2;
+    node_p->ValueAt(static_cast<int>(i)) = i;
+  }
+
+  return node_p;
+}
+
+/*
+ * AppendChain() - Appends height insert deltas with odd keys spread over the
+ *                 key range of the base node
+ */
+static void AppendChain(MappingTableType *table_p, NodeIDType node_id, uint64_t size, uint64_t height) {
+  AppendHelperType ah{node_id, table_p->At(node_id), table_p};
+  uint64_t stride = (size * 2) / (height + 1) + 1;
+  for(uint64_t i = 0;i < height;i++) {
+    always_assert(ah.AppendLeafInsert(i * stride * 2 + 1, i) == nullptr);
+  }
+
+  return;
+}
+
+// * FreeChain() - Frees the delta chain and the base node of a node ID
+static void FreeChain(MappingTableType *table_p, NodeIDType node_id) {
+  DeltaChainFreeHelperType dcfh{table_p};
+  FreeTraverserType::Traverse(table_p->At(node_id), &dcfh);
+  return;
+}
+
+using StridedMappingTableType = StridedMappingTable<NodeBaseType, BwTreeType::MAPPING_TABLE_SIZE>;
+
+/*
+ * TimeCAS() - Each thread CASes its node ID, or the first node ID if shared. Returns the time
+ */
+template <typename TableType>
+static uint64_t TimeCAS(uint64_t thread_num, uint64_t per_thread, bool shared, 
+                        uint64_t *retry_num_p, PerfCounter::Result *perf_result_p) {
+  TableType *table_p = TableType::Get();
+  for(uint64_t i = 0;i < thread_num;i++) { table_p->AllocateNodeID(nullptr); }
+  std::atomic<uint64_t> retry_num{0};
+  uint64_t elapsed = TimeThreads(thread_num, perf_result_p, [table_p, per_thread, shared, &retry_num](size_t thread_id) {
+    NodeIDType node_id = shared ? TableType::FIRST_NODE_ID : static_cast<NodeIDType>(thread_id);
+    uint64_t retry = 0;
+    for(uint64_t i = 0;i < per_thread;i++) {
+      NodeBaseType *node_p = table_p->At(node_id);
+      while(table_p->CAS(node_id, node_p, reinterpret_cast<NodeBaseType *>(
+              reinterpret_cast<uintptr_t>(node_p) + 1)) == false) {
+        node_p = table_p->At(node_id);
+        retry++;
+      }
+    }
+    retry_num.fetch_add(retry);
+  });
+  TableType::Destroy(table_p);
+  *retry_num_p = retry_num.load();
+  return elapsed;
+}
+
+/*
+ * BenchMappingTable() - AllocateNodeID() and CAS() with thread contention
+ *
+ * 1. allocate: Each thread allocates ops / threads node IDs. Threads only
+ *    contend on the slot counter when they reserve a new block of IDs
+ * 2. cas_shared: All threads CAS the same slot. Retries are failed CAS
+ * 3. cas_private: Each thread CASes its own slot. Slots are adjacent, which
+ *    measures false sharing of the table layout
+ * 4. cas_private_strided: Same as cas_private on the strided layout, where the
+ *    IDs are on different cache lines
+ */
+static void BenchMappingTable(BenchReport *report_p, const std::vector<uint64_t> &thread_list, uint64_t op_num) {
+  for(uint64_t thread_num : thread_list) {
+    uint64_t per_thread = op_num / thread_num;
+    MappingTableType *table_p = MappingTableType::Get();
+    PerfCounter::Result perf_result{};
+    uint64_t elapsed = TimeThreads(thread_num, &perf_result, [table_p, per_thread](size_t) {
+      for(uint64_t i = 0;i < per_thread;i++) { table_p->AllocateNodeID(nullptr); }
+    });
+    report_p->AddRow("mapping_table", "allocate", "none", 0, thread_num, per_thread * thread_num, 0, elapsed, perf_result);
+    MappingTableType::Destroy(table_p);
+
+    uint64_t retry_num = 0;
+    for(int shared = 1;shared >= 0;shared--) {
+      perf_result = PerfCounter::Result{};
+      elapsed = TimeCAS<MappingTableType>(thread_num, per_thread, shared == 1, &retry_num, &perf_result);
+      report_p->AddRow("mapping_table", shared ? "cas_shared" : "cas_private", "none", 0,
+                       thread_num, per_thread * thread_num, retry_num, elapsed, perf_result);
+    }
+
+    perf_result = PerfCounter::Result{};
+    elapsed = TimeCAS<StridedMappingTableType>(thread_num, per_thread, false, &retry_num, &perf_result);
+    report_p->AddRow("mapping_table", "cas_private_strided", "none", 0,
+                     thread_num, per_thread * thread_num, retry_num, elapsed, perf_result);
+  }
+
+  return;
+}
+
+/*
+ * BenchAppendHelper() - Throughput of AppendLeafInsert()
+ *
+ * 1. leaf_insert: A single thread builds chains of the given height on an
+ *    empty base node. Only appends are timed
+ * 2. leaf_insert_contended: All threads append to the same node, and reload
+ *    the head on CAS failure. Retries are failed CAS
+ */
+static void BenchAppendHelper(BenchReport *report_p, const std::vector<uint64_t> &thread_list, uint64_t op_num) {
+  MappingTableType *table_p = MappingTableType::Get();
+  for(uint64_t height : chain_height_list) {
+    if(height == 0) { continue; }
+    uint64_t round_num = op_num / height + 1;
+    uint64_t elapsed = 0;
+    PerfCounter perf{perf_enabled};
+    for(uint64_t round = 0;round < round_num;round++) {
+      NodeIDType node_id = table_p->AllocateNodeID(GetLeafBase(0));
+      perf.Start();
+      Timer timer{};
+      AppendChain(table_p, node_id, 0, height);
+      elapsed += timer.GetElapsedNanoseconds();
+      perf.Stop();
+      FreeChain(table_p, node_id);
+    }
+
+    report_p->AddRow("append_helper", "leaf_insert", "height", height, 1, round_num * height, 0, elapsed, perf.Read());
+  }
+
+  for(uint64_t thread_num : thread_list) {
+    uint64_t per_thread = CONTENDED_CHAIN_HEIGHT / thread_num;
+    uint64_t round_num = op_num / (per_thread * thread_num) + 1;
+    uint64_t elapsed = 0;
+    std::atomic<uint64_t> retry_num{0};
+    PerfCounter::Result perf_result{};
+    for(uint64_t round = 0;round < round_num;round++) {
+      NodeIDType node_id = table_p->AllocateNodeID(GetLeafBase(0));
+      elapsed += TimeThreads(thread_num, &perf_result, [table_p, node_id, per_thread, &retry_num](size_t thread_id) {
+        uint64_t retry = 0;
+        for(uint64_t i = 0;i < per_thread;i++) {
+          while(true) {
+            AppendHelperType ah{node_id, table_p->At(node_id), table_p};
+            LeafInsertType *delta_p = ah.AppendLeafInsert(i * 64 + thread_id, i);
+            if(delta_p == nullptr) { break; }
+            ah.DestroyDelta(delta_p);
+            retry++;
+          }
+        }
+        retry_num.fetch_add(retry);
+      });
+      FreeChain(table_p, node_id);
+    }
+
+    report_p->AddRow("append_helper", "leaf_insert_contended", "none", 0,
+                     thread_num, round_num * per_thread * thread_num, retry_num.load(), elapsed, perf_result);
+  }
+
+  MappingTableType::Destroy(table_p);
+  return;
+}
+
+/*
+ * BenchTraverser() - Searches a key that is only in the base node, such that
+ *                    the whole delta chain is traversed
+ */
+static void BenchTraverser(BenchReport *report_p, uint64_t op_num) {
+  constexpr uint64_t size = 64;
+  MappingTableType *table_p = MappingTableType::Get();
+  for(uint64_t height : chain_height_list) {
+    NodeIDType node_id = table_p->AllocateNodeID(GetLeafBase(size));
+    AppendChain(table_p, node_id, size, height);
+    NodeBaseType *node_p = table_p->At(node_id);
+
+    uint64_t found = 0;
+    PerfCounter perf{perf_enabled};
+    perf.Start();
+    Timer timer{};
+    for(uint64_t i = 0;i < op_num;i++) {
+      ValueSearcherType searcher{(i % size) * 2};
+      ValueSearchTraverserType::Traverse(node_p, &searcher);
+      found += searcher.GetValue() != nullptr;
+    }
+    uint64_t elapsed = timer.GetElapsedNanoseconds();
+    perf.Stop();
+    always_assert(found == op_num);
+
+    report_p->AddRow("traverser", "value_search", "height", height, 1, op_num, 0, elapsed, perf.Read());
+    FreeChain(table_p, node_id);
+  }
+
+  MappingTableType::Destroy(table_p);
+  return;
+}
+
+/*
+ * BenchConsolidator() - Consolidates a leaf of each base size and chain height
+ *
+ * The case name carries the base node size and the param is the chain height.
+ * Each operation is one consolidation of the whole chain
+ */
+static void BenchConsolidator(BenchReport *report_p, uint64_t op_num) {
+  MappingTableType *table_p = MappingTableType::Get();
+  for(uint64_t size : node_size_list) {
+    std::string name = "leaf_size_" + std::to_string(size);
+    for(uint64_t height : chain_height_list) {
+      NodeIDType node_id = table_p->AllocateNodeID(GetLeafBase(size));
+      AppendChain(table_p, node_id, size, height);
+      NodeBaseType *node_p = table_p->At(node_id);
+
+      // Scale down such that each row takes roughly the same time
+      uint64_t round_num = op_num / (size + height) + 1;
+      uint64_t elapsed = 0;
+      PerfCounter perf{perf_enabled};
+      for(uint64_t round = 0;round < round_num;round++) {
+        perf.Start();
+        Timer timer{};
+        ConsolidatorType consolidator{node_p};
+        ConsolidationTraverserType::Traverse(node_p, &consolidator);
+        elapsed += timer.GetElapsedNanoseconds();
+        perf.Stop();
+        always_assert(consolidator.GetNewLeafBase()->GetSize() == size + height);
+        LeafBaseType::Destroy(consolidator.GetNewLeafBase());
+      }
+
+      report_p->AddRow("consolidator", name.c_str(), "height", height, 1, round_num, 0, elapsed, perf.Read());
+      FreeChain(table_p, node_id);
+    }
+  }
+
+  MappingTableType::Destroy(table_p);
+  return;
+}
+
+/*
+ * BenchBaseNode() - Search() and PointSearch() with random keys in the node range
+ */
+static void BenchBaseNode(BenchReport *report_p, uint64_t op_num) {
+  for(uint64_t size : node_size_list) {
+    LeafBaseType *node_p = GetLeafBase(size);
+    std::vector<KeyType> key_list(4096);
+    UniformGenerator gen{size};
+    for(KeyType &key : key_list) { key = gen.Next(size * 2); }
+
+    uint64_t sum = 0;
+    PerfCounter perf{perf_enabled};
+    perf.Start();
+    Timer timer{};
+    for(uint64_t i = 0;i < op_num;i++) { sum += node_p->Search(key_list[i % key_list.size()]); }
+    uint64_t elapsed = timer.GetElapsedNanoseconds();
+    perf.Stop();
+    report_p->AddRow("base_node", "search", "size", size, 1, op_num, 0, elapsed, perf.Read());
+
+    perf.Reset();
+    perf.Start();
+    timer.Reset();
+    for(uint64_t i = 0;i < op_num;i++) { sum += node_p->PointSearch(key_list[i % key_list.size()]); }
+    elapsed = timer.GetElapsedNanoseconds();
+    perf.Stop();
+    report_p->AddRow("base_node", "point_search", "size", size, 1, op_num, 0, elapsed, perf.Read());
+
+    // Keep the result alive such that the searches are not optimized out
+    always_assert(sum != 0);
+    LeafBaseType::Destroy(node_p);
+  }
+
+  return;
+}
+
+// * AllocateHugePageNode() - Allocates node memory as HugePageDeltaChainType does
+template <HugePageMode MODE>
+static void *AllocateHugePageNode(size_t size) { return HugePageDeltaChainType<MODE>::AllocateNode(size); }
+
+/*
+ * BenchHugePage() - Random At() on the mapping table followed by a read of the node
+ *
+ * 1. The param is the huge page mode of both the mapping table and the nodes
+ *    (0: none, 1: transparent, 2: explicit). Nodes of mode 0 are allocated by
+ *    DefaultDeltaChainType
+ * 2. The table and the nodes are much larger than the TLB reach of 4 KB pages,
+ *    such that almost every access misses the TLB without huge pages
+ */
+static void BenchHugePage(BenchReport *report_p, uint64_t op_num) {
+  constexpr uint64_t node_num = uint64_t{1} << 19;
+  constexpr size_t node_size = 128;
+  using FreeFunction = void (*)(void *);
+  struct ModeInfo { HugePageMode mode; void *(*allocate)(size_t); FreeFunction free; };
+  ModeInfo mode_list[] = {
+    {HugePageMode::None, DefaultDeltaChainType::AllocateNode, DefaultDeltaChainType::FreeNode},
+    {HugePageMode::Transparent, AllocateHugePageNode<HugePageMode::Transparent>, 
+     HugePageDeltaChainType<HugePageMode::Transparent>::FreeNode},
+    {HugePageMode::Explicit, AllocateHugePageNode<HugePageMode::Explicit>, 
+     HugePageDeltaChainType<HugePageMode::Explicit>::FreeNode},
+  };
+
+  for(const ModeInfo &info : mode_list) {
+    MappingTableType *table_p = MappingTableType::Get(info.mode);
+    for(uint64_t i = 0;i < node_num;i++) {
+      uint64_t *node_p = static_cast<uint64_t *>(info.allocate(node_size));
+      memset(node_p, 0, node_size);
+      node_p[0] = i;
+      table_p->AllocateNodeID(reinterpret_cast<NodeBaseType *>(node_p));
+    }
+
+    // xorshift is cheap enough not to dominate the lookup
+    uint64_t state = 88172645463325252UL, sum = 0;
+    PerfCounter perf{perf_enabled};
+    perf.Start();
+    Timer timer{};
+    for(uint64_t i = 0;i < op_num;i++) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      sum += *reinterpret_cast<uint64_t *>(table_p->At(state & (node_num - 1)));
+    }
+    uint64_t elapsed = timer.GetElapsedNanoseconds();
+    perf.Stop();
+    always_assert(sum != 0);
+    report_p->AddRow("huge_page", "lookup", "mode", static_cast<uint64_t>(info.mode), 1, op_num, 0, elapsed, perf.Read());
+
+    for(uint64_t i = 0;i < node_num;i++) { info.free(table_p->At(i)); }
+    MappingTableType::Destroy(table_p);
+  }
+
+  return;
+}
+
+int main(int argc, char **argv) {
+  ArgParser parser{argc, argv};
+  BenchReport::Format format;
+  if(BenchReport::ParseFormat(parser.GetString("format", "csv"), &format) == false) {
+    err_printf("Unknown format \"%s\"\n", parser.GetString("format", "").c_str());
+  }
+
+  std::string block_list = "," + parser.GetString("block", "mapping_table,append_helper,traverser,consolidator,base_node,huge_page") + ",";
+  std::vector<uint64_t> thread_list = parser.GetUIntList("threads", {1, 2, 4});
+  uint64_t op_num = parser.GetUInt("ops", 1000000);
+  for(uint64_t thread_num : thread_list) { always_assert(thread_num > 0); }
+  always_assert(op_num > 0);
+  perf_enabled = parser.Has("perf");
+
+  auto selected = [&block_list](const char *name) {
+    return block_list.find("," + std::string{name} + ",") != std::string::npos;
+  };
+
+  BenchReport report{stdout, format, perf_enabled};
+  report.Begin();
+  if(selected("mapping_table")) { BenchMappingTable(&report, thread_list, op_num); }
+  if(selected("append_helper")) { BenchAppendHelper(&report, thread_list, op_num); }
+  if(selected("traverser")) { BenchTraverser(&report, op_num); }
+  if(selected("consolidator")) { BenchConsolidator(&report, op_num); }
+  if(selected("base_node")) { BenchBaseNode(&report, op_num); }
+  if(selected("huge_page")) { BenchHugePage(&report, op_num); }
+  report.End();
+
+  return 0;
+}
@@ -8,7 +8,31 @@
 #define _BWTREE_H
 
 #include "common.h"
+#include "latency-histogram.h"
+#include "huge-page.h"
+#include "file-util.h"
+#include "wal.h"
+#include "htm.h"
+#include "simd.h"
 #include <atomic>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <limits>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+
+// Define BWTREE_LATENCY (make LATENCY=1) to record the latency of tree operations,
+// consolidations and SMOs. Otherwise the recording code is compiled out
+// NOTE: Do not add semicolon after this
+#ifdef BWTREE_LATENCY
+#define IF_LATENCY(s) s
+#else
+#define IF_LATENCY(s)
+#endif
 
 namespace wangziqi2013 {
 namespace index_building_block {
@@ -94,22 +118,129 @@ enum class NodeType : uint16_t {
   LeafSplit,
   LeafRemove,
   LeafMerge,
+  LeafRangeDelete,
 };
 
 /*
- * class DefaultMappingTable - This class implements the minimal mapping table
- *                             which supports the allocation and CAS of node IDs
+ * class ThreadIndex - Assigns a small integer to each thread, for indexing per-thread data
+ * 
+ * 1. Indices are dense and within [0, MAX_THREAD). An index is returned to the
+ *    pool when its thread exits, and may then be reused by a new thread
+ * 2. An error is raised if more than MAX_THREAD threads are alive at the same time
+ * 3. Acquire() and Release() hand out indices that are not bound to a thread,
+ *    e.g. for thread contexts that are registered explicitly
+ */
+class ThreadIndex {
+ public:
+  static constexpr size_t MAX_THREAD = 256;
+
+  // * Get() - Returns the index of the calling thread
+  static size_t Get() {
+    static thread_local Holder holder{};
+    return holder.index;
+  }
+
+  // * Acquire() - Takes the lowest free index
+  static size_t Acquire() {
+    std::atomic<bool> *used_list = GetUsedList();
+    for(size_t i = 0;i < MAX_THREAD;i++) {
+      bool expected = false;
+      if(used_list[i].load() == false && used_list[i].compare_exchange_strong(expected, true)) { return i; }
+    }
+
+    err_printf("More than %lu threads are alive\n", MAX_THREAD);
+    return MAX_THREAD;
+  }
+
+  // * Release() - Returns an index taken by Acquire() to the pool
+  static void Release(size_t index) {
+    assert(index < MAX_THREAD && GetUsedList()[index].load() == true);
+    GetUsedList()[index].store(false);
+    return;
+  }
+
+ private:
+  // * class Holder - Acquires the index on first use and releases it on thread exit
+  class Holder {
+   public:
+    Holder() : index{Acquire()} {}
+    ~Holder() { Release(index); }
+    size_t index;
+  };
+
+  // * GetUsedList() - Returns the flags of indices that are taken
+  static std::atomic<bool> *GetUsedList() {
+    static std::atomic<bool> used_list[MAX_THREAD];
+    return used_list;
+  }
+};
+
+/*
+ * class DenseSlotLayout - Node IDs are slot indices
+ * 
+ * Nodes allocated together, such as a split sibling and a new parent, share
+ * cache lines, which keeps the table compact
+ */
+class DenseSlotLayout {
+ public:
+  inline static size_t GetSlot(size_t node_id, size_t) { return node_id; }
+};
+
+/*
+ * class StridedSlotLayout - Spreads consecutive node IDs over different cache lines
+ * 
+ * 1. The table is viewed as SLOTS_PER_LINE regions. Node ID i is stored in region
+ *    i % SLOTS_PER_LINE at offset i / SLOTS_PER_LINE, so IDs sharing a cache line
+ *    are SLOTS_PER_LINE apart. CAS on nodes allocated one after another, such as
+ *    the right-most leaf and its new sibling and parent under appends, does not
+ *    invalidate each other's line
+ * 2. The mapping is a permutation. Slots after the last full stride map to themselves
+ * 3. Consecutive IDs are on different pages, so a small tree touches more pages
+ *    and TLB entries than with the dense layout
+ */
+class StridedSlotLayout {
+ public:
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+  static constexpr size_t SLOTS_PER_LINE = CACHE_LINE_SIZE / sizeof(void *);
+
+  inline static size_t GetSlot(size_t node_id, size_t table_size) {
+    size_t stride = table_size / SLOTS_PER_LINE;
+    if(node_id >= stride * SLOTS_PER_LINE) { return node_id; }
+    return (node_id % SLOTS_PER_LINE) * stride + node_id / SLOTS_PER_LINE;
+  }
+};
+
+/*
+ * class LayoutMappingTable - This class implements the minimal mapping table
+ *                            which supports the allocation and CAS of node IDs
  * 
  * 1. Release of node ID is not supported. Always allocate from the counter
  * 2. The mapping table is fixed sized. No bounds checking is performed under
  *    release mode. Under debug mode an error will be raised
+ * 3. The table can be backed by huge pages, since random lookups on a large
+ *    table otherwise miss the TLB on almost every access
+ * 4. A dirty bitmap parallel to the table records slots that are allocated, 
+ *    released or CAS'ed since their bits were last cleared. The bit is set 
+ *    after the slot is written, so a reader that clears the bit and then reads
+ *    the slot sees the change, or finds the bit set again
+ * 5. Each thread reserves ID_BLOCK_SIZE slots at a time from the shared counter
+ *    and allocates IDs from its block, so the counter is not written on every
+ *    allocation. Blocks are indexed by ThreadIndex. Slots left in the block of
+ *    an exited thread are used by the next thread that gets its index. IDs are
+ *    therefore not allocated in order across threads, and reserved slots that
+ *    are not allocated yet hold nullptr. Nothing depends on the order of IDs,
+ *    and reserved slots are not counted as used
+ * 6. SlotLayout maps node IDs to slots of the array. The dirty bitmap and all
+ *    interfaces use node IDs
  * 
- * It accepts two template parameters: One to specify the element type. The atomic
+ * It accepts three template parameters: One to specify the element type. The atomic
  * type to the pointer of the element type is stored. Another to specify the 
- * size of the mapping table, which is the number of elements
+ * size of the mapping table, which is the number of elements. The last one is
+ * the slot layout. Trees take the table through DefaultMappingTable or 
+ * StridedMappingTable below
  */
-template <typename BaseNodeType, size_t TABLE_SIZE>
-class DefaultMappingTable {
+template <typename BaseNodeType, size_t TABLE_SIZE, typename SlotLayout>
+class LayoutMappingTable {
  public:
   friend void MappingTableTest();
 
@@ -121,26 +252,38 @@ class DefaultMappingTable {
 
  private:
   /*
-   * DefaultMappingTable() - Private Constructor
+   * LayoutMappingTable() - Private Constructor
    * 
    * The constructor is private to avoid allocating a mapping table on the stack
    * or directly putting it as a memory, as the table can be potentially large
    */
-  DefaultMappingTable() : 
-    next_slot{FIRST_NODE_ID} {
+  LayoutMappingTable(HugePageMode pmode) : 
+    next_slot{FIRST_NODE_ID}, mode{pmode} {
+    ResetBlocks();
     return;
   }
 
   /*
-   * ~DefaultMappingTable() - Private Destructor
+   * ~LayoutMappingTable() - Private Destructor
    */
-  ~DefaultMappingTable() {}
+  ~LayoutMappingTable() {}
 
  public: 
   // * Get() - Allocate an instance of the mapping table
-  static DefaultMappingTable *Get() { return new DefaultMappingTable{}; }
+  static LayoutMappingTable *Get(HugePageMode mode = HugePageMode::None) { 
+    if(mode == HugePageMode::None) { return new LayoutMappingTable{mode}; }
+    return new (HugePageAllocate(sizeof(LayoutMappingTable), mode)) LayoutMappingTable{mode};
+  }
   // * Destroy() - The destructor of the mapping table instance
-  static void Destroy(DefaultMappingTable *mapping_table_p) { delete mapping_table_p; }
+  static void Destroy(LayoutMappingTable *mapping_table_p) { 
+    HugePageMode mode = mapping_table_p->mode;
+    if(mode == HugePageMode::None) { delete mapping_table_p; return; }
+    mapping_table_p->~LayoutMappingTable();
+    HugePageFree(mapping_table_p, sizeof(LayoutMappingTable), mode);
+    return;
+  }
+  // * GetHugePageMode() - Returns how the table is backed
+  inline HugePageMode GetHugePageMode() const { return mode; }
 
   /*
    * AllocateNodeID() - Allocate a slot and put the given node_p into it
@@ -148,12 +291,23 @@ class DefaultMappingTable {
    * If allocation fails because of table overflow, an error is raised under 
    * debug mode. The slot is always returned even if node_p is given
    */
-  inline NodeIDType AllocateNodeID(BaseNodeType *node_p) {
-    // Use atomic instruction to allocate slots
-    NodeIDType slot = next_slot.fetch_add(1);
-    // Only do this after the atomic inc
+  inline NodeIDType AllocateNodeID(BaseNodeType *node_p) { return AllocateNodeID(node_p, ThreadIndex::Get()); }
+
+  // * AllocateNodeID() - Allocates from the block of the given thread index, which the caller owns
+  inline NodeIDType AllocateNodeID(BaseNodeType *node_p, size_t thread_index) {
+    assert(thread_index < ThreadIndex::MAX_THREAD);
+    IDBlock &block = id_block_list[thread_index];
+    NodeIDType slot = block.next.load(std::memory_order_relaxed);
+    if(slot == block.end.load(std::memory_order_relaxed)) {
+      // Use atomic instruction to reserve slots
+      slot = next_slot.fetch_add(ID_BLOCK_SIZE);
+      block.end.store(slot + ID_BLOCK_SIZE, std::memory_order_relaxed);
+    }
+
+    block.next.store(slot + 1, std::memory_order_relaxed);
     assert(slot < TABLE_SIZE);
-    mapping_table[slot] = node_p;
+    GetSlot(slot) = node_p;
+    MarkDirty(slot);
 
     return slot;
   }
@@ -167,7 +321,8 @@ class DefaultMappingTable {
    */
   inline void ReleaseNodeID(NodeIDType node_id) {
     assert(node_id < TABLE_SIZE);
-    mapping_table[node_id] = nullptr;
+    GetSlot(node_id) = nullptr;
+    MarkDirty(node_id);
     return;
   }
 
@@ -178,49 +333,186 @@ class DefaultMappingTable {
                   BaseNodeType *old_value, 
                   BaseNodeType *new_value) {
     assert(node_id < TABLE_SIZE);
-    return mapping_table[node_id].compare_exchange_strong(old_value, new_value);
+    if(GetSlot(node_id).compare_exchange_strong(old_value, new_value) == false) { return false; }
+    MarkDirty(node_id);
+    return true;
+  }
+
+  /*
+   * CASMulti() - Performs compare and swap on several elements in one RTM transaction
+   * 
+   * 1. Either all elements are swapped or none is. Returns false if any element
+   *    differs from its old value, if the transaction aborts, or if RTM is not
+   *    supported. The caller falls back to single element CAS
+   * 2. Dirty bits are set after the transaction commits
+   */
+  HTM_TARGET bool CASMulti(size_t num, const NodeIDType *id_list, 
+                           BaseNodeType *const *old_list, BaseNodeType *const *new_list) {
+#ifdef HTM_COMPILED
+    if(HTMIsSupported() == false) { return false; }
+    for(size_t retry = 0;retry < HTM_RETRY_NUM;retry++) {
+      unsigned int status = _xbegin();
+      if(status == _XBEGIN_STARTED) {
+        for(size_t i = 0;i < num;i++) {
+          if(GetSlot(id_list[i]).load(std::memory_order_relaxed) != old_list[i]) { _xabort(0); }
+        }
+        for(size_t i = 0;i < num;i++) { GetSlot(id_list[i]).store(new_list[i], std::memory_order_relaxed); }
+        _xend();
+        for(size_t i = 0;i < num;i++) { MarkDirty(id_list[i]); }
+        return true;
+      } else if((status & _XABORT_EXPLICIT) != 0 || (status & _XABORT_RETRY) == 0) {
+        break;
+      }
+    }
+#else
+    (void)num; (void)id_list; (void)old_list; (void)new_list;
+#endif
+    return false;
   }
 
   // * At() - Returns the content on a given index
   inline BaseNodeType *At(NodeIDType node_id) {
     assert(node_id < TABLE_SIZE);
-    return mapping_table[node_id].load();
+    return GetSlot(node_id).load();
+  }
+
+  // * GetNextSlot() - Returns the number of reserved slots, which bounds the IDs allocated so far
+  inline NodeIDType GetNextSlot() const { return std::min<NodeIDType>(next_slot.load(), TABLE_SIZE); }
+  // * GetReservedSize() - Returns the number of bytes of the table, most of which may not be touched
+  inline size_t GetReservedSize() const { return sizeof(mapping_table); }
+  /*
+   * GetUsedSize() - Returns the number of bytes of slots that have been allocated
+   * 
+   * Slots reserved by a thread but not allocated yet are not counted. Blocks
+   * are read without stopping allocating threads, so the result is approximate
+   * while IDs are being allocated
+   */
+  size_t GetUsedSize() const { 
+    size_t used = std::min<size_t>(next_slot.load(), TABLE_SIZE);
+    for(const IDBlock &block : id_block_list) {
+      NodeIDType end = block.end.load(std::memory_order_relaxed);
+      NodeIDType next = block.next.load(std::memory_order_relaxed);
+      // The two words of a block being refilled may not match
+      if(next > end || end - next > ID_BLOCK_SIZE || end > TABLE_SIZE) { continue; }
+      used -= std::min<size_t>(end - next, used);
+    }
+
+    return used * sizeof(mapping_table[0]); 
+  }
+
+  // * IsDirty() - Returns whether the slot is changed since its bit was cleared
+  inline bool IsDirty(NodeIDType node_id) const {
+    assert(node_id < TABLE_SIZE);
+    return (dirty_bitmap[node_id / DIRTY_WORD_BITS].load() & (uint64_t{1} << (node_id % DIRTY_WORD_BITS))) != 0;
+  }
+
+  /*
+   * ClearDirty() - Clears all dirty bits
+   * 
+   * IDs of slots whose bits were set are appended to the list in ID order, if 
+   * the list is given. Each word is cleared atomically, such that a concurrent
+   * change is either returned or left dirty
+   */
+  void ClearDirty(std::vector<NodeIDType> *dirty_list_p = nullptr) {
+    size_t word_count = (std::min<size_t>(next_slot.load(), TABLE_SIZE) + DIRTY_WORD_BITS - 1) / DIRTY_WORD_BITS;
+    for(size_t i = 0;i < word_count;i++) {
+      if(dirty_bitmap[i].load() == 0) { continue; }
+      uint64_t word = dirty_bitmap[i].exchange(0);
+      if(dirty_list_p == nullptr) { continue; }
+      for(size_t bit = 0;bit < DIRTY_WORD_BITS;bit++) {
+        if((word & (uint64_t{1} << bit)) != 0) { dirty_list_p->push_back(static_cast<NodeIDType>(i * DIRTY_WORD_BITS + bit)); }
+      }
+    }
+
+    return;
+  }
+
+  // * MarkDirty() - Sets the dirty bit of a slot
+  inline void MarkDirty(NodeIDType node_id) {
+    std::atomic<uint64_t> &word = dirty_bitmap[node_id / DIRTY_WORD_BITS];
+    uint64_t mask = uint64_t{1} << (node_id % DIRTY_WORD_BITS);
+    // Hot slots are usually dirty already, and reading first avoids writing the shared word
+    if((word.load() & mask) == 0) { word.fetch_or(mask); }
+    return;
   }
 
   // * Reset() - Clear the content as well as the index
   void Reset() {
-    memset(mapping_table, 0x00, sizeof(mapping_table));
+    memset(static_cast<void *>(mapping_table), 0x00, sizeof(mapping_table));
+    memset(static_cast<void *>(dirty_bitmap), 0x00, sizeof(dirty_bitmap));
     next_slot = NodeIDType{0};
+    ResetBlocks();
     return;
   }
 
+  // Number of slots a thread reserves from the shared counter at a time
+  static constexpr NodeIDType ID_BLOCK_SIZE = 256;
+
  private:
+  static constexpr size_t DIRTY_WORD_BITS = 64;
+
+  // Blocks are padded such that blocks of two threads are not on the same cache line
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  // * class IDBlock - Slots [next, end) reserved by a thread. Only the owner writes them
+  class IDBlock {
+   public:
+    std::atomic<NodeIDType> next;
+    std::atomic<NodeIDType> end;
+    char padding[CACHE_LINE_SIZE - 2 * sizeof(NodeIDType)];
+  };
+
+  // * GetSlot() - Returns the slot of a node ID
+  inline std::atomic<BaseNodeType *> &GetSlot(NodeIDType node_id) { 
+    return mapping_table[SlotLayout::GetSlot(node_id, TABLE_SIZE)]; 
+  }
+
+  // * ResetBlocks() - Empties the blocks of all threads
+  void ResetBlocks() {
+    for(IDBlock &block : id_block_list) { 
+      block.next = FIRST_NODE_ID; 
+      block.end = FIRST_NODE_ID; 
+    }
+    return;
+  }
+
   // Fixed sized mapping table with atomic type as elements
   std::atomic<BaseNodeType *> mapping_table[TABLE_SIZE];
+  // One bit per slot, set when the slot is written
+  std::atomic<uint64_t> dirty_bitmap[(TABLE_SIZE + DIRTY_WORD_BITS - 1) / DIRTY_WORD_BITS];
   std::atomic<NodeIDType> next_slot;
+  HugePageMode mode;
+  IDBlock id_block_list[ThreadIndex::MAX_THREAD];
 };
 
+// * DefaultMappingTable - Mapping table with node IDs as slot indices
+template <typename BaseNodeType, size_t TABLE_SIZE>
+using DefaultMappingTable = LayoutMappingTable<BaseNodeType, TABLE_SIZE, DenseSlotLayout>;
+// * StridedMappingTable - Mapping table that puts consecutive node IDs on different cache lines
+template <typename BaseNodeType, size_t TABLE_SIZE>
+using StridedMappingTable = LayoutMappingTable<BaseNodeType, TABLE_SIZE, StridedSlotLayout>;
+
 /*
  * class DefaultDeltaChainType - This class defines the storage of the delta chain
  * 
  * 1. No pre-allocation is implemented. Override this class to 
  *    implement pre-allocation
- * 2. This class has zero size under release mode
+ * 2. This class has zero size. Memory usage of deltas is accounted by the
+ *    tree, which knows when a delta is installed or retired
+ * 3. Memory of base nodes is also allocated by this class through the static
+ *    AllocateNode() and FreeNode(), such that deltas and nodes can share an
+ *    allocation policy
  */
 class DefaultDeltaChainType {
  public:
   /*
    * DefaultDeltaChainType() - Constructor
    */
-  DefaultDeltaChainType() {
-    IF_DEBUG(mem_usage.store(0UL));
-    return;
-  }
+  DefaultDeltaChainType() {}
 
   // * AllocateDelta() - Allocate a delta record of a given type
   template <typename AllocDeltaNodeType, typename ...Args>
   inline AllocDeltaNodeType *AllocateDelta(Args &&...args) {
-    IF_DEBUG(mem_usage.fetch_add(sizeof(AllocDeltaNodeType)));
     return new AllocDeltaNodeType{args...};
   }
 
@@ -228,8 +520,44 @@ class DefaultDeltaChainType {
   template <typename DeltaNodeType>
   inline void DestroyDelta(DeltaNodeType *delta_p) { delete delta_p; }
 
- private:
-  IF_DEBUG(std::atomic<size_t> mem_usage);
+  // * AllocateNode() - Allocates raw memory of a base node
+  inline static void *AllocateNode(size_t size) { return new unsigned char[size]; }
+  // * FreeNode() - Frees memory returned by AllocateNode()
+  inline static void FreeNode(void *p) { delete[] static_cast<unsigned char *>(p); }
+};
+
+/*
+ * class HugePageDeltaChainType - Allocates deltas and base nodes from a huge page arena
+ * 
+ * 1. Nodes allocated close in time share huge pages, which reduces TLB misses
+ *    when traversing delta chains and walking down the tree
+ * 2. Memory of freed nodes is reused by the thread that frees them (usually
+ *    the thread performing GC), but is not returned to the OS
+ */
+template <HugePageMode MODE = HugePageMode::Transparent>
+class HugePageDeltaChainType {
+ public:
+  using ArenaType = HugePageArena<MODE>;
+
+  HugePageDeltaChainType() {}
+
+  // * AllocateDelta() - Allocate a delta record of a given type
+  template <typename AllocDeltaNodeType, typename ...Args>
+  inline AllocDeltaNodeType *AllocateDelta(Args &&...args) {
+    return new (ArenaType::Allocate(sizeof(AllocDeltaNodeType))) AllocDeltaNodeType{args...};
+  }
+
+  // * DestroyDelta() - Destroy a delta record
+  template <typename DeltaNodeType>
+  inline void DestroyDelta(DeltaNodeType *delta_p) { 
+    delta_p->~DeltaNodeType(); 
+    ArenaType::Free(delta_p);
+  }
+
+  // * AllocateNode() - Allocates raw memory of a base node
+  inline static void *AllocateNode(size_t size) { return ArenaType::Allocate(size); }
+  // * FreeNode() - Frees memory returned by AllocateNode()
+  inline static void FreeNode(void *p) { ArenaType::Free(p); }
 };
 
 template <typename, typename> class ExtendedNodeBase;
@@ -255,6 +583,13 @@ class NodeBase {
     type{ptype}, height{pheight}, size{psize},
     low_key_p{plow_key_p}, high_key_p{phigh_key_p} {}
 
+  // * SetKeyPointers() - Points the low and high keys to other instances
+  inline void SetKeyPointers(BoundKeyType *plow_key_p, BoundKeyType *phigh_key_p) {
+    low_key_p = plow_key_p;
+    high_key_p = phigh_key_p;
+    return;
+  }
+
  public:
   // * GetSize() - Returns the size
   inline NodeSizeType GetSize() const { return size; }
@@ -262,6 +597,8 @@ class NodeBase {
   inline NodeHeightType GetHeight() const { return height; }
   // * GetType() - Returns the type enum
   inline NodeType GetType() const { return type; }
+  // * IsLeaf() - Returns true if the node is a leaf base or leaf delta
+  inline bool IsLeaf() const { return type >= NodeType::LeafBase; }
   // * GetHighKey() - Returns high key
   inline BoundKeyType *GetHighKey() const { return high_key_p; }
   // * SetHighKey() - Updates the high key of the node
@@ -304,10 +641,45 @@ class NodeBase {
   BoundKeyType *high_key_p;
 };
 
+/*
+ * class DeltaVersion - Commit version of a leaf insert or delete delta
+ * 
+ * 1. The version is LATEST when the delta is posted, and is set exactly once to
+ *    the version clock after the delta has become visible, either by the writer
+ *    or by the first reader that needs it. Both use CAS, so all readers agree
+ * 2. A snapshot taken at version S sees deltas whose version is not greater than
+ *    S. Since the clock has passed S once the snapshot exists, a delta that is
+ *    pending at that time never becomes visible to it
+ * 3. Reads of the latest state see all deltas, including pending ones
+ */
+class DeltaVersion {
+ public:
+  static constexpr uint64_t LATEST = static_cast<uint64_t>(-1);
+
+  DeltaVersion() : version{LATEST} {}
+  DeltaVersion(const DeltaVersion &other) : version{other.version.load()} {}
+
+  // * Get() - Returns the version, which is LATEST if not resolved yet
+  inline uint64_t Get() const { return version.load(); }
+  // * Resolve() - Sets the version to the clock if it is pending, and returns the final version
+  inline uint64_t Resolve(const std::atomic<uint64_t> &clock) {
+    uint64_t current = version.load();
+    if(current != LATEST) { return current; }
+    uint64_t now = clock.load();
+    return version.compare_exchange_strong(current, now) == true ? now : current;
+  }
+
+ private:
+  std::atomic<uint64_t> version;
+};
+
 #define LEAF_INSERT_TYPE(KeyType, ValueType) \
-  DeltaNode<KeyType, KeyType, ValueType, char[0], char[0], char[0], char[0]>
+  DeltaNode<KeyType, KeyType, ValueType, DeltaVersion, char[0], char[0], char[0]>
 #define LEAF_DELETE_TYPE(KeyType, ValueType) \
-  DeltaNode<KeyType, KeyType, ValueType, char[0], char[0], char[0], char[0]>
+  DeltaNode<KeyType, KeyType, ValueType, DeltaVersion, char[0], char[0], char[0]>
+#define LEAF_RANGE_DELETE_TYPE(KeyType) \
+  DeltaNode<KeyType, KeyType, KeyType, DeltaVersion, char[0], char[0], char[0]>
+                     //   ^ low key ^ high key (exclusive)
 #define LEAF_SPLIT_TYPE(KeyType, NodeIDType) \
   DeltaNode<KeyType, BoundKey<KeyType>, NodeIDType, char[0], char[0], char[0], char[0]>
 #define INNER_SPLIT_TYPE(KeyType, NodeIDType) \
@@ -333,7 +705,9 @@ class NodeBase {
  * yield different delta types:
  * 
  * LeafInsertType/LeafDeleteType = 
- *   DeltaNode<KeyType, KeyType, ValueType, char[0], char[0], char[0], char[0]>
+ *   DeltaNode<KeyType, KeyType, ValueType, DeltaVersion, char[0], char[0], char[0]>
+ * LeafRangeDeleteType = 
+ *   DeltaNode<KeyType, KeyType, KeyType, DeltaVersion, char[0], char[0], char[0]>
  * LeafSplitType/InnerSplitType = 
  *   DeltaNode<KeyType, BoundKey<KeyType>, NodeIDType, char[0], char[0], char[0], char[0]>
  * LeafMergeType/InnerMergeType = 
@@ -398,6 +772,7 @@ class DeltaNode : public NodeBase<KeyType> {
   inline KeyType &GetSplitKey() { return t1.key; }
   inline T1 &GetMergeKey() { return t1; }
   inline T1 &GetRemoveNodeID() { return t1; }
+  inline T1 &GetRangeLowKey() { return t1; }
   // For split deltas, the high key points to a field inside the split delta
   // So we must set the high key after the delta has been constructed
   inline void SetSplitHighKey() { BaseClassType::SetHighKey(&t1); }
@@ -408,9 +783,11 @@ class DeltaNode : public NodeBase<KeyType> {
   inline T2 &GetDeleteNodeID() { return t2; }
   inline T2 &GetSplitNodeID() { return t2; }
   inline T2 &GetMergeNodeID() { return t2; }
+  inline T2 &GetRangeHighKey() { return t2; }
 
   inline T3 &GetMergeSibling() { return t3; }
   inline T3 &GetNextKey() { return t3; }
+  inline T3 &GetVersion() { return t3; }
 
   inline T4 &GetPrevKey() { return t4; }
   inline T5 &GetPrevNodeID() { return t5; }
@@ -438,6 +815,7 @@ class Delta {
   using LeafSplitType = LEAF_SPLIT_TYPE(KeyType, NodeIDType);
   using LeafMergeType = LEAF_MERGE_TYPE(KeyType, NodeIDType);
   using LeafRemoveType = LEAF_REMOVE_TYPE(KeyType, NodeIDType);
+  using LeafRangeDeleteType = LEAF_RANGE_DELETE_TYPE(KeyType);
 
   using InnerInsertType = INNER_INSERT_TYPE(KeyType, NodeIDType);
   using InnerDeleteType = INNER_DELETE_TYPE(KeyType, NodeIDType);
@@ -478,13 +856,27 @@ class ExtendedNodeBase : public NodeBase<KeyType> {
   // * AllocateDelta() - Wrapping around the delta chain
   template <typename AllocDeltaNodeType, typename ...Args>
   inline AllocDeltaNodeType *AllocateDelta(Args &&...args) {
-    return delta_chain.AllocateDelta<AllocDeltaNodeType>(args...);
+    return delta_chain.template AllocateDelta<AllocDeltaNodeType>(args...);
   }
 
   // * DestroyDelta() - Wrapping around the delta chain
   template <typename AllocDeltaNodeType>
   inline void DestroyDelta(AllocDeltaNodeType *node_p) {
-    return delta_chain.DestroyDelta<AllocDeltaNodeType>(node_p);
+    return delta_chain.template DestroyDelta<AllocDeltaNodeType>(node_p);
+  }
+
+  /*
+   * Relocate() - Points the low and high keys to where they will be after the
+   *              object is copied to the given address
+   * 
+   * This builds node images that are accessed at another address, e.g. in a 
+   * file mapping. The object itself must not be accessed afterwards
+   */
+  inline void Relocate(const void *target_p) {
+    char *p = static_cast<char *>(const_cast<void *>(target_p));
+    BaseClassType::SetKeyPointers(reinterpret_cast<BoundKeyType *>(p + offsetof(ExtendedNodeBase, low_key)), 
+                                  reinterpret_cast<BoundKeyType *>(p + offsetof(ExtendedNodeBase, high_key)));
+    return;
   }
 
   // This data member does not space but it has the same address as the low key
@@ -525,6 +917,24 @@ class DefaultBaseNode : public ExtendedNodeBase<_KeyType, _DeltaChainType>, publ
   using NodeSizeType = typename BaseBaseClassType::NodeSizeType;
   using NodeHeightType = typename BaseBaseClassType::NodeHeightType;
   using BoundKeyType = typename BaseBaseClassType::BoundKeyType;
+
+  /*
+   * class Version - State of a key kept for snapshots older than the node
+   * 
+   * Versions are sorted by key, and versions of the same key are in the order
+   * the changes were made. The first version of a key has version 0 and is the
+   * state before the other versions. The state of a key at a snapshot is the
+   * last version of the key that is visible to the snapshot
+   */
+  class Version {
+   public:
+    KeyType key;
+    ValueType value;
+    uint64_t version;
+    bool exists;
+  };
+  using VersionListType = std::vector<Version>;
+
  private:
   // * DefaultBaseNode() - Private Constructor
   DefaultBaseNode(NodeType ptype, 
@@ -532,7 +942,8 @@ class DefaultBaseNode : public ExtendedNodeBase<_KeyType, _DeltaChainType>, publ
                   NodeSizeType psize,
                   const BoundKeyType &plow_key,
                   const BoundKeyType &phigh_key) :
-    BaseClassType{ptype, pheight, psize, plow_key, phigh_key} {
+    BaseClassType{ptype, pheight, psize, plow_key, phigh_key},
+    version_list_p{nullptr} {
     return;
   } 
   
@@ -551,12 +962,22 @@ class DefaultBaseNode : public ExtendedNodeBase<_KeyType, _DeltaChainType>, publ
                               NodeSizeType psize,
                               const BoundKeyType &plow_key,
                               const BoundKeyType &phigh_key) {
-    assert(ptype == NodeType::InnerBase || ptype == NodeType::LeafBase);
-    // Size for key value pairs and size for the structure itself
-    size_t extra_size = size_t{psize} * (sizeof(KeyType) + sizeof(ValueType));
-    size_t total_size = extra_size + sizeof(DefaultBaseNode);
+    return GetAt(DeltaChainType::AllocateNode(GetAllocationSize(psize)), ptype, psize, plow_key, phigh_key);
+  }
 
-    void *p = new unsigned char[total_size];
+  /*
+   * GetAt() - Constructs a base node in memory provided by the caller
+   * 
+   * The memory must have GetAllocationSize(psize) bytes. Bytes not covered by
+   * members, such as padding, are not written. The node must not be passed to 
+   * Destroy()
+   */
+  static DefaultBaseNode *GetAt(void *p,
+                                NodeType ptype, 
+                                NodeSizeType psize,
+                                const BoundKeyType &plow_key,
+                                const BoundKeyType &phigh_key) {
+    assert(ptype == NodeType::InnerBase || ptype == NodeType::LeafBase);
     DefaultBaseNode *node_p = \
       static_cast<DefaultBaseNode *>(
         new (p) DefaultBaseNode{ptype, NodeHeightType{0}, psize, plow_key, phigh_key});
@@ -577,11 +998,26 @@ class DefaultBaseNode : public ExtendedNodeBase<_KeyType, _DeltaChainType>, publ
    *    all delta chain elements have been destroyed before this is called
    */
   static void Destroy(DefaultBaseNode *node_p) {
+    delete node_p->version_list_p;
     node_p->~DefaultBaseNode();
-    delete[] reinterpret_cast<unsigned char *>(node_p);
+    DeltaChainType::FreeNode(node_p);
     return;
   }
 
+  // * GetAllocationSize() - Returns the number of bytes allocated by Get()
+  inline size_t GetAllocationSize() const { return GetAllocationSize(BaseBaseClassType::GetSize()); }
+  // * GetMemorySize() - Returns the number of bytes of the node and of the versions it keeps on the heap
+  inline size_t GetMemorySize() const { 
+    return GetAllocationSize() + 
+      (version_list_p == nullptr ? 0 : sizeof(VersionListType) + version_list_p->capacity() * sizeof(Version));
+  }
+  // * GetItemOffset() - Returns the offset of the first key from the beginning of the node
+  inline static size_t GetItemOffset() { return offsetof(DefaultBaseNode, key_begin); }
+  // * GetAllocationSize() - Returns the number of bytes of a node of the given size
+  inline static size_t GetAllocationSize(NodeSizeType psize) {
+    return sizeof(DefaultBaseNode) + size_t{psize} * (sizeof(KeyType) + sizeof(ValueType));
+  }
+
   // * KeyAt() - Access key on a particular index
   inline KeyType &KeyAt(int index) { return KeyBegin()[index]; }
   // * ValueAt() - Access value on a particular index
@@ -639,12 +1075,76 @@ class DefaultBaseNode : public ExtendedNodeBase<_KeyType, _DeltaChainType>, publ
     // Copy the upper half of the current node into the new node
     std::copy(KeyBegin() + pivot, KeyEnd(), node_p->KeyBegin());
     std::copy(ValueBegin() + pivot, ValueEnd(), node_p->ValueBegin());
+    // Versions of keys in the upper half are also kept by the new node
+    if(version_list_p != nullptr) {
+      auto it = std::lower_bound(version_list_p->begin(), version_list_p->end(), node_p->KeyAt(0), VersionKeyLess);
+      if(it != version_list_p->end()) { node_p->version_list_p = new VersionListType{it, version_list_p->end()}; }
+    }
 
     return node_p;
   }
- public:
+
+  // * GetVersionList() - Returns versions kept for snapshots, or nullptr
+  inline const VersionListType *GetVersionList() const { return version_list_p; }
+  // * SetVersionList() - Hands a version list to the node, which frees it on Destroy()
+  inline void SetVersionList(VersionListType *pversion_list_p) { version_list_p = pversion_list_p; }
+
+  /*
+   * FindVersion() - Returns the state of the key at the snapshot if the node
+   *                 keeps versions of the key, or nullptr
+   * 
+   * If nullptr is returned, the items of the node are the state at all snapshots
+   */
+  Version *FindVersion(const KeyType &key, uint64_t snapshot) {
+    if(version_list_p == nullptr) { return nullptr; }
+    auto it = std::lower_bound(version_list_p->begin(), version_list_p->end(), key, VersionKeyLess);
+    Version *version_p = nullptr;
+    for(;it != version_list_p->end() && it->key == key;it++) {
+      if(it->version <= snapshot) { version_p = &*it; }
+    }
+
+    return version_p;
+  }
+
+  /*
+   * CopyAtSnapshot() - Appends key value pairs of the node at the snapshot in
+   *                    key order
+   * 
+   * Keys with versions are merged with the items. Only keys less than the 
+   * high key are copied
+   */
+  void CopyAtSnapshot(uint64_t snapshot, const BoundKeyType &high_key, 
+                      std::vector<std::pair<KeyType, ValueType>> *result_p) {
+    NodeSizeType index = 0;
+    NodeSizeType size = BaseBaseClassType::GetSize();
+    size_t version_index = 0;
+    size_t version_num = version_list_p == nullptr ? 0 : version_list_p->size();
+    while(true) {
+      bool item_end = index == size || (high_key.IsInf() == false && KeyAt(index) >= high_key.key);
+      bool version_end = version_index == version_num || 
+        (high_key.IsInf() == false && (*version_list_p)[version_index].key >= high_key.key);
+      if(item_end && version_end) { break; }
+      if(version_end || (item_end == false && KeyAt(index) < (*version_list_p)[version_index].key)) {
+        result_p->emplace_back(KeyAt(index), ValueAt(index));
+        index++;
+        continue;
+      }
+
+      // The current state of a key with versions is ignored
+      const KeyType &key = (*version_list_p)[version_index].key;
+      if(item_end == false && KeyAt(index) == key) { index++; }
+      const Version *version_p = FindVersion(key, snapshot);
+      if(version_p->exists == true) { result_p->emplace_back(key, version_p->value); }
+      while(version_index < version_num && (*version_list_p)[version_index].key == key) { version_index++; }
+    }
+
+    return;
+  }
   
  private:
+  // * VersionKeyLess() - Compares the key of a version with a key for binary search
+  static bool VersionKeyLess(const Version &version, const KeyType &key) { return version.key < key; }
+
   // * KeyBegin() - Return the first pointer for values
   inline KeyType *KeyBegin() { return key_begin; }
   // * KeyEnd() - Return the first out-of-bound pointer for keys
@@ -654,6 +1154,8 @@ class DefaultBaseNode : public ExtendedNodeBase<_KeyType, _DeltaChainType>, publ
   // * ValueEnd() - Return the first out-of-bound pointer for values
   inline ValueType *ValueEnd() { return ValueBegin() + BaseBaseClassType::GetSize(); }
 
+  // Versions of keys for active snapshots, or nullptr. Only set on leaves
+  VersionListType *version_list_p;
   // This member does not take any storage, but let us obtain the address
   // of the memory address after all class members
   KeyType key_begin[0];
@@ -693,7 +1195,7 @@ class TraverseHandlerBase {
   void HandleLeafDelete(typename DeltaType::LeafDeleteType *node_p) { Fail(); }
   void HandleInnerDelete(typename DeltaType::InnerDeleteType *node_p) { Fail(); }
 
-  void HandleLeafISplit(typename DeltaType::LeafSplitType *node_p) { Fail(); }
+  void HandleLeafSplit(typename DeltaType::LeafSplitType *node_p) { Fail(); }
   void HandleInnerSplit(typename DeltaType::InnerSplitType *node_p) { Fail(); }
 
   bool HandleLeafMerge(typename DeltaType::LeafMergeType *node_p) { Fail(); return false; }
@@ -702,6 +1204,8 @@ class TraverseHandlerBase {
   void HandleLeafRemove(typename DeltaType::LeafRemoveType *node_p) { Fail(); }
   void HandleInnerRemove(typename DeltaType::InnerRemoveType *node_p) { Fail(); }
 
+  void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { Fail(); }
+
   // * GetNext() - Returns the next pointer
   inline NodeBaseType *GetNext() { return next_p; }
   // * Finished() - Returns true if the traverse terminates
@@ -757,6 +1261,8 @@ class TraverseHandlerBase {
     void HandleLeafRemove(typename DeltaType::LeafRemoveType *node_p) { }
     void HandleInnerRemove(typename DeltaType::InnerRemoveType *node_p) { }
 
+    void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { }
+
     // * GetNext() - Interface for accessing next_p
     NodeBaseType *&GetNext() { return BaseClassType::next_p; }
     // * Finished() - Interface for accessing finished
@@ -823,6 +1329,9 @@ class DeltaChainTraverser {
         case NodeType::InnerRemove:
           handler_p->HandleInnerRemove(static_cast<typename DeltaType::InnerRemoveType *>(node_p));
           break;
+        case NodeType::LeafRangeDelete:
+          handler_p->HandleLeafRangeDelete(static_cast<typename DeltaType::LeafRangeDeleteType *>(node_p));
+          break;
         default:
           assert(false && "Unknown node type during traversal");
       } // switch
@@ -867,6 +1376,7 @@ class AppendHelper {
   using LeafSplitType = typename DeltaType::LeafSplitType;
   using LeafMergeType = typename DeltaType::LeafMergeType;
   using LeafRemoveType = typename DeltaType::LeafRemoveType;
+  using LeafRangeDeleteType = typename DeltaType::LeafRangeDeleteType;
   using InnerInsertType = typename DeltaType::InnerInsertType;
   using InnerDeleteType = typename DeltaType::InnerDeleteType;
   using InnerSplitType = typename DeltaType::InnerSplitType;
@@ -885,7 +1395,7 @@ class AppendHelper {
   
   // * DestroyDelta() - Calls the base delta chain to destroy delta record (only applicable to deltas allocated by this class)
   template <typename DeltaNodeType>
-  inline void DestroyDelta(DeltaNodeType *delta_p) { GetBase()->delta_chain.DestroyDelta(delta_p); }
+  inline void DestroyDelta(DeltaNodeType *delta_p) { GetBase()->template DestroyDelta<DeltaNodeType>(delta_p); }
   
   // * AppendLeafInsert() - Appends a leaf insert delta
   inline LeafInsertType *AppendLeafInsert(const KeyType &key, const ValueType &value) {
@@ -909,8 +1419,24 @@ class AppendHelper {
     return table_p->CAS(node_id, node_p, delta_p) ? (node_p = delta_p, nullptr) : delta_p;
   }
 
+  // * AppendLeafRangeDelete() - Appends a delta deleting keys in [low key, high key), of which there are deleted_num
+  inline LeafRangeDeleteType *AppendLeafRangeDelete(const KeyType &low_key, const KeyType &high_key, 
+                                                    NodeSizeType deleted_num) {
+    assert(node_p->KeyInNode(low_key) && low_key < high_key && deleted_num <= node_p->GetSize());
+    LeafRangeDeleteType *delta_p = GetBase()->template AllocateDelta<LeafRangeDeleteType, NodeType, NodeHeightType>(
+      NodeType::LeafRangeDelete, node_p->GetHeight() + 1, node_p->GetSize() - deleted_num,
+      node_p->GetLowKey(), node_p->GetHighKey(), node_p,
+      low_key, high_key);
+    return Install(delta_p);
+  }
+
   // * AppendLeafSplit() - Appends a leaf split delta
   inline LeafSplitType *AppendLeafSplit(const KeyType &key, NodeIDType sibling_id, NodeSizeType new_size) {
+    return Install(PrepareLeafSplit(key, sibling_id, new_size));
+  }
+
+  // * PrepareLeafSplit() - Allocates a leaf split delta on the node without appending it
+  inline LeafSplitType *PrepareLeafSplit(const KeyType &key, NodeIDType sibling_id, NodeSizeType new_size) {
     LeafSplitType *delta_p = GetBase()->template AllocateDelta<LeafSplitType, NodeType, NodeHeightType>(
       NodeType::LeafSplit, node_p->GetHeight(), node_p->GetSize() - new_size,
       node_p->GetLowKey(), nullptr, node_p,
@@ -918,7 +1444,7 @@ class AppendHelper {
     // Special code here to set the high key of the delta chain to the split key
     // which itself is a bound key
     delta_p->SetSplitHighKey();
-    return table_p->CAS(node_id, node_p, delta_p) ? (node_p = delta_p, nullptr) : delta_p;
+    return delta_p;
   }
 
   // * AppendLeafMerge() - Appends a leaf merge delta
@@ -942,12 +1468,17 @@ class AppendHelper {
   // * AppendInnerInsert() - Appends inner insert delta
   inline InnerInsertType *AppendInnerInsert(const KeyType &key, const NodeIDType &value, 
                                             const BoundKeyType &next_key) {
+    return Install(PrepareInnerInsert(key, value, next_key));
+  }
+
+  // * PrepareInnerInsert() - Allocates inner insert delta on the node without appending it
+  inline InnerInsertType *PrepareInnerInsert(const KeyType &key, const NodeIDType &value, 
+                                             const BoundKeyType &next_key) {
     assert(node_p->KeyInNode(key));
-    InnerInsertType *delta_p = GetBase()->template AllocateDelta<InnerInsertType, NodeType, NodeHeightType>(
+    return GetBase()->template AllocateDelta<InnerInsertType, NodeType, NodeHeightType>(
       NodeType::InnerInsert, node_p->GetHeight() + 1, node_p->GetSize() + 1,
       node_p->GetLowKey(), node_p->GetHighKey(), node_p,
       key, value, next_key);
-    return table_p->CAS(node_id, node_p, delta_p) ? (node_p = delta_p, nullptr) : delta_p;
   }
 
   // * AppendInnerDelete() - Appends inner delete delta
@@ -964,13 +1495,18 @@ class AppendHelper {
 
   // * AppendInnerSplit() - Appends inner split delta
   inline InnerSplitType *AppendInnerSplit(const KeyType &key, NodeIDType sibling_id, NodeSizeType new_size) {
+    return Install(PrepareInnerSplit(key, sibling_id, new_size));
+  }
+
+  // * PrepareInnerSplit() - Allocates inner split delta on the node without appending it
+  inline InnerSplitType *PrepareInnerSplit(const KeyType &key, NodeIDType sibling_id, NodeSizeType new_size) {
     assert(node_p->KeyInNode(key));
     InnerSplitType *delta_p = GetBase()->template AllocateDelta<InnerSplitType, NodeType, NodeHeightType>(
       NodeType::InnerSplit, node_p->GetHeight(), node_p->GetSize() - new_size,
       node_p->GetLowKey(), nullptr, node_p,
       BoundKeyType::Get(key), sibling_id);
     delta_p->SetSplitHighKey();
-    return table_p->CAS(node_id, node_p, delta_p) ? (node_p = delta_p, nullptr) : delta_p;
+    return delta_p;
   }
 
   // * AppendInnerMerge() - Appends a inner merge delta
@@ -991,6 +1527,19 @@ class AppendHelper {
     return table_p->CAS(node_id, node_p, delta_p) ? (node_p = delta_p, nullptr) : delta_p;
   }
 
+  /*
+   * Install() - CAS a prepared delta onto the node
+   * 
+   * Returns nullptr on success, in which case the delta becomes the node. Otherwise
+   * returns the delta, which should be destroyed by the caller
+   */
+  template <typename DeltaNodeType>
+  inline DeltaNodeType *Install(DeltaNodeType *delta_p) {
+    return table_p->CAS(node_id, node_p, delta_p) ? (node_p = delta_p, nullptr) : delta_p;
+  }
+
+  // * SetNode() - Sets the node pointer after a prepared delta is installed by other means
+  void SetNode(NodeBaseType *pnode_p) { node_p = pnode_p; }
   // * GetNode() - Returns the node pointer
   NodeBaseType *GetNode() { return node_p; }
 
@@ -1005,6 +1554,8 @@ class AppendHelper {
  * 
  * 1. This method is usually called within the garbage collector. Delta nodes will be freed 
  *    immediately
+ * 2. Base nodes within the mapped range are node images in a file mapping. They
+ *    are not freed, since they are not allocated by the delta chain
  */
 template <typename KeyType, typename ValueType,
           typename MappingTableType, typename DeltaChainType, 
@@ -1023,21 +1574,26 @@ class DeltaChainFreeHelper :
     DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DeltaChainFreeHelper>;
 
   // * DeltaChainFreeHelper() - Constructor
-  DeltaChainFreeHelper(MappingTableType *ptable_p) : 
+  DeltaChainFreeHelper(MappingTableType *ptable_p, const char *pmapped_begin_p = nullptr, const char *pmapped_end_p = nullptr) : 
     TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>{},
-    table_p{ptable_p} {}
+    table_p{ptable_p}, mapped_begin_p{pmapped_begin_p}, mapped_end_p{pmapped_end_p} {}
 
   NodeBaseType *&GetNext() { return BaseClassType::next_p; }
   bool &Finished() { return BaseClassType::finished; }
   // * GetBase() - Returns a pointer to the base node of the delta chain
   inline ExtendedBaseType *GetBase(NodeBaseType *node_p) { return node_p->template GetBase<DeltaChainType>(); }
 
+  // * IsMapped() - Returns whether a base node is in the mapped range
+  inline bool IsMapped(const void *node_p) const {
+    return static_cast<const char *>(node_p) >= mapped_begin_p && static_cast<const char *>(node_p) < mapped_end_p;
+  }
+
   void HandleLeafBase(LeafBaseType *node_p) { 
-    LeafBaseType::Destroy(node_p);
+    if(IsMapped(node_p) == false) { LeafBaseType::Destroy(node_p); }
     Finished() = true; 
   }
   void HandleInnerBase(InnerBaseType *node_p) { 
-    InnerBaseType::Destroy(node_p);
+    if(IsMapped(node_p) == false) { InnerBaseType::Destroy(node_p); }
     Finished() = true; 
   }
 
@@ -1082,6 +1638,11 @@ class DeltaChainFreeHelper :
     GetBase(node_p)->template DestroyDelta<typename DeltaType::InnerMergeType>(node_p);
   }
 
+  void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { 
+    GetNext() = node_p->GetNext(); 
+    GetBase(node_p)->template DestroyDelta<typename DeltaType::LeafRangeDeleteType>(node_p);
+  }
+
   void HandleLeafRemove(typename DeltaType::LeafRemoveType *node_p) { 
     GetNext() = node_p->GetNext(); 
     table_p->ReleaseNodeID(node_p->GetRemoveNodeID());
@@ -1094,92 +1655,298 @@ class DeltaChainFreeHelper :
   }
 
   MappingTableType *table_p;
-};
-
-// * class BaseNodeIterator - Provides a set of interfaces for iterating on base nodes
-template <typename _BaseNodeType>
-class BaseNodeIterator {
- public:
-  // Referred to by external classes
-  using BaseNodeType = _BaseNodeType;
-  using NodeSizeType = typename BaseNodeType::NodeSizeType;
-  using KeyType = typename BaseNodeType::KeyType;
-  using ValueType = typename BaseNodeType::ValueType;
-  // * BaseNodeIterator() - Constructors
-  BaseNodeIterator(BaseNodeType *pnode_p) : node_p{pnode_p}, index{0} {}
-  BaseNodeIterator() : node_p{nullptr}, index{0} {}
-
-  // * Inited() - Returns false if the node has not been initialized
-  inline bool Inited() { return node_p != nullptr; }
-  // * IsEnd() - Whether the iterator has finished iterating over the node
-  inline bool IsEnd() { return index == node_p->GetSize(); }
-  inline BaseNodeType *GetNode() { return node_p; }
-  inline KeyType &GetKey() { assert(!IsEnd()); return node_p->KeyAt(index); }
-  inline ValueType &GetValue() { assert(!IsEnd()); return node_p->ValueAt(index); }
-  // * Next() - Advance to the next key
-  inline void Next() { assert(index < node_p->GetSize()); index++; }
-  // * Append() - Appends a key and value to the current position and advance
-  inline void Append(const KeyType &key, const ValueType &value) { GetKey() = key; GetValue() = value; Next(); }
-  
-  BaseNodeType *node_p;
-  NodeSizeType index;
+  const char *mapped_begin_p;
+  const char *mapped_end_p;
 };
 
 /* 
- * class DefaultConsolidator - Implements consolidation algorithm
- * 
- * The consolidation algorithm uses two lists: inserted list and deleted list
- * The routine traverses down the delta chain in the normal order. For insert
- * deltas, the keys are first tested against the deleted list to see if it is 
- * already deleted. If not, then it is added into the inserted list after testing
- * for duplication. For delete deltas, they are tested against the inserted list,
- * and then added to the deleted list after a duplicated key test if both tests 
- * return negative.
- * 
- * On the base level, the inserted list is first sorted, from largest to smallest.
- * Then a two-way merge is performed to derive the new node. Each data item in the
- * base node is also tested against the deleted list.
- * 
- * Split nodes change the current high key of the virtual node. The updated high
- * key should be recorded. When traversing the base node and the delta chain, 
- * keys larger than the current high key will be ignored, as they belong to 
- * the split sibling.
+ * class DeltaChainSizeHelper - Computes the number of bytes of a delta chain
  * 
- * Merge nodes are processed recursively. Contexts should be saved and restored 
- * before and after the recursion. For example, the current high key will be 
- * saved and restored before and after both siblings are traversed. As an optimization,
- * the deleted list could also be restored, as we know the two siblings will not share
- * any deleted item.
+ * 1. Deltas are counted by their type size, and base nodes by GetMemorySize()
+ * 2. Both branches of merge deltas are counted
  */
 template <typename KeyType, typename ValueType,
           typename NodeIDType, typename DeltaChainType, 
-          template <typename, typename, typename> typename BaseNode,
-          size_t HEIGHT_THRESHOLD>
-class DefaultConsolidator : 
-  public TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>,
-  public UniqueKeyBase {
+          template <typename, typename, typename> typename BaseNode>
+class DeltaChainSizeHelper : 
+  public TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType> {
  public:
   using BaseClassType = TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>;
   using NodeBaseType = typename BaseClassType::NodeBaseType;
   using DeltaType = typename BaseClassType::DeltaType;
   using LeafBaseType = typename BaseClassType::LeafBaseType;
   using InnerBaseType = typename BaseClassType::InnerBaseType;
-  using NodeHeightType = typename NodeBaseType::NodeHeightType;
-  using NodeSizeType = typename NodeBaseType::NodeSizeType;
   using DeltaChainTraverserType = \
-    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DefaultConsolidator>;
-  using KeyPtrGreaterType = KeyPtrGreater<KeyType>;
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DeltaChainSizeHelper>;
 
-  using LeafNodeIteratorType = BaseNodeIterator<LeafBaseType>;
-  using InnerNodeIteratorType = BaseNodeIterator<InnerBaseType>;
+  // * DeltaChainSizeHelper() - Constructor
+  DeltaChainSizeHelper() : 
+    TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>{}, base_size{0}, delta_size{0} {}
 
-  // * DefaultConsolidator() - Constructor
-  DefaultConsolidator(NodeBaseType *pold_node_p) : 
-    TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>{},
-    inserted_num{NodeHeightType{0}},
-    deleted_num{NodeHeightType{0}},
-    current_high_key_p{nullptr},
+  NodeBaseType *&GetNext() { return BaseClassType::next_p; }
+  bool &Finished() { return BaseClassType::finished; }
+  // * GetSize() - Returns the number of bytes seen
+  inline size_t GetSize() const { return base_size + delta_size; }
+  // * GetBaseSize() * GetDeltaSize() - Returns the number of bytes of base nodes or deltas
+  inline size_t GetBaseSize() const { return base_size; }
+  inline size_t GetDeltaSize() const { return delta_size; }
+
+  void HandleLeafBase(LeafBaseType *node_p) { base_size += node_p->GetMemorySize(); Finished() = true; }
+  void HandleInnerBase(InnerBaseType *node_p) { base_size += node_p->GetMemorySize(); Finished() = true; }
+
+  void HandleLeafInsert(typename DeltaType::LeafInsertType *node_p) { AddDelta(node_p); }
+  void HandleInnerInsert(typename DeltaType::InnerInsertType *node_p) { AddDelta(node_p); }
+  void HandleLeafDelete(typename DeltaType::LeafDeleteType *node_p) { AddDelta(node_p); }
+  void HandleInnerDelete(typename DeltaType::InnerDeleteType *node_p) { AddDelta(node_p); }
+  void HandleLeafSplit(typename DeltaType::LeafSplitType *node_p) { AddDelta(node_p); }
+  void HandleInnerSplit(typename DeltaType::InnerSplitType *node_p) { AddDelta(node_p); }
+  void HandleLeafRemove(typename DeltaType::LeafRemoveType *node_p) { AddDelta(node_p); }
+  void HandleInnerRemove(typename DeltaType::InnerRemoveType *node_p) { AddDelta(node_p); }
+  void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { AddDelta(node_p); }
+
+  void HandleLeafMerge(typename DeltaType::LeafMergeType *node_p) { 
+    delta_size += sizeof(*node_p);
+    DeltaChainTraverserType::Traverse(node_p->GetNext(), this);
+    Finished() = false;
+    DeltaChainTraverserType::Traverse(node_p->GetMergeSibling(), this);
+  }
+  void HandleInnerMerge(typename DeltaType::InnerMergeType *node_p) { 
+    delta_size += sizeof(*node_p);
+    DeltaChainTraverserType::Traverse(node_p->GetNext(), this);
+    Finished() = false;
+    DeltaChainTraverserType::Traverse(node_p->GetMergeSibling(), this);
+  }
+
+ private:
+  // * AddDelta() - Counts a delta and moves to the next node
+  template <typename DeltaNodeType>
+  inline void AddDelta(DeltaNodeType *node_p) { delta_size += sizeof(DeltaNodeType); GetNext() = node_p->GetNext(); }
+
+  size_t base_size;
+  size_t delta_size;
+};
+
+/* 
+ * class DeltaChainVerifier - Checks invariants of a single delta chain
+ * 
+ * 1. Heights decrease by one on each delta except split deltas, which do not 
+ *    count in the height. The base node has height 0
+ * 2. All nodes on the chain share the low key of the base node
+ * 3. Keys of deltas are within the range of the node they are appended to,
+ *    and split keys are larger than the low key
+ * 4. Keys of the base node are sorted and within its range. The first key of 
+ *    inner nodes is not used
+ * 5. Only the first error is recorded. Merge and remove deltas are reported as 
+ *    errors because the tree does not post them
+ */
+template <typename KeyType, typename ValueType,
+          typename NodeIDType, typename DeltaChainType, 
+          template <typename, typename, typename> typename BaseNode>
+class DeltaChainVerifier : 
+  public TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType> {
+ public:
+  using BaseClassType = TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>;
+  using NodeBaseType = typename BaseClassType::NodeBaseType;
+  using DeltaType = typename BaseClassType::DeltaType;
+  using LeafBaseType = typename BaseClassType::LeafBaseType;
+  using InnerBaseType = typename BaseClassType::InnerBaseType;
+  using BoundKeyType = typename NodeBaseType::BoundKeyType;
+
+  // * DeltaChainVerifier() - Constructor
+  DeltaChainVerifier() : 
+    TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>{}, 
+    error_p{nullptr}, low_key_p{nullptr}, next_height{-1} {}
+
+  NodeBaseType *&GetNext() { return BaseClassType::next_p; }
+  bool &Finished() { return BaseClassType::finished; }
+  // * GetError() - Returns the first error, or nullptr if the chain is valid
+  inline const char *GetError() const { return error_p; }
+
+  void HandleLeafBase(LeafBaseType *node_p) { CheckNode(node_p); CheckBase(node_p, 0); Finished() = true; }
+  void HandleInnerBase(InnerBaseType *node_p) { 
+    CheckNode(node_p);
+    if(node_p->GetSize() == 0) { SetError("empty inner node"); }
+    CheckBase(node_p, 1); 
+    Finished() = true; 
+  }
+
+  void HandleLeafInsert(typename DeltaType::LeafInsertType *node_p) { CheckDelta(node_p, node_p->GetInsertKey()); }
+  void HandleInnerInsert(typename DeltaType::InnerInsertType *node_p) { CheckDelta(node_p, node_p->GetInsertKey()); }
+  void HandleLeafDelete(typename DeltaType::LeafDeleteType *node_p) { CheckDelta(node_p, node_p->GetDeleteKey()); }
+  void HandleInnerDelete(typename DeltaType::InnerDeleteType *node_p) { CheckDelta(node_p, node_p->GetDeleteKey()); }
+  void HandleLeafSplit(typename DeltaType::LeafSplitType *node_p) { CheckSplit(node_p); }
+  void HandleInnerSplit(typename DeltaType::InnerSplitType *node_p) { CheckSplit(node_p); }
+  void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { 
+    CheckDelta(node_p, node_p->GetRangeLowKey());
+    if((node_p->GetRangeLowKey() < node_p->GetRangeHighKey()) == false) { SetError("empty range of range delete delta"); }
+  }
+
+  void HandleLeafMerge(typename DeltaType::LeafMergeType *node_p) { SetError("unexpected merge delta"); Finished() = true; }
+  void HandleInnerMerge(typename DeltaType::InnerMergeType *node_p) { SetError("unexpected merge delta"); Finished() = true; }
+  void HandleLeafRemove(typename DeltaType::LeafRemoveType *node_p) { SetError("unexpected remove delta"); GetNext() = node_p->GetNext(); }
+  void HandleInnerRemove(typename DeltaType::InnerRemoveType *node_p) { SetError("unexpected remove delta"); GetNext() = node_p->GetNext(); }
+
+ private:
+  // * SetError() - Records the error if it is the first one
+  inline void SetError(const char *perror_p) { if(error_p == nullptr) { error_p = perror_p; } }
+
+  // * CheckNode() - Checks the height and the low key of a node on the chain
+  void CheckNode(NodeBaseType *node_p, int64_t height_increment = 1) {
+    if(low_key_p == nullptr) {
+      low_key_p = node_p->GetLowKey();
+    } else if(node_p->GetLowKey() != low_key_p) {
+      SetError("low key differs from the base node");
+    } else if(static_cast<int64_t>(node_p->GetHeight()) != next_height) {
+      SetError("delta chain height is not consecutive");
+    }
+
+    next_height = static_cast<int64_t>(node_p->GetHeight()) - height_increment;
+    return;
+  }
+
+  // * CheckDelta() - Checks a delta that carries a key and moves to the next node
+  template <typename DeltaNodeType>
+  void CheckDelta(DeltaNodeType *node_p, const KeyType &key, int64_t height_increment = 1) {
+    CheckNode(node_p, height_increment);
+    if(node_p->GetNext()->KeyInNode(key) == false) { SetError("delta key out of node range"); }
+    GetNext() = node_p->GetNext();
+    return;
+  }
+
+  // * CheckSplit() - Checks that the split key divides the range of the next node
+  template <typename SplitNodeType>
+  void CheckSplit(SplitNodeType *node_p) {
+    CheckDelta(node_p, node_p->GetSplitKey(), 0);
+    const BoundKeyType *low_p = node_p->GetLowKey();
+    if(low_p->IsInf() == false && *low_p >= node_p->GetSplitKey()) { SetError("split key not larger than low key"); }
+    return;
+  }
+
+  // * CheckBase() - Checks that keys starting from the given index are sorted and within range
+  template <typename BaseNodeType>
+  void CheckBase(BaseNodeType *node_p, int start) {
+    const BoundKeyType *low_p = node_p->GetLowKey();
+    for(int i = start;i < static_cast<int>(node_p->GetSize());i++) {
+      const KeyType &key = node_p->KeyAt(i);
+      if(node_p->KeyInNode(key) == false) { SetError("base node key out of node range"); }
+      if(i > start && (node_p->KeyAt(i - 1) < key) == false) { SetError("base node keys not sorted"); }
+      // Separators of inner nodes must be strictly larger than the low key
+      if(start > 0 && low_p->IsInf() == false && *low_p == key) { SetError("separator equals low key"); }
+    }
+
+    return;
+  }
+
+  const char *error_p;
+  BoundKeyType *low_key_p;
+  int64_t next_height;
+};
+
+// * class BaseNodeIterator - Provides a set of interfaces for iterating on base nodes
+template <typename _BaseNodeType>
+class BaseNodeIterator {
+ public:
+  // Referred to by external classes
+  using BaseNodeType = _BaseNodeType;
+  using NodeSizeType = typename BaseNodeType::NodeSizeType;
+  using KeyType = typename BaseNodeType::KeyType;
+  using ValueType = typename BaseNodeType::ValueType;
+  // * BaseNodeIterator() - Constructors
+  BaseNodeIterator(BaseNodeType *pnode_p) : node_p{pnode_p}, index{0} {}
+  BaseNodeIterator() : node_p{nullptr}, index{0} {}
+
+  // * Inited() - Returns false if the node has not been initialized
+  inline bool Inited() { return node_p != nullptr; }
+  // * IsEnd() - Whether the iterator has finished iterating over the node
+  inline bool IsEnd() { return index == node_p->GetSize(); }
+  inline BaseNodeType *GetNode() { return node_p; }
+  inline KeyType &GetKey() { assert(!IsEnd()); return node_p->KeyAt(index); }
+  inline ValueType &GetValue() { assert(!IsEnd()); return node_p->ValueAt(index); }
+  // * Next() - Advance to the next key
+  inline void Next() { assert(index < node_p->GetSize()); index++; }
+  // * Append() - Appends a key and value to the current position and advance
+  inline void Append(const KeyType &key, const ValueType &value) { GetKey() = key; GetValue() = value; Next(); }
+  
+  BaseNodeType *node_p;
+  NodeSizeType index;
+};
+
+/* 
+ * class DefaultConsolidator - Implements consolidation algorithm
+ * 
+ * The consolidation algorithm uses two lists: inserted list and deleted list
+ * The routine traverses down the delta chain in the normal order. For insert
+ * deltas, the keys are first tested against the deleted list to see if it is 
+ * already deleted. If not, then it is added into the inserted list after testing
+ * for duplication. For delete deltas, they are tested against the inserted list,
+ * and then added to the deleted list after a duplicated key test if both tests 
+ * return negative.
+ * 
+ * On the base level, the inserted list is first sorted, from largest to smallest.
+ * Then a two-way merge is performed to derive the new node. Each data item in the
+ * base node is also tested against the deleted list.
+ * 
+ * Split nodes change the current high key of the virtual node. The updated high
+ * key should be recorded. When traversing the base node and the delta chain, 
+ * keys larger than the current high key will be ignored, as they belong to 
+ * the split sibling.
+ * 
+ * Merge nodes are processed recursively. Contexts should be saved and restored 
+ * before and after the recursion. For example, the current high key will be 
+ * saved and restored before and after both siblings are traversed. As an optimization,
+ * the deleted list could also be restored, as we know the two siblings will not share
+ * any deleted item.
+ * 
+ * Range delete deltas are kept in a third list. A key covered by a range seen so
+ * far is treated as deleted, since all deltas and base items after the range
+ * delete are older than it.
+ * 
+ * In visit mode, the leaf base node is only recorded. VisitLeaf() then runs the
+ * same merge, but passes each item to a callback, such that scans could read a
+ * leaf without building a new node.
+ */
+template <typename KeyType, typename ValueType,
+          typename NodeIDType, typename DeltaChainType, 
+          template <typename, typename, typename> typename BaseNode,
+          size_t HEIGHT_THRESHOLD>
+class DefaultConsolidator : 
+  public TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>,
+  public UniqueKeyBase {
+ public:
+  using BaseClassType = TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>;
+  using NodeBaseType = typename BaseClassType::NodeBaseType;
+  using DeltaType = typename BaseClassType::DeltaType;
+  using LeafBaseType = typename BaseClassType::LeafBaseType;
+  using InnerBaseType = typename BaseClassType::InnerBaseType;
+  using NodeHeightType = typename NodeBaseType::NodeHeightType;
+  using NodeSizeType = typename NodeBaseType::NodeSizeType;
+  using DeltaChainTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DefaultConsolidator>;
+  using KeyPtrGreaterType = KeyPtrGreater<KeyType>;
+
+  using LeafNodeIteratorType = BaseNodeIterator<LeafBaseType>;
+  using InnerNodeIteratorType = BaseNodeIterator<InnerBaseType>;
+
+  // * class Visitor - Merge target that passes items to a callback instead of writing a new node
+  template <typename Callback>
+  class Visitor {
+   public:
+    Visitor(Callback *pcb_p) : cb_p{pcb_p} {}
+    inline void Append(const KeyType &key, const ValueType &value) { (*cb_p)(key, value); }
+   private:
+    Callback *cb_p;
+  };
+
+  // * DefaultConsolidator() - Constructor. In visit mode no new node is built, see VisitLeaf()
+  DefaultConsolidator(NodeBaseType *pold_node_p, bool pvisit = false) : 
+    TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>{},
+    inserted_num{NodeHeightType{0}},
+    deleted_num{NodeHeightType{0}},
+    range_num{NodeHeightType{0}},
+    current_high_key_p{nullptr},
     old_node_p{pold_node_p},
+    visit{pvisit},
+    visit_base_p{nullptr},
     new_leaf_node_it{} { assert(new_inner_node_it.GetNode() == nullptr); }
 
   NodeBaseType *&GetNext() { return BaseClassType::next_p; }
@@ -1199,8 +1966,15 @@ class DefaultConsolidator :
   }
   // * IsInserted() - Whether the key is in the inserted set
   inline bool IsInserted(const KeyType &key) { return IsInList(key, inserted_list, inserted_num); }
-  // * IsDeleted() - Whether the key is in the deleted set
-  inline bool IsDeleted(const KeyType &key) { return IsInList(key, deleted_list, deleted_num); }
+  // * IsInRange() - Whether the key is covered by a range delete seen so far
+  bool IsInRange(const KeyType &key) {
+    for(NodeHeightType i = 0;i < range_num;i++) { 
+      if(range_list[i]->GetRangeLowKey() <= key && key < range_list[i]->GetRangeHighKey()) { return true; } 
+    }
+    return false;
+  }
+  // * IsDeleted() - Whether the key is in the deleted set or in a deleted range
+  inline bool IsDeleted(const KeyType &key) { return IsInList(key, deleted_list, deleted_num) || IsInRange(key); }
   // * Insert() - Adds a key into the inserted list
   void Insert(KeyType *key_p) {
     if(IsDeleted(*key_p) == false && IsInserted(*key_p) == false) {
@@ -1212,8 +1986,11 @@ class DefaultConsolidator :
     }
   }
   // * Delete() - Adds a key into the deleted list
+  // 
+  // Keys re-inserted by a newer delta are still added, such that the stale 
+  // copy in the base node is filtered out during the merge
   void Delete(KeyType *key_p) {
-    if(IsInserted(*key_p) == false && IsDeleted(*key_p) == false) {
+    if(IsDeleted(*key_p) == false) {
       if(current_high_key_p == nullptr || *key_p < *current_high_key_p) {
         assert(deleted_num < HEIGHT_THRESHOLD);
         deleted_list[deleted_num] = key_p;
@@ -1259,17 +2036,17 @@ class DefaultConsolidator :
   /* 
    * MergeLoop() - Merges an insert list and a base node
    * 
-   * 1. IteratorType is the type of the iterator. This argument can be deduced
+   * 1. TargetType is the type of the target, which is an iterator of the new node
+   *    or a Visitor. It only needs Append(). This argument can be deduced
    * 2. DeltaInsertType is either leaf insert delta type or inner insert delta type
    *    It is used to fetch the payload (either node ID or value type) from the key's pointer
    * 3. For base nodes, since the low key could be -Inf, we ignore the first key-NodeID item.
    */
-  template <typename DeltaInsertType, typename IteratorType>
-  void MergeLoop(typename IteratorType::BaseNodeType *node_p, IteratorType *target_it_p) {
-    using BaseNodeType = typename IteratorType::BaseNodeType;
+  template <typename DeltaInsertType, typename BaseNodeType, typename TargetType>
+  void MergeLoop(BaseNodeType *node_p, TargetType *target_it_p) {
     assert(node_p->GetType() == NodeType::InnerBase || node_p->GetType() == NodeType::LeafBase);
     // The iterator wrappes an index with the node pointer
-    IteratorType it{node_p};
+    BaseNodeIterator<BaseNodeType> it{node_p};
     // If the low key is -Inf, and we know it is inner node, then ignore the first item
     if(node_p->GetType() == NodeType::InnerBase) {
       assert(it.IsEnd() == false);
@@ -1298,7 +2075,6 @@ class DefaultConsolidator :
         dbg_printf("Flush insert stack\n");
         // Copy insert list
         while(!IsTopStopped()) {
-          dbg_printf("  key = %d\n", TopKey());
           target_it_p->Append(TopKey(), TopPayload<BaseNodeType, DeltaInsertType>());
           InsertPop();
         }
@@ -1326,6 +2102,11 @@ class DefaultConsolidator :
   void HandleLeafBase(LeafBaseType *node_p) { 
     dbg_printf("Handle leaf base\n");
     SortInsertedList();
+    if(visit == true) {
+      visit_base_p = node_p;
+      Finished() = true;
+      return;
+    }
     if(!new_leaf_node_it.Inited()) {
       new_leaf_node_it = LeafNodeIteratorType{static_cast<LeafBaseType *>(
         LeafBaseType::Get(NodeType::LeafBase, old_node_p->GetSize(), *old_node_p->GetLowKey(), *old_node_p->GetHighKey()))};
@@ -1359,13 +2140,23 @@ class DefaultConsolidator :
   void HandleLeafSplit(typename DeltaType::LeafSplitType *node_p) { GetNext() = node_p->GetNext(); current_high_key_p = &node_p->GetSplitKey(); }
   void HandleInnerSplit(typename DeltaType::InnerSplitType *node_p) { GetNext() = node_p->GetNext(); current_high_key_p = &node_p->GetSplitKey(); }
 
+  void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { 
+    GetNext() = node_p->GetNext(); 
+    assert(range_num < HEIGHT_THRESHOLD);
+    range_list[range_num++] = node_p;
+  }
+
   // Special for merge because we recursively traverse it
   void HandleLeafMerge(typename DeltaType::LeafMergeType *node_p) { 
+    // Visit mode only keeps one base node
+    assert(visit == false);
     // Save this such that we do not need to compare
     NodeHeightType saved_deleted_num = deleted_num;
+    NodeHeightType saved_range_num = range_num;
     KeyType *saved_high_key_p = current_high_key_p;
     DeltaChainTraverserType::Traverse(node_p->GetNext(), this);
     deleted_num = saved_deleted_num;
+    range_num = saved_range_num;
     current_high_key_p = saved_high_key_p;
     Finished() = false;
     DeltaChainTraverserType::Traverse(node_p->GetMergeSibling(), this);
@@ -1380,6 +2171,21 @@ class DefaultConsolidator :
     DeltaChainTraverserType::Traverse(node_p->GetMergeSibling(), this);
   }
 
+  /*
+   * VisitLeaf() - Calls the callback on the items of a leaf traversed in visit
+   *               mode in key order, merging the deltas with the base node in place
+   * 
+   * The callback is of signature void(const KeyType &, const ValueType &). Can 
+   * only be called once
+   */
+  template <typename Callback>
+  void VisitLeaf(Callback &&cb) {
+    assert(visit == true && visit_base_p != nullptr);
+    Visitor<typename std::remove_reference<Callback>::type> visitor{&cb};
+    MergeLoop<typename DeltaType::LeafInsertType>(visit_base_p, &visitor);
+    return;
+  }
+
   // * GetNewLeafBase() * GetNewInnerBase() - Returns the node after consolidation
   LeafBaseType *GetNewLeafBase() { return new_leaf_node_it.GetNode(); }
   InnerBaseType *GetNewInnerBase() { return new_inner_node_it.GetNode(); }
@@ -1388,14 +2194,19 @@ class DefaultConsolidator :
   // A list of pointers to keys within deltas
   KeyType *inserted_list[HEIGHT_THRESHOLD];
   KeyType *deleted_list[HEIGHT_THRESHOLD];
+  typename DeltaType::LeafRangeDeleteType *range_list[HEIGHT_THRESHOLD];
   NodeHeightType inserted_num;
   NodeHeightType deleted_num;
+  NodeHeightType range_num;
   // The current high key on the branch
   // If nullptr then did not see a split node yet (can be +Inf),
   // in which case all elements are processed
   KeyType *current_high_key_p;
   // The node before consolidation
   NodeBaseType *old_node_p;
+  // Whether the leaf base node is only recorded for VisitLeaf()
+  bool visit;
+  LeafBaseType *visit_base_p;
   // The node after consolidation
   union {
     LeafNodeIteratorType new_leaf_node_it;
@@ -1403,7 +2214,23 @@ class DefaultConsolidator :
   };
 };
 
-// * class ValueSearcher - Searches using a key and returns the value or node ID
+/*
+ * class ValueSearcher - Searches using a key and returns the value or node ID
+ * 
+ * 1. On leaf level the search stops at the first insert or delete delta with 
+ *    a matching key, at the first range delete delta covering the key, or at 
+ *    the base node. The value pointer is nullptr if the key does not exist
+ * 2. On inner level the search stops at the first insert or delete delta whose
+ *    range covers the key, or at the base node, and reports the child node ID
+ * 3. If the key is not less than the split key of a split delta, the search 
+ *    stops and reports the sibling node ID. The caller should then search the 
+ *    sibling on the same level, which is indicated by GoRight()
+ * 4. If a remove delta is seen, or if the key is out of the range of the base
+ *    node (i.e. the split delta has been consolidated and the caller has a stale
+ *    view of the parent), the search is aborted and the caller should restart
+ * 5. If a snapshot is given, leaf deltas newer than the snapshot are skipped, and
+ *    the leaf base node is read through its versions
+ */
 template <typename KeyType, typename ValueType,
           typename MappingTableType, typename DeltaChainType, 
           template <typename, typename, typename> typename BaseNode>
@@ -1419,99 +2246,3816 @@ class ValueSearcher :
   using InnerBaseType = typename BaseClassType::InnerBaseType;
   using NodeHeightType = typename NodeBaseType::NodeHeightType;
   using NodeSizeType = typename NodeBaseType::NodeSizeType;
+  using DeltaChainTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, ValueSearcher>;
   static constexpr NodeIDType INVALID_NODE_ID = MappingTableType::INVALID_NODE_ID;
 
-  // * ValueSearcher() - Constructor
-  ValueSearcher(NodeBaseType *pnode_p) : 
+  // * ValueSearcher() - Constructor. Leaf deltas newer than the snapshot are skipped
+  ValueSearcher(const KeyType &pkey, uint64_t psnapshot = DeltaVersion::LATEST) : 
     TraverseHandlerBase<KeyType, ValueType, NodeIDType, DeltaChainType>{},
-    node_p{pnode_p}, next_id{INVALID_NODE_ID}, abort{false} {}
+    key{pkey}, snapshot{psnapshot}, next_id{INVALID_NODE_ID}, value_p{nullptr}, go_right{false}, abort{false} {}
 
   NodeBaseType *&GetNext() { return BaseClassType::next_p; }
   bool &Finished() { return BaseClassType::finished; }
 
   void HandleLeafBase(LeafBaseType *node_p) { 
+    if(node_p->KeyInNode(key) == false) {
+      abort = true;
+    } else {
+      auto *version_p = snapshot == DeltaVersion::LATEST ? nullptr : node_p->FindVersion(key, snapshot);
+      if(version_p != nullptr) {
+        if(version_p->exists == true) { value_p = &version_p->value; }
+      } else if(node_p->GetSize() > 0) {
+        int index = node_p->PointSearch(key);
+        if(index >= 0) { value_p = &node_p->ValueAt(index); }
+      }
+    }
     Finished() = true; 
-    return;
   }
 
   void HandleInnerBase(InnerBaseType *node_p) { 
+    if(node_p->KeyInNode(key) == false) {
+      abort = true;
+    } else {
+      next_id = node_p->ValueAt(node_p->Search(key));
+    }
     Finished() = true; 
-    return;
   }
 
-  void HandleLeafInsert(typename DeltaType::LeafInsertType *node_p) { GetNext() = node_p->GetNext();  }
-  void HandleInnerInsert(typename DeltaType::InnerInsertType *node_p) { GetNext() = node_p->GetNext();  }
+  void HandleLeafInsert(typename DeltaType::LeafInsertType *node_p) { 
+    if(node_p->GetInsertKey() == key && node_p->GetVersion().Get() <= snapshot) { 
+      value_p = &node_p->GetInsertValue(); Finished() = true; 
+    } else { GetNext() = node_p->GetNext(); }
+  }
+  void HandleInnerInsert(typename DeltaType::InnerInsertType *node_p) { 
+    // The inserted separator covers [insert key, next key)
+    if(key >= node_p->GetInsertKey() && (node_p->GetNextKey().IsInf() || node_p->GetNextKey() > key)) { 
+      next_id = node_p->GetInsertNodeID(); Finished() = true; 
+    } else { GetNext() = node_p->GetNext(); }
+  }
+
+  void HandleLeafDelete(typename DeltaType::LeafDeleteType *node_p) { 
+    if(node_p->GetDeleteKey() == key && node_p->GetVersion().Get() <= snapshot) { Finished() = true; } 
+    else { GetNext() = node_p->GetNext(); }
+  }
+  void HandleInnerDelete(typename DeltaType::InnerDeleteType *node_p) { 
+    // The deleted separator merges [prev key, next key) into the previous node ID
+    if((node_p->GetPrevKey().IsInf() || node_p->GetPrevKey() <= key) && 
+       (node_p->GetNextKey().IsInf() || node_p->GetNextKey() > key)) { 
+      next_id = node_p->GetPrevNodeID(); Finished() = true; 
+    } else { GetNext() = node_p->GetNext(); }
+  }
 
-  void HandleLeafDelete(typename DeltaType::LeafDeleteType *node_p) { GetNext() = node_p->GetNext();  }
-  void HandleInnerDelete(typename DeltaType::InnerDeleteType *node_p) { GetNext() = node_p->GetNext();  }
+  void HandleLeafRangeDelete(typename DeltaType::LeafRangeDeleteType *node_p) { 
+    if(node_p->GetRangeLowKey() <= key && key < node_p->GetRangeHighKey() && node_p->GetVersion().Get() <= snapshot) { 
+      Finished() = true; 
+    } else { GetNext() = node_p->GetNext(); }
+  }
 
-  void HandleLeafSplit(typename DeltaType::LeafSplitType *node_p) { GetNext() = node_p->GetNext(); }
-  void HandleInnerSplit(typename DeltaType::InnerSplitType *node_p) { GetNext() = node_p->GetNext(); }
+  void HandleLeafSplit(typename DeltaType::LeafSplitType *node_p) { HandleSplit(node_p); }
+  void HandleInnerSplit(typename DeltaType::InnerSplitType *node_p) { HandleSplit(node_p); }
 
+  // Only one of the two branches of the merge delta is traversed recursively
   void HandleLeafMerge(typename DeltaType::LeafMergeType *node_p) { 
+    DeltaChainTraverserType::Traverse(
+      key >= node_p->GetMergeKey() ? node_p->GetMergeSibling() : node_p->GetNext(), this);
   }
   void HandleInnerMerge(typename DeltaType::InnerMergeType *node_p) { 
+    DeltaChainTraverserType::Traverse(
+      key >= node_p->GetMergeKey() ? node_p->GetMergeSibling() : node_p->GetNext(), this);
   }
+
+  void HandleLeafRemove(typename DeltaType::LeafRemoveType *node_p) { abort = true; Finished() = true; }
+  void HandleInnerRemove(typename DeltaType::InnerRemoveType *node_p) { abort = true; Finished() = true; }
+
+  // * GetValue() - Returns the pointer to the value, or nullptr if not found (leaf only)
+  inline ValueType *GetValue() const { return value_p; }
+  // * GetNextID() - Returns the child node ID, or the sibling ID if GoRight() is true
+  inline NodeIDType GetNextID() const { return next_id; }
+  // * GoRight() - Whether the search should continue on the split sibling
+  inline bool GoRight() const { return go_right; }
+  // * IsAborted() - Whether the search should restart from the root
+  inline bool IsAborted() const { return abort; }
+
  private:
-  NodeBaseType *node_p;
-  // Node id to the next level
+  // * HandleSplit() - Leaf and inner split deltas have the same layout
+  void HandleSplit(typename DeltaType::LeafSplitType *node_p) {
+    if(*node_p->GetHighKey() <= key) {
+      next_id = node_p->GetSplitNodeID(); go_right = true; Finished() = true;
+    } else { GetNext() = node_p->GetNext(); }
+  }
+
+  // The search key
+  KeyType key;
+  // Version of the snapshot on the leaf level. Versions of deltas must have been resolved
+  uint64_t snapshot;
+  // Node id to the next level or to the split sibling
   NodeIDType next_id;
   // Value that matches the key
   ValueType *value_p;
+  bool go_right;
   bool abort;
 };
 
-template <typename _KeyType, typename _ValueType, 
-          template <typename, size_t> typename MappingTable, 
-          typename _DeltaChainType, 
-          template <typename, typename, typename> typename BaseNode,
-          template <typename, typename, typename, typename, template <typename, typename, typename> typename, size_t> typename Consolidator>
-class BwTree {
+/*
+ * class DefaultEpochManager - Implements epoch based garbage collection
+ * 
+ * 1. Epochs are organized as a linked list from the oldest to the latest. 
+ *    Threads join the latest epoch before accessing the tree, and leave the 
+ *    epoch after the operation by decrementing the active thread counter
+ * 2. Garbage is always added into the latest epoch. The caller must be inside
+ *    an epoch when adding garbage, which prevents the latest epoch from being
+ *    reclaimed before the garbage is linked into its list
+ * 3. PerformGC() creates a new epoch, and then reclaims epochs from the oldest
+ *    one until an epoch with active threads or the latest epoch is reached
+ * 4. Reclaimed epoch nodes are never freed before destruction, but recycled as
+ *    new epochs. The counter of a reclaimed epoch is offset by a large negative 
+ *    value such that threads that load a stale epoch pointer could detect it 
+ *    and retry on the latest epoch
+ * 5. Only one thread performs GC at a time. Others simply return
+ */
+template <typename GarbageType>
+class DefaultEpochManager {
  public:
-  static constexpr size_t MAPPING_TABLE_SIZE = 1204 * 1024 * 16;
-  static constexpr size_t LEAF_HEIGHT_THREADHOLD = 24;
-  static constexpr size_t INNER_HEIGHT_THRESHOLD = 2;
-  static constexpr size_t HEIGHT_THREADHOLD = \
-    LEAF_HEIGHT_THREADHOLD > INNER_HEIGHT_THRESHOLD ? LEAF_HEIGHT_THREADHOLD : INNER_HEIGHT_THRESHOLD;
-  // Argument types
-  using KeyType = _KeyType;
-  using ValueType = _ValueType;
-  using DeltaChainType = _DeltaChainType;
-  // Derived types
-  using NodeBaseType = NodeBase<KeyType>;
-  using ExtendedBaseType = ExtendedNodeBase<KeyType, DeltaChainType>;
-  using MappingTableType = MappingTable<NodeBaseType, MAPPING_TABLE_SIZE>;
-  // Metadata variable types
-  using NodeIDType = typename MappingTableType::NodeIDType;
-  using NodeSizeType = typename NodeBaseType::NodeSizeType;
-  using NodeHeightType = typename NodeBaseType::NodeHeightType;
-  using BoundKeyType = typename NodeBaseType::BoundKeyType;
-  // Delta and base node types
-  using DeltaType = Delta<KeyType, ValueType, NodeIDType>;
-  using LeafBaseType = BaseNode<KeyType, ValueType, DeltaChainType>;
-  using InnerBaseType = BaseNode<KeyType, NodeIDType, DeltaChainType>;
-  using LeafInsertType = typename DeltaType::LeafInsertType;
-  using LeafDeleteType = typename DeltaType::LeafDeleteType;
-  using LeafSplitType = typename DeltaType::LeafSplitType;
-  using LeafMergeType = typename DeltaType::LeafMergeType;
-  using LeafRemoveType = typename DeltaType::LeafRemoveType;
-  using InnerInsertType = typename DeltaType::InnerInsertType;
-  using InnerDeleteType = typename DeltaType::InnerDeleteType;
-  using InnerSplitType = typename DeltaType::InnerSplitType;
-  using InnerMergeType = typename DeltaType::InnerMergeType;
-  using InnerRemoveType = typename DeltaType::InnerRemoveType;
-  // Helper types
-  using AppendHelperType = AppendHelper<KeyType, ValueType, MappingTableType, DeltaChainType>;
-  using DeltaChainFreeHelperType = DeltaChainFreeHelper<KeyType, ValueType, MappingTableType, DeltaChainType, BaseNode>;
-  using ConsolidatorType = Consolidator<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, HEIGHT_THREADHOLD>;
-  using ValueSearcherType = ValueSearcher<KeyType, ValueType, MappingTableType, DeltaChainType, BaseNode>;
-  static_assert(ConsolidatorType::support_non_unique_key == LeafBaseType::support_non_unique_key, "Inconsistent non-unique key support");
-  static_assert(ValueSearcherType::support_non_unique_key == LeafBaseType::support_non_unique_key, "Inconsistent non-unique key support");
+  using FreeFuncType = std::function<void(GarbageType *)>;
+  // Counter offset of reclaimed epochs
+  static constexpr int64_t RECLAIMED_OFFSET = INT64_MIN / 2;
+
+  // * class GarbageNode - Linked list node of the garbage list
+  class GarbageNode {
+   public:
+    GarbageType *garbage_p;
+    GarbageNode *next_p;
+  };
+
+  // * class EpochNode - Linked list node of the epoch list
+  class EpochNode {
+   public:
+    EpochNode() : active_thread_count{0}, garbage_list_p{nullptr}, next_p{nullptr} {}
+    std::atomic<int64_t> active_thread_count;
+    std::atomic<GarbageNode *> garbage_list_p;
+    EpochNode *next_p;
+  };
+
+  // * DefaultEpochManager() - Constructor
+  DefaultEpochManager(const FreeFuncType &pfree_func) :
+    free_func{pfree_func}, 
+    head_epoch_p{new EpochNode{}}, 
+    current_epoch_p{head_epoch_p}, 
+    free_epoch_p{nullptr},
+    gc_flag{false} {}
+
+  /*
+   * ~DefaultEpochManager() - Destructor
+   * 
+   * All garbage is freed. The caller must guarantee that no thread is in any epoch
+   */
+  ~DefaultEpochManager() {
+    FreeEpochList(head_epoch_p);
+    FreeEpochList(free_epoch_p);
+    return;
+  }
+
+  // * JoinEpoch() - Joins the latest epoch and returns it
+  EpochNode *JoinEpoch() {
+    while(true) {
+      EpochNode *epoch_p = current_epoch_p.load();
+      if(epoch_p->active_thread_count.fetch_add(1) >= 0) { return epoch_p; }
+      // The epoch has been reclaimed before we join. Retry on the latest one
+      epoch_p->active_thread_count.fetch_sub(1);
+    }
+  }
+
+  // * LeaveEpoch() - Leaves the epoch returned by JoinEpoch()
+  inline void LeaveEpoch(EpochNode *epoch_p) { epoch_p->active_thread_count.fetch_sub(1); }
+
+  // * AddGarbage() - Adds garbage into the latest epoch
+  void AddGarbage(GarbageType *garbage_p) {
+    EpochNode *epoch_p = current_epoch_p.load();
+    GarbageNode *node_p = new GarbageNode{garbage_p, epoch_p->garbage_list_p.load()};
+    while(epoch_p->garbage_list_p.compare_exchange_weak(node_p->next_p, node_p) == false) {}
+    return;
+  }
+
+  // * AddGarbageList() - Adds a batch of garbage into the latest epoch with one CAS
+  void AddGarbageList(GarbageType * const *garbage_list, size_t num) {
+    if(num == 0) { return; }
+    GarbageNode *last_p = new GarbageNode{garbage_list[0], nullptr};
+    GarbageNode *first_p = last_p;
+    for(size_t i = 1;i < num;i++) { first_p = new GarbageNode{garbage_list[i], first_p}; }
+    EpochNode *epoch_p = current_epoch_p.load();
+    last_p->next_p = epoch_p->garbage_list_p.load();
+    while(epoch_p->garbage_list_p.compare_exchange_weak(last_p->next_p, first_p) == false) {}
+    return;
+  }
+
+  /*
+   * PerformGC() - Creates a new epoch and reclaims old epochs
+   * 
+   * Returns false if another thread is performing GC
+   */
+  bool PerformGC() {
+    if(gc_flag.exchange(true) == true) { return false; }
+    CreateNewEpoch();
+    ClearEpoch();
+    gc_flag.store(false);
+    return true;
+  }
+
+ private:
+  // * CreateNewEpoch() - Appends a new epoch to the list. Only called by the GC thread
+  void CreateNewEpoch() {
+    EpochNode *epoch_p = free_epoch_p;
+    if(epoch_p == nullptr) {
+      epoch_p = new EpochNode{};
+    } else {
+      free_epoch_p = epoch_p->next_p;
+      epoch_p->next_p = nullptr;
+      epoch_p->active_thread_count.fetch_sub(RECLAIMED_OFFSET);
+    }
+
+    current_epoch_p.load()->next_p = epoch_p;
+    current_epoch_p.store(epoch_p);
+    return;
+  }
+
+  // * ClearEpoch() - Reclaims old epochs without active threads. Only called by the GC thread
+  void ClearEpoch() {
+    while(head_epoch_p != current_epoch_p.load()) {
+      int64_t expected = 0;
+      if(head_epoch_p->active_thread_count.compare_exchange_strong(expected, RECLAIMED_OFFSET) == false) {
+        break;
+      }
+
+      FreeGarbageList(head_epoch_p->garbage_list_p.exchange(nullptr));
+      EpochNode *next_p = head_epoch_p->next_p;
+      head_epoch_p->next_p = free_epoch_p;
+      free_epoch_p = head_epoch_p;
+      head_epoch_p = next_p;
+    }
+
+    return;
+  }
+
+  // * FreeGarbageList() - Frees garbage using the callback, and the list itself
+  void FreeGarbageList(GarbageNode *node_p) {
+    while(node_p != nullptr) {
+      GarbageNode *next_p = node_p->next_p;
+      free_func(node_p->garbage_p);
+      delete node_p;
+      node_p = next_p;
+    }
+
+    return;
+  }
+
+  // * FreeEpochList() - Frees epoch nodes and their garbage
+  void FreeEpochList(EpochNode *epoch_p) {
+    while(epoch_p != nullptr) {
+      EpochNode *next_p = epoch_p->next_p;
+      FreeGarbageList(epoch_p->garbage_list_p.load());
+      delete epoch_p;
+      epoch_p = next_p;
+    }
+
+    return;
+  }
+
+  // Callback for freeing garbage
+  FreeFuncType free_func;
+  // The oldest epoch that has not been reclaimed
+  EpochNode *head_epoch_p;
+  // The latest epoch
+  std::atomic<EpochNode *> current_epoch_p;
+  // Reclaimed epoch nodes for recycling
+  EpochNode *free_epoch_p;
+  // Set if a thread is performing GC
+  std::atomic<bool> gc_flag;
+};
+
+/*
+ * class ThreadLocalShards - An array of per-thread objects indexed by ThreadIndex
+ * 
+ * 1. The shard of a thread is allocated on its first access. A shard outlives
+ *    its thread, and is reused by the next thread that gets the same index. 
+ *    Therefore a shard is only written by one thread at a time
+ * 2. Other threads may read all shards using ForEach(). Shards that are being 
+ *    written concurrently should only be read with atomic loads
+ */
+template <typename ShardType>
+class ThreadLocalShards {
+ public:
+  // * ThreadLocalShards() - Constructor
+  ThreadLocalShards() {
+    for(size_t i = 0;i < ThreadIndex::MAX_THREAD;i++) { shard_list[i].store(nullptr); }
+    return;
+  }
+
+  // * ~ThreadLocalShards() - Destructor
+  ~ThreadLocalShards() {
+    for(size_t i = 0;i < ThreadIndex::MAX_THREAD;i++) { delete shard_list[i].load(); }
+    return;
+  }
+
+  // * GetLocal() - Returns the shard of the calling thread
+  inline ShardType *GetLocal() { return GetLocal(ThreadIndex::Get()); }
+
+  // * GetLocal() - Returns the shard of the given thread index, which the caller owns
+  inline ShardType *GetLocal(size_t thread_index) {
+    assert(thread_index < ThreadIndex::MAX_THREAD);
+    std::atomic<ShardType *> &shard = shard_list[thread_index];
+    ShardType *shard_p = shard.load(std::memory_order_relaxed);
+    if(shard_p == nullptr) {
+      shard_p = new ShardType{};
+      shard.store(shard_p);
+    }
+
+    return shard_p;
+  }
+
+  // * ForEach() - Calls the callback on each allocated shard
+  template <typename Callback>
+  void ForEach(Callback &&cb) const {
+    for(size_t i = 0;i < ThreadIndex::MAX_THREAD;i++) {
+      ShardType *shard_p = shard_list[i].load();
+      if(shard_p != nullptr) { cb(shard_p); }
+    }
+
+    return;
+  }
+
+ private:
+  std::atomic<ShardType *> shard_list[ThreadIndex::MAX_THREAD];
+};
+
+/*
+ * class ShardedCounter - A set of counters with one shard per thread
+ * 
+ * 1. Each thread updates its own shard with relaxed load and store, which is
+ *    as cheap as a plain increment and does not bounce cache lines
+ * 2. Get() sums all shards. The sum is not a consistent snapshot across
+ *    counters if threads are updating them
+ */
+template <size_t COUNTER_COUNT>
+class ShardedCounter {
+ public:
+  // Shards are padded such that counters of two threads are not on the same cache line
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  // * class Shard - Counters of one thread
+  class Shard {
+   public:
+    Shard() { for(size_t i = 0;i < COUNTER_COUNT;i++) { counter_list[i].store(0); } }
+    std::atomic<uint64_t> counter_list[COUNTER_COUNT];
+    char padding[CACHE_LINE_SIZE];
+  };
+
+  // * Add() - Adds to a counter of the calling thread
+  inline void Add(size_t index, uint64_t delta) { Add(index, delta, ThreadIndex::Get()); }
+
+  // * Add() - Adds to a counter of the given thread index
+  inline void Add(size_t index, uint64_t delta, size_t thread_index) {
+    assert(index < COUNTER_COUNT);
+    std::atomic<uint64_t> &counter = shards.GetLocal(thread_index)->counter_list[index];
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    return;
+  }
+
+  // * Sub() - Subtracts from a counter of the calling thread. A shard may wrap
+  //           around, but the sum over all shards is correct
+  inline void Sub(size_t index, uint64_t delta) { Add(index, uint64_t{0} - delta); }
+  // * Sub() - Subtracts from a counter of the given thread index
+  inline void Sub(size_t index, uint64_t delta, size_t thread_index) { Add(index, uint64_t{0} - delta, thread_index); }
+
+  // * Get() - Returns the sum of a counter over all threads
+  uint64_t Get(size_t index) const {
+    assert(index < COUNTER_COUNT);
+    uint64_t sum = 0;
+    shards.ForEach([index, &sum](Shard *shard_p) { sum += shard_p->counter_list[index].load(std::memory_order_relaxed); });
+    return sum;
+  }
+
+  // * GetSigned() - Returns the sum as a signed value, for counters that are also decremented
+  inline int64_t GetSigned(size_t index) const { return static_cast<int64_t>(Get(index)); }
+
+ private:
+  ThreadLocalShards<Shard> shards;
+};
+
+/*
+ * class LatencyRecorder - Records latency of each operation type in per-thread histograms
+ * 
+ * 1. Each thread records into its own shard. Recording does not use atomic instructions
+ * 2. Merge() sums the shards of all threads on demand. Shards being written
+ *    concurrently may be read partially, so the result is approximate unless
+ *    the recorder is quiescent
+ * 3. OP_COUNT is the number of operation types. Types are defined by the user
+ */
+template <size_t OP_COUNT>
+class LatencyRecorder {
+ public:
+  using ClockType = std::chrono::steady_clock;
+
+  // * class Shard - Histograms of one thread
+  class Shard {
+   public:
+    LatencyHistogram histogram_list[OP_COUNT];
+  };
+
+  /*
+   * class Scope - Records the time between construction and destruction
+   */
+  class Scope {
+   public:
+    Scope(LatencyRecorder *precorder_p, size_t pop) : 
+      recorder_p{precorder_p}, op{pop}, start{ClockType::now()} {}
+    ~Scope() { 
+      recorder_p->Record(op, std::chrono::duration_cast<std::chrono::nanoseconds>(ClockType::now() - start).count()); 
+    }
+   private:
+    LatencyRecorder *recorder_p;
+    size_t op;
+    ClockType::time_point start;
+  };
+
+  // * Record() - Records a sample of the given type in nanoseconds
+  inline void Record(size_t op, uint64_t ns) {
+    assert(op < OP_COUNT);
+    shards.GetLocal()->histogram_list[op].Record(ns);
+    return;
+  }
+
+  // * Merge() - Returns the sum of histograms of the given type over all threads
+  LatencyHistogram Merge(size_t op) const {
+    assert(op < OP_COUNT);
+    LatencyHistogram histogram{};
+    shards.ForEach([op, &histogram](Shard *shard_p) { histogram.Merge(shard_p->histogram_list[op]); });
+    return histogram;
+  }
+
+  // * Reset() - Clears all histograms. Must not be called concurrently with Record()
+  void Reset() {
+    shards.ForEach([](Shard *shard_p) { 
+      for(size_t op = 0;op < OP_COUNT;op++) { shard_p->histogram_list[op].Reset(); } 
+    });
+    return;
+  }
+
+ private:
+  ThreadLocalShards<Shard> shards;
+};
+
+/*
+ * class CheckpointHeader - The header of a checkpoint file written by BwTree::Checkpoint()
+ *
+ * 1. The file consists of the header, data blocks and the sparse index, in this
+ *    order. Integers, keys and values are stored in host byte order
+ * 2. Each data block is the image of a leaf base node, i.e. the node header
+ *    followed by all keys and all values. Blocks start at multiples of 
+ *    BLOCK_ALIGNMENT
+ * 3. The sparse index has one entry per block, holding the offset, the number
+ *    of items and the first key of the block
+ * 4. Pointers in node headers are valid if the file is mapped at map_address.
+ *    The address is 0 if no free address range was found, in which case the
+ *    file can only be loaded by copying
+ * 5. log_lsn is the LSN from which the write-ahead log must be replayed on top
+ *    of the file. It is 0 if logging was disabled
+ * 6. checkpoint_id is a random number identifying the file, which incremental
+ *    checkpoints taken after it refer to
+ */
+class CheckpointHeader {
+ public:
+  // "BWTREECP" in little endian
+  static constexpr uint64_t MAGIC = 0x5043454552545742UL;
+  static constexpr uint32_t VERSION = 4;
+  static constexpr uint64_t BLOCK_ALIGNMENT = 64;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t index_entry_size;
+  // Offset of the first key in a node image
+  uint32_t node_header_size;
+  uint32_t reserved;
+  uint64_t item_count;
+  uint64_t block_count;
+  uint64_t index_offset;
+  uint64_t file_size;
+  uint64_t map_address;
+  uint64_t log_lsn;
+  uint64_t checkpoint_id;
+};
+
+/*
+ * class IncrementalCheckpointHeader - The header of an incremental checkpoint 
+ *                                     written by BwTree::CheckpointIncremental()
+ * 
+ * 1. The file consists of the header, data blocks and the index. Blocks are 
+ *    images of consolidated leaves whose mapping table slots were dirty, in 
+ *    the order they are read and aligned to CheckpointHeader::BLOCK_ALIGNMENT
+ * 2. Each index entry holds the offset, the number of items, and the low and
+ *    high keys of the leaf. The items replace all items of the full checkpoint
+ *    and earlier segments in [low key, high key). Ranges of one segment may 
+ *    overlap if a leaf splits during the checkpoint, in which case later 
+ *    blocks are newer: only leaves in the tree are read, and a key range only
+ *    moves from a leaf to its new sibling, so the leaf read later holds the 
+ *    range. Node IDs are not ordered by age
+ * 3. Segments of a full checkpoint are numbered from 1, and must be applied in
+ *    order
+ */
+class IncrementalCheckpointHeader {
+ public:
+  // "BWTREEIC" in little endian
+  static constexpr uint64_t MAGIC = 0x4349454552545742UL;
+  static constexpr uint32_t VERSION = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t index_entry_size;
+  uint32_t node_header_size;
+  uint32_t reserved;
+  // checkpoint_id of the full checkpoint
+  uint64_t base_id;
+  uint64_t sequence;
+  uint64_t item_count;
+  uint64_t block_count;
+  uint64_t index_offset;
+  uint64_t file_size;
+  uint64_t log_lsn;
+};
+
+/*
+ * class BwTree - Assembles the building blocks into a lock-free B+Tree
+ * 
+ * 1. The root is always an inner node. The root node ID is changed when the
+ *    root splits, and the new root is installed with a CAS
+ * 2. Deltas are appended to a node only if its height is below the threshold.
+ *    Otherwise the node is consolidated first. This bounds the size of lists
+ *    used by the consolidator
+ * 3. Nodes are split after consolidation if the size reaches the threshold.
+ *    The split delta is first posted on the node, and then the separator is 
+ *    inserted into the parent. Any thread that sees an unfinished split helps 
+ *    finishing it
+ * 4. Threads join an epoch for each operation. Consolidated delta chains are 
+ *    handed to the epoch manager. Each thread tries to perform GC after every 
+ *    GC_INTERVAL operations
+ * 5. Only unique keys are supported. Node merge and remove are not performed
+ * 6. If BWTREE_LATENCY is defined, the latency of public operations, consolidations
+ *    and SMOs is recorded per thread and can be read with GetLatency(). The latency
+ *    of an operation includes nested consolidations and SMOs
+ * 7. Event counters (CAS failures, consolidations, GC bytes, etc.) are always 
+ *    maintained in per-thread shards. GetStatistics() returns them together with
+ *    structural statistics collected by walking the tree
+ * 8. Analyze() checks structural invariants of the tree in parallel over subtrees,
+ *    and reports depth and wasted space. It is meant for quiescent trees
+ * 9. Checkpoint() writes the leaf level into a file, and Load() rebuilds a new 
+ *    tree from it with the bulk load path, which builds inner levels bottom up
+ *    without SMOs. Leaves may also stay in the mapped file as read-only base nodes
+ * 10. If EnableLog() is called, every successful insert and delete delta is
+ *    recorded in a write-ahead log before the operation returns. Recover() 
+ *    loads a checkpoint and replays the log from the LSN stored in it
+ * 11. CheckpointIncremental() writes only leaves whose mapping table slots are
+ *    dirty since the last checkpoint. Segments are applied on top of the full
+ *    checkpoint by Load() in a single merge pass
+ */
+template <typename _KeyType, typename _ValueType, 
+          template <typename, size_t> typename MappingTable, 
+          typename _DeltaChainType, 
+          template <typename, typename, typename> typename BaseNode,
+          template <typename, typename, typename, typename, template <typename, typename, typename> typename, size_t> typename Consolidator,
+          template <typename> typename EpochManager = DefaultEpochManager>
+class BwTree {
+ public:
+  static constexpr size_t MAPPING_TABLE_SIZE = 1204 * 1024 * 16;
+  static constexpr size_t LEAF_HEIGHT_THREADHOLD = 24;
+  static constexpr size_t INNER_HEIGHT_THRESHOLD = 2;
+  static constexpr size_t HEIGHT_THREADHOLD = \
+    LEAF_HEIGHT_THREADHOLD > INNER_HEIGHT_THRESHOLD ? LEAF_HEIGHT_THREADHOLD : INNER_HEIGHT_THRESHOLD;
+  // Nodes are split after consolidation if the size reaches these
+  static constexpr size_t LEAF_SIZE_THRESHOLD = 128;
+  static constexpr size_t INNER_SIZE_THRESHOLD = 128;
+  // Maximum number of levels recorded during traversal
+  static constexpr size_t MAX_DEPTH = 64;
+  // Number of operations of a thread between two GC attempts
+  static constexpr size_t GC_INTERVAL = 1024;
+  // Analyze() expands the top levels until there are this many subtrees per thread
+  static constexpr size_t VERIFY_TASK_PER_THREAD = 8;
+  // Number of mapping table slots read within one epoch by ScanLeavesFuzzy()
+  static constexpr size_t FUZZY_SCAN_BATCH_SIZE = 4096;
+  // ExportSorted() splits the key range into this many partitions per thread, and
+  // workers run at most this many partitions per thread ahead of the output
+  static constexpr size_t EXPORT_PARTITION_PER_THREAD = 8;
+  static constexpr size_t EXPORT_WINDOW_PER_THREAD = 4;
+  // ParallelScan() splits the range into this many chunks per thread
+  static constexpr size_t SCAN_CHUNK_PER_THREAD = 16;
+  // Nodes built by bulk load are filled to this size, leaving room for inserts
+  static constexpr size_t BULK_LOAD_LEAF_SIZE = LEAF_SIZE_THRESHOLD * 3 / 4;
+  static constexpr size_t BULK_LOAD_INNER_SIZE = INNER_SIZE_THRESHOLD * 3 / 4;
+  // Argument types
+  using KeyType = _KeyType;
+  using ValueType = _ValueType;
+  using DeltaChainType = _DeltaChainType;
+  // Derived types
+  using NodeBaseType = NodeBase<KeyType>;
+  using ExtendedBaseType = ExtendedNodeBase<KeyType, DeltaChainType>;
+  using MappingTableType = MappingTable<NodeBaseType, MAPPING_TABLE_SIZE>;
+  // Metadata variable types
+  using NodeIDType = typename MappingTableType::NodeIDType;
+  using NodeSizeType = typename NodeBaseType::NodeSizeType;
+  using NodeHeightType = typename NodeBaseType::NodeHeightType;
+  using BoundKeyType = typename NodeBaseType::BoundKeyType;
+  // Delta and base node types
+  using DeltaType = Delta<KeyType, ValueType, NodeIDType>;
+  using LeafBaseType = BaseNode<KeyType, ValueType, DeltaChainType>;
+  using InnerBaseType = BaseNode<KeyType, NodeIDType, DeltaChainType>;
+  using LeafInsertType = typename DeltaType::LeafInsertType;
+  using LeafDeleteType = typename DeltaType::LeafDeleteType;
+  using LeafRangeDeleteType = typename DeltaType::LeafRangeDeleteType;
+  using LeafSplitType = typename DeltaType::LeafSplitType;
+  using LeafMergeType = typename DeltaType::LeafMergeType;
+  using LeafRemoveType = typename DeltaType::LeafRemoveType;
+  using InnerInsertType = typename DeltaType::InnerInsertType;
+  using InnerDeleteType = typename DeltaType::InnerDeleteType;
+  using InnerSplitType = typename DeltaType::InnerSplitType;
+  using InnerMergeType = typename DeltaType::InnerMergeType;
+  using InnerRemoveType = typename DeltaType::InnerRemoveType;
+  // Helper types
+  using AppendHelperType = AppendHelper<KeyType, ValueType, MappingTableType, DeltaChainType>;
+  using DeltaChainFreeHelperType = DeltaChainFreeHelper<KeyType, ValueType, MappingTableType, DeltaChainType, BaseNode>;
+  using ConsolidatorType = Consolidator<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, HEIGHT_THREADHOLD>;
+  using ValueSearcherType = ValueSearcher<KeyType, ValueType, MappingTableType, DeltaChainType, BaseNode>;
+  using DeltaChainSizeHelperType = DeltaChainSizeHelper<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode>;
+  using DeltaChainVerifierType = DeltaChainVerifier<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode>;
+  static_assert(ConsolidatorType::support_non_unique_key == LeafBaseType::support_non_unique_key, "Inconsistent non-unique key support");
+  static_assert(ValueSearcherType::support_non_unique_key == LeafBaseType::support_non_unique_key, "Inconsistent non-unique key support");
+  // Traverser types
+  using FreeTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DeltaChainFreeHelperType>;
+  using ConsolidationTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, ConsolidatorType>;
+  using ValueSearchTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, ValueSearcherType>;
+  using SizeTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DeltaChainSizeHelperType>;
+  using VerifyTraverserType = \
+    DeltaChainTraverser<KeyType, ValueType, NodeIDType, DeltaChainType, BaseNode, DeltaChainVerifierType>;
+  // GC types
+  using EpochManagerType = EpochManager<NodeBaseType>;
+  using EpochNodeType = typename EpochManagerType::EpochNode;
+  using KeyValuePairType = std::pair<KeyType, ValueType>;
+
+  // * enum LatencyOp - Operation types recorded by the latency recorder
+  enum LatencyOp : size_t {
+    LatencyInsert = 0,
+    LatencyDelete,
+    LatencyGetValue,
+    LatencyScan,
+    LatencyConsolidate,
+    LatencySplit,
+    LatencyFinishSplit,
+    LATENCY_OP_COUNT,
+  };
+  using LatencyRecorderType = LatencyRecorder<LATENCY_OP_COUNT>;
+
+  // * enum StatCounter - Event counters that are always maintained
+  enum StatCounter : size_t {
+    // Failed CAS when appending an insert or delete delta (the operation retries)
+    StatAppendCASFailure = 0,
+    // Failed CAS when installing a consolidated node (the new node is discarded)
+    StatConsolidateCASFailure,
+    // Failed CAS when posting a split delta or installing a new root
+    StatSplitCASFailure,
+    // Traversals restarted from the root
+    StatTraverseRestart,
+    // Number and bytes of base nodes installed by consolidation
+    StatConsolidation,
+    StatConsolidationBytes,
+    // Number of split deltas posted
+    StatSplit,
+    // Splits whose separator is posted to the parent in the same RTM transaction
+    StatSplitHTM,
+    // Leaves emptied as a whole by DeleteRange(). Empty leaves are never reclaimed
+    StatLeafEmptied,
+    // Chunks of ParallelScan() stolen from other threads
+    StatScanSteal,
+    // Descents from the root by ReverseScan() to find the leaf on the left
+    StatReverseDescent,
+    // Bytes of delta chains handed to and freed by the epoch manager
+    StatGarbageBytes,
+    StatFreedBytes,
+    STAT_COUNTER_COUNT,
+  };
+  using ShardedCounterType = ShardedCounter<STAT_COUNTER_COUNT>;
+
+  // * enum MemoryCounter - Bytes of live nodes reachable from the mapping table
+  enum MemoryCounter : size_t {
+    MemoryBaseNode = 0,
+    MemoryDelta,
+    MEMORY_COUNTER_COUNT,
+  };
+  using MemoryCounterType = ShardedCounter<MEMORY_COUNTER_COUNT>;
+
+  // * enum LogRecordType - Types of write-ahead log records. Payloads are raw key and value bytes
+  enum LogRecordType : uint32_t {
+    // Key followed by value
+    LogInsert = 1,
+    // Key
+    LogDelete,
+    // Low key followed by high key (exclusive)
+    LogDeleteRange,
+  };
+
+  // * enum class LoadMode - How Load() builds leaves from a checkpoint file
+  enum class LoadMode {
+    // Leaves are copied to the heap
+    Copy = 0,
+    // Leaves are used in place in the mapped file
+    Resident,
+  };
+
+  /*
+   * class MemoryUsage - Bytes used by each subsystem, returned by GetMemoryUsage()
+   * 
+   * 1. Base nodes and deltas are counted when they are installed in the mapping
+   *    table, and moved to the GC backlog when their chain is retired
+   * 2. Nodes that are allocated but never installed (e.g. after a failed CAS) and
+   *    temporary nodes built by scans are not counted
+   * 3. The mapping table is counted by its used slots. The reserved size is the
+   *    whole table, which is mostly untouched virtual memory
+   * 4. Leaves in a resident checkpoint are counted as the size of the mapped 
+   *    file, which is backed by the page cache and not part of the total
+   * 5. Base nodes include the versions that leaves keep for snapshots
+   */
+  class MemoryUsage {
+   public:
+    size_t mapping_table_reserved;
+    size_t mapping_table_used;
+    size_t base_node;
+    size_t delta;
+    size_t gc_backlog;
+    size_t mapped_file;
+
+    // * GetTotal() - Returns the sum of used bytes of all subsystems
+    inline size_t GetTotal() const { return mapping_table_used + base_node + delta + gc_backlog; }
+
+    // * Print() - Prints the usage in a human readable format
+    void Print(FILE *fp) const {
+      fprintf(fp, "memory total %lu: mapping table %lu (reserved %lu) base nodes %lu deltas %lu GC backlog %lu; mapped file %lu\n",
+              GetTotal(), mapping_table_used, mapping_table_reserved, base_node, delta, gc_backlog, mapped_file);
+      return;
+    }
+  };
+
+  /*
+   * class Statistics - A snapshot of tree statistics returned by GetStatistics()
+   * 
+   * 1. Structural statistics are collected by walking the tree from the root
+   *    level by level. Level 0 is the root
+   * 2. Fill factors are the logical node size relative to the split threshold
+   * 3. The snapshot is only exact if no thread modifies the tree
+   */
+  class Statistics {
+   public:
+    // Buckets of the fill factor histogram, each covering 10% of the threshold.
+    // The last bucket counts nodes at or above the threshold
+    static constexpr size_t FILL_BUCKET_COUNT = 11;
+    // Heights at or above this are counted in the last bucket of the height histogram
+    static constexpr size_t MAX_HEIGHT_BUCKET = 2 * HEIGHT_THREADHOLD;
+
+    // * class LevelStatistics - Statistics of nodes on one level
+    class LevelStatistics {
+     public:
+      bool leaf;
+      uint64_t node_count;
+      // Sum of logical node sizes
+      uint64_t item_count;
+      // Sum of delta chain heights
+      uint64_t delta_count;
+      double fill_factor;
+    };
+
+    Statistics() : 
+      chain_height_list(MAX_HEIGHT_BUCKET + 1), fill_list(FILL_BUCKET_COUNT), level_list{}, counter_list{} {}
+
+    // * GetCounter() - Returns the value of an event counter
+    inline uint64_t GetCounter(StatCounter counter) const { return counter_list[counter]; }
+    // * GetGCPendingBytes() - Returns bytes of delta chains not yet freed by the epoch manager
+    inline uint64_t GetGCPendingBytes() const {
+      uint64_t freed = counter_list[StatFreedBytes];
+      return counter_list[StatGarbageBytes] > freed ? counter_list[StatGarbageBytes] - freed : 0;
+    }
+
+    // * Print() - Prints the snapshot in a human readable format
+    void Print(FILE *fp) const {
+      fprintf(fp, "levels %lu\n", level_list.size());
+      for(size_t i = 0;i < level_list.size();i++) {
+        const LevelStatistics &level = level_list[i];
+        fprintf(fp, "  level %lu (%s): nodes %lu items %lu deltas %lu fill %.2f\n", 
+                i, level.leaf ? "leaf" : "inner", level.node_count, level.item_count, level.delta_count, level.fill_factor);
+      }
+      fprintf(fp, "chain height:");
+      for(size_t i = 0;i < chain_height_list.size();i++) {
+        if(chain_height_list[i] != 0) { fprintf(fp, " %lu%s:%lu", i, i == MAX_HEIGHT_BUCKET ? "+" : "", chain_height_list[i]); }
+      }
+      fprintf(fp, "\nfill factor:");
+      for(size_t i = 0;i < fill_list.size();i++) { fprintf(fp, " %lu%%:%lu", i * 10, fill_list[i]); }
+      fprintf(fp, "\nCAS failures: append %lu consolidate %lu split %lu; traverse restarts %lu\n",
+              counter_list[StatAppendCASFailure], counter_list[StatConsolidateCASFailure], 
+              counter_list[StatSplitCASFailure], counter_list[StatTraverseRestart]);
+      fprintf(fp, "consolidations %lu (%lu bytes); splits %lu (%lu by RTM); leaves emptied %lu; scan steals %lu; reverse descents %lu; "
+              "GC pending %lu bytes\n",
+              counter_list[StatConsolidation], counter_list[StatConsolidationBytes], counter_list[StatSplit], 
+              counter_list[StatSplitHTM], counter_list[StatLeafEmptied], counter_list[StatScanSteal], 
+              counter_list[StatReverseDescent], GetGCPendingBytes());
+      return;
+    }
+
+    // Number of nodes by delta chain height
+    std::vector<uint64_t> chain_height_list;
+    // Number of nodes by fill factor
+    std::vector<uint64_t> fill_list;
+    std::vector<LevelStatistics> level_list;
+    uint64_t counter_list[STAT_COUNTER_COUNT];
+  };
+
+  /*
+   * class Analysis - Result of Analyze(), which checks the structure of the tree
+   *                  and measures it for capacity planning
+   * 
+   * 1. The depth is the number of levels from the root to the leaves. All leaves
+   *    must be on the same level
+   * 2. Wasted bytes are bytes of delta chains beyond a consolidated base node of 
+   *    the same logical size, i.e. deltas and items shadowed by deltas or splits
+   * 3. Only the first MAX_ERROR_COUNT error messages are kept, but all errors 
+   *    are counted
+   */
+  class Analysis {
+   public:
+    static constexpr size_t MAX_ERROR_COUNT = 64;
+
+    Analysis() : 
+      node_count{0}, leaf_count{0}, item_count{0}, total_bytes{0}, wasted_bytes{0}, 
+      min_leaf_depth{UINT64_MAX}, max_leaf_depth{0}, unreachable_count{0}, error_count{0}, error_list{} {}
+
+    // * IsValid() - Returns true if no error is found
+    inline bool IsValid() const { return error_count == 0; }
+    // * GetDepth() - Returns the number of levels
+    inline uint64_t GetDepth() const { return max_leaf_depth; }
+    // * GetLeafFillFactor() - Returns the average leaf size relative to the split threshold
+    inline double GetLeafFillFactor() const { 
+      return leaf_count == 0 ? 0.0 : static_cast<double>(item_count) / (leaf_count * LEAF_SIZE_THRESHOLD); 
+    }
+
+    // * AddError() - Records an error found on a node
+    void AddError(NodeIDType node_id, const char *error_p) {
+      if(error_count++ < MAX_ERROR_COUNT) {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "node %lu: %s", static_cast<uint64_t>(node_id), error_p);
+        error_list.emplace_back(buffer);
+      }
+
+      return;
+    }
+
+    // * Merge() - Adds the result of another subtree
+    void Merge(const Analysis &other) {
+      node_count += other.node_count;
+      leaf_count += other.leaf_count;
+      item_count += other.item_count;
+      total_bytes += other.total_bytes;
+      wasted_bytes += other.wasted_bytes;
+      min_leaf_depth = std::min(min_leaf_depth, other.min_leaf_depth);
+      max_leaf_depth = std::max(max_leaf_depth, other.max_leaf_depth);
+      unreachable_count += other.unreachable_count;
+      for(const std::string &error : other.error_list) {
+        if(error_list.size() < MAX_ERROR_COUNT) { error_list.push_back(error); }
+      }
+      error_count += other.error_count;
+      return;
+    }
+
+    // * Print() - Prints the result and the errors
+    void Print(FILE *fp) const {
+      fprintf(fp, "depth %lu; nodes %lu (leaves %lu); items %lu; leaf fill %.2f\n", 
+              GetDepth(), node_count, leaf_count, item_count, GetLeafFillFactor());
+      fprintf(fp, "bytes %lu; wasted %lu (%.1f%%); unreachable nodes %lu; errors %lu\n", 
+              total_bytes, wasted_bytes, total_bytes == 0 ? 0.0 : wasted_bytes * 100.0 / total_bytes,
+              unreachable_count, error_count);
+      for(const std::string &error : error_list) { fprintf(fp, "  %s\n", error.c_str()); }
+      return;
+    }
+
+    uint64_t node_count;
+    uint64_t leaf_count;
+    uint64_t item_count;
+    uint64_t total_bytes;
+    uint64_t wasted_bytes;
+    // Depth of leaves, counting the root as 1
+    uint64_t min_leaf_depth;
+    uint64_t max_leaf_depth;
+    // Nodes in the mapping table that are not reachable from the root
+    uint64_t unreachable_count;
+    uint64_t error_count;
+    std::vector<std::string> error_list;
+  };
+
+  /*
+   * class ThreadContext - Per-thread state that is passed to operations
+   * 
+   * 1. RegisterThread() assigns a thread index from ThreadIndex, and 
+   *    UnregisterThread() returns it. The index is not bound to the calling 
+   *    thread, and is never used by another thread while registered
+   * 2. Operations given a context use its index for node ID blocks and counters,
+   *    instead of looking up thread local storage on each access. Operations
+   *    without a context look up the index of the calling thread once
+   * 3. A context must only be used by one thread at a time
+   */
+  class ThreadContext {
+   public:
+    // * GetThreadIndex() - Returns the index assigned at registration
+    inline size_t GetThreadIndex() const { return thread_index; }
+
+   private:
+    friend class BwTree;
+    ThreadContext(size_t pthread_index) : thread_index{pthread_index}, op_count{0} {}
+
+    size_t thread_index;
+    // Operations performed with the context, which trigger GC periodically
+    size_t op_count;
+  };
+
+  /*
+   * class Context - Records the path from the root during traversal
+   * 
+   * path[0] is the root node ID, and path[depth - 1] is the node ID of the 
+   * current level. leaf_p is the delta chain of the leaf seen by the traversal.
+   * thread_index is the index of the calling thread or of its ThreadContext
+   */
+  class Context {
+   public:
+    Context() : Context{nullptr} {}
+    explicit Context(const ThreadContext *thread_p) : 
+      depth{0}, leaf_p{nullptr}, 
+      thread_index{thread_p == nullptr ? ThreadIndex::Get() : thread_p->GetThreadIndex()} {}
+    NodeIDType path[MAX_DEPTH];
+    size_t depth;
+    NodeBaseType *leaf_p;
+    size_t thread_index;
+  };
+
+  /*
+   * BwTree() - Constructor
+   * 
+   * The tree is initialized with an empty leaf node under the root node. The 
+   * mapping table is backed by huge pages of the given mode. Nodes are backed 
+   * by huge pages if DeltaChainType is HugePageDeltaChainType
+   */
+  BwTree(HugePageMode table_mode = HugePageMode::None) : 
+    table_p{MappingTableType::Get(table_mode)}, 
+    root_id{MappingTableType::INVALID_NODE_ID},
+    epoch_manager_p{new EpochManagerType{[this](NodeBaseType *node_p) { FreeGarbage(node_p); }}},
+    resident_file_p{nullptr},
+    log_p{nullptr},
+    checkpoint_id{0},
+    checkpoint_sequence{0},
+    version_clock{1},
+    snapshot_lock{},
+    snapshot_set{},
+    min_snapshot{DeltaVersion::LATEST},
+    htm_enabled{HTMIsSupported()} {
+    LeafBaseType *leaf_p = LeafBaseType::Get(NodeType::LeafBase, 0, BoundKeyType::GetInf(), BoundKeyType::GetInf());
+    InnerBaseType *root_p = InnerBaseType::Get(NodeType::InnerBase, 1, BoundKeyType::GetInf(), BoundKeyType::GetInf());
+    root_p->ValueAt(0) = table_p->AllocateNodeID(leaf_p);
+    root_id.store(table_p->AllocateNodeID(root_p));
+    memory_counter.Add(MemoryBaseNode, leaf_p->GetMemorySize() + root_p->GetMemorySize());
+    return;
+  }
+
+  /*
+   * ~BwTree() - Destructor
+   * 
+   * No thread should be accessing the tree. Garbage is freed before the delta
+   * chains in the mapping table
+   */
+  ~BwTree() {
+    delete epoch_manager_p;
+    for(NodeIDType node_id = MappingTableType::FIRST_NODE_ID;node_id < table_p->GetNextSlot();node_id++) {
+      NodeBaseType *node_p = table_p->At(node_id);
+      if(node_p != nullptr) { FreeDeltaChain(node_p); }
+    }
+
+    MappingTableType::Destroy(table_p);
+    delete resident_file_p;
+    delete log_p;
+    return;
+  }
+
+  /*
+   * Insert() - Inserts a key value pair
+   * 
+   * Returns false if the key already exists. The thread context is optional for
+   * all operations, see ThreadContext
+   */
+  bool Insert(const KeyType &key, const ValueType &value, ThreadContext *thread_p = nullptr) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyInsert);)
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{thread_p};
+    ValueSearcherType searcher{key};
+    bool ret;
+    uint64_t ticket = 0;
+    while(true) {
+      if(Traverse(key, &context, &searcher) == false) { continue; }
+      if(searcher.GetValue() != nullptr) { ret = false; break; }
+
+      NodeIDType leaf_id = context.path[context.depth - 1];
+      if(context.leaf_p->GetHeight() >= LEAF_HEIGHT_THREADHOLD) {
+        ConsolidateNode(&context, context.depth - 1, leaf_id, context.leaf_p);
+        continue;
+      }
+
+      AppendHelperType ah{leaf_id, context.leaf_p, table_p};
+      uint64_t lsn = log_p == nullptr ? 0 : log_p->Begin();
+      LeafInsertType *delta_p = ah.AppendLeafInsert(key, value);
+      if(delta_p == nullptr) {
+        static_cast<LeafInsertType *>(ah.GetNode())->GetVersion().Resolve(version_clock);
+        if(log_p != nullptr) { ticket = LogChange(lsn, LogInsert, key, &value); }
+        memory_counter.Add(MemoryDelta, sizeof(LeafInsertType), context.thread_index);
+        if(ah.GetNode()->GetHeight() >= LEAF_HEIGHT_THREADHOLD) {
+          ConsolidateNode(&context, context.depth - 1, leaf_id, ah.GetNode());
+        }
+
+        ret = true;
+        break;
+      }
+
+      if(log_p != nullptr) { log_p->Abort(); }
+      ah.DestroyDelta(delta_p);
+      stat_counter.Add(StatAppendCASFailure, 1, context.thread_index);
+    }
+
+    ExitEpoch(epoch_p, thread_p);
+    if(ret == true && log_p != nullptr) { WaitLogDurable(ticket); }
+    return ret;
+  }
+
+  /*
+   * Delete() - Deletes a key and its value
+   * 
+   * Returns false if the key does not exist
+   */
+  bool Delete(const KeyType &key, ThreadContext *thread_p = nullptr) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyDelete);)
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{thread_p};
+    ValueSearcherType searcher{key};
+    bool ret;
+    uint64_t ticket = 0;
+    while(true) {
+      if(Traverse(key, &context, &searcher) == false) { continue; }
+      if(searcher.GetValue() == nullptr) { ret = false; break; }
+
+      NodeIDType leaf_id = context.path[context.depth - 1];
+      if(context.leaf_p->GetHeight() >= LEAF_HEIGHT_THREADHOLD) {
+        ConsolidateNode(&context, context.depth - 1, leaf_id, context.leaf_p);
+        continue;
+      }
+
+      AppendHelperType ah{leaf_id, context.leaf_p, table_p};
+      uint64_t lsn = log_p == nullptr ? 0 : log_p->Begin();
+      LeafDeleteType *delta_p = ah.AppendLeafDelete(key, *searcher.GetValue());
+      if(delta_p == nullptr) {
+        static_cast<LeafDeleteType *>(ah.GetNode())->GetVersion().Resolve(version_clock);
+        if(log_p != nullptr) { ticket = LogChange(lsn, LogDelete, key, nullptr); }
+        memory_counter.Add(MemoryDelta, sizeof(LeafDeleteType), context.thread_index);
+        if(ah.GetNode()->GetHeight() >= LEAF_HEIGHT_THREADHOLD) {
+          ConsolidateNode(&context, context.depth - 1, leaf_id, ah.GetNode());
+        }
+
+        ret = true;
+        break;
+      }
+
+      if(log_p != nullptr) { log_p->Abort(); }
+      ah.DestroyDelta(delta_p);
+      stat_counter.Add(StatAppendCASFailure, 1, context.thread_index);
+    }
+
+    ExitEpoch(epoch_p, thread_p);
+    if(ret == true && log_p != nullptr) { WaitLogDurable(ticket); }
+    return ret;
+  }
+
+  /*
+   * DeleteRange() - Deletes all keys in [low key, high key)
+   * 
+   * 1. One range delete delta is posted on each leaf that has keys in the range,
+   *    which replaces one delete delta per key
+   * 2. The range is deleted leaf by leaf, so the operation is not atomic. Each
+   *    leaf is deleted atomically, and a key inserted into a leaf after its delta
+   *    is posted is not deleted
+   * 3. A leaf whose key range is covered needs no key count, and is consolidated
+   *    into an empty base node right after the delta is posted. The old chains
+   *    of such leaves are handed to the epoch manager in one batch. The leaf 
+   *    itself stays in the tree with no keys. There is no merge protocol, so
+   *    empty leaves and their node IDs are never reclaimed
+   * 
+   * Returns the number of keys deleted
+   */
+  size_t DeleteRange(const KeyType &low_key, const KeyType &high_key, ThreadContext *thread_p = nullptr) {
+    size_t deleted = 0;
+    if((low_key < high_key) == false) { return deleted; }
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{thread_p};
+    KeyType key = low_key;
+    uint64_t ticket = 0;
+    std::vector<NodeBaseType *> garbage_list{};
+    while(true) {
+      ValueSearcherType searcher{key};
+      if(Traverse(key, &context, &searcher) == false) { continue; }
+
+      NodeIDType leaf_id = context.path[context.depth - 1];
+      if(context.leaf_p->GetHeight() >= LEAF_HEIGHT_THREADHOLD) {
+        ConsolidateNode(&context, context.depth - 1, leaf_id, context.leaf_p);
+        continue;
+      }
+
+      // The delta is clipped to the leaf, and must count the keys it deletes exactly
+      const BoundKeyType leaf_low_key = *context.leaf_p->GetLowKey();
+      const BoundKeyType leaf_high_key = *context.leaf_p->GetHighKey();
+      const KeyType range_high_key = (leaf_high_key.IsInf() || high_key < leaf_high_key.key) ? high_key : leaf_high_key.key;
+      bool covered = leaf_low_key.IsInf() == false && leaf_high_key.IsInf() == false && 
+                     (leaf_low_key.key < low_key) == false && (high_key < leaf_high_key.key) == false;
+      NodeSizeType count = covered ? context.leaf_p->GetSize() : CountRange(context.leaf_p, key, range_high_key);
+      if(count != 0) {
+        AppendHelperType ah{leaf_id, context.leaf_p, table_p};
+        uint64_t lsn = log_p == nullptr ? 0 : log_p->Begin();
+        LeafRangeDeleteType *delta_p = ah.AppendLeafRangeDelete(key, range_high_key, count);
+        if(delta_p != nullptr) {
+          if(log_p != nullptr) { log_p->Abort(); }
+          ah.DestroyDelta(delta_p);
+          stat_counter.Add(StatAppendCASFailure, 1, context.thread_index);
+          continue;
+        }
+
+        static_cast<LeafRangeDeleteType *>(ah.GetNode())->GetVersion().Resolve(version_clock);
+        if(log_p != nullptr) { ticket = LogRange(lsn, key, range_high_key); }
+        memory_counter.Add(MemoryDelta, sizeof(LeafRangeDeleteType), context.thread_index);
+        deleted += count;
+        if(covered == true) {
+          size_t garbage_num = garbage_list.size();
+          ConsolidateNode(&context, context.depth - 1, leaf_id, ah.GetNode(), &garbage_list);
+          if(garbage_list.size() != garbage_num) { stat_counter.Add(StatLeafEmptied, 1, context.thread_index); }
+        } else if(ah.GetNode()->GetHeight() >= LEAF_HEIGHT_THREADHOLD) {
+          ConsolidateNode(&context, context.depth - 1, leaf_id, ah.GetNode());
+        }
+      }
+
+      if(leaf_high_key.IsInf() || (leaf_high_key.key < high_key) == false) { break; }
+      key = leaf_high_key.key;
+    }
+
+    RetireDeltaChainList(garbage_list, context.thread_index);
+    ExitEpoch(epoch_p, thread_p);
+    if(deleted != 0 && log_p != nullptr) { WaitLogDurable(ticket); }
+    return deleted;
+  }
+
+  /*
+   * GetValue() - Searches the key and copies the value
+   * 
+   * Returns false if the key does not exist
+   */
+  bool GetValue(const KeyType &key, ValueType *value_p, ThreadContext *thread_p = nullptr) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyGetValue);)
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{thread_p};
+    ValueSearcherType searcher{key};
+    while(Traverse(key, &context, &searcher) == false) {}
+    bool ret = searcher.GetValue() != nullptr;
+    if(ret == true) { *value_p = *searcher.GetValue(); }
+    ExitEpoch(epoch_p, thread_p);
+    return ret;
+  }
+
+  /*
+   * GetValue() - Searches the key at a snapshot returned by CreateSnapshot()
+   * 
+   * Returns false if the key does not exist at the snapshot
+   */
+  bool GetValue(const KeyType &key, ValueType *value_p, uint64_t snapshot, ThreadContext *thread_p = nullptr) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyGetValue);)
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{thread_p};
+    ValueSearcherType searcher{key};
+    while(Traverse(key, &context, &searcher) == false) {}
+    // The traversal has found the leaf, which is searched again at the snapshot
+    ResolveVersions(context.leaf_p);
+    ValueSearcherType snapshot_searcher{key, snapshot};
+    ValueSearchTraverserType::Traverse(context.leaf_p, &snapshot_searcher);
+    bool ret = snapshot_searcher.GetValue() != nullptr;
+    if(ret == true) { *value_p = *snapshot_searcher.GetValue(); }
+    ExitEpoch(epoch_p, thread_p);
+    return ret;
+  }
+
+  /*
+   * Scan() - Copies at most count key value pairs whose keys are not less than
+   *          the start key, in key order
+   * 
+   * Returns the number of pairs copied. Without a snapshot the scan is not atomic,
+   * and each leaf is read from a consistent snapshot of its delta chain. With a 
+   * snapshot returned by CreateSnapshot(), all leaves are read at that snapshot
+   */
+  size_t Scan(const KeyType &start_key, size_t count, std::vector<KeyValuePairType> *result_p, 
+              uint64_t snapshot = DeltaVersion::LATEST, ThreadContext *thread_p = nullptr) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyScan);)
+    size_t copied = 0;
+    if(count == 0) { return copied; }
+    ScanLeaves(start_key, [&copied, count, result_p](const KeyType &key, LeafBaseType *leaf_p) {
+      for(NodeSizeType i = FindLowerBound(leaf_p, key);i < leaf_p->GetSize();i++) {
+        result_p->emplace_back(leaf_p->KeyAt(i), leaf_p->ValueAt(i));
+        if(++copied == count) { return false; }
+      }
+      return true;
+    }, snapshot, thread_p);
+
+    return copied;
+  }
+
+  /*
+   * ReverseScan() - Copies at most count key value pairs whose keys are not 
+   *                 greater than the start key, in descending key order
+   * 
+   * 1. Leaves are only linked to the right by split deltas. The leaf on the left
+   *    of a leaf is the one holding the largest key less than its low key, and 
+   *    is found by a descent that goes left of separators equal to the low key
+   * 2. The parent of the current leaf is cached, such that the leaf on the left
+   *    is usually the previous child and no descent is needed. The cached parent
+   *    may be stale, and the child is only taken if it ends at the low key
+   * 3. Returns the number of pairs copied. The scan is not atomic, and each leaf
+   *    is read from a consistent snapshot of its delta chain
+   */
+  size_t ReverseScan(const KeyType &start_key, size_t count, std::vector<KeyValuePairType> *result_p, 
+                     ThreadContext *thread_p = nullptr) {
+    return ReverseScanFrom(BoundKeyType{start_key}, count, result_p, thread_p);
+  }
+
+  // * ReverseScan() - Copies at most count key value pairs with the largest keys, in descending key order
+  size_t ReverseScan(size_t count, std::vector<KeyValuePairType> *result_p, ThreadContext *thread_p = nullptr) {
+    return ReverseScanFrom(BoundKeyType::GetInf(), count, result_p, thread_p);
+  }
+
+  /*
+   * ExportSorted() - Calls the callback on all key value pairs in key order, with
+   *                  leaves consolidated by thread_num worker threads
+   * 
+   * 1. The key range is partitioned by separators in the top levels of the tree.
+   *    Each worker walks the leaves of a partition, and copies their consolidated
+   *    content into a buffer of the partition
+   * 2. The calling thread calls the callback on the buffers in partition order. 
+   *    Workers do not run too far ahead, such that the buffered pairs are bounded
+   * 3. The callback is of signature void(const KeyValuePairType *, size_t count).
+   *    The export is not atomic, and each leaf is a consistent snapshot of its 
+   *    delta chain
+   */
+  template <typename Callback>
+  void ExportSorted(Callback &&cb, size_t thread_num = 1) {
+    always_assert(thread_num > 0);
+    std::vector<KeyType> separator_list = GetSeparators(thread_num * EXPORT_PARTITION_PER_THREAD);
+    size_t partition_num = separator_list.size() + 1;
+    std::vector<std::vector<KeyValuePairType>> buffer_list(partition_num);
+    std::vector<bool> ready_list(partition_num, false);
+    size_t emitted = 0;
+    std::mutex lock{};
+    std::condition_variable cv{};
+    std::atomic<size_t> next_partition{0};
+    auto func = [this, thread_num, partition_num, &separator_list, &buffer_list, &ready_list, &emitted, &lock, &cv, &next_partition]() {
+      for(size_t i = next_partition.fetch_add(1);i < partition_num;i = next_partition.fetch_add(1)) {
+        {
+          std::unique_lock<std::mutex> guard{lock};
+          cv.wait(guard, [&emitted, i, thread_num]() { return i < emitted + thread_num * EXPORT_WINDOW_PER_THREAD; });
+        }
+        std::vector<KeyValuePairType> &buffer = buffer_list[i];
+        ScanRange(i == 0 ? BoundKeyType::GetInf() : BoundKeyType{separator_list[i - 1]}, 
+                  i == partition_num - 1 ? BoundKeyType::GetInf() : BoundKeyType{separator_list[i]},
+                  [&buffer](LeafBaseType *leaf_p, NodeSizeType begin, NodeSizeType end) {
+                    for(NodeSizeType j = begin;j < end;j++) { buffer.emplace_back(leaf_p->KeyAt(j), leaf_p->ValueAt(j)); }
+                  });
+        {
+          std::lock_guard<std::mutex> guard{lock};
+          ready_list[i] = true;
+        }
+        cv.notify_all();
+      }
+    };
+
+    std::vector<std::thread> thread_list{};
+    for(size_t i = 0;i < thread_num;i++) { thread_list.emplace_back(func); }
+    for(size_t i = 0;i < partition_num;i++) {
+      {
+        std::unique_lock<std::mutex> guard{lock};
+        cv.wait(guard, [&ready_list, i]() { return ready_list[i]; });
+      }
+      if(buffer_list[i].empty() == false) { cb(buffer_list[i].data(), buffer_list[i].size()); }
+      std::vector<KeyValuePairType>{}.swap(buffer_list[i]);
+      {
+        std::lock_guard<std::mutex> guard{lock};
+        emitted = i + 1;
+      }
+      cv.notify_all();
+    }
+    for(std::thread &thread : thread_list) { thread.join(); }
+    return;
+  }
+
+  // * ExportSorted() - Appends all key value pairs in key order to the vector
+  void ExportSorted(std::vector<KeyValuePairType> *result_p, size_t thread_num = 1) {
+    ExportSorted([result_p](const KeyValuePairType *item_list, size_t count) {
+      result_p->insert(result_p->end(), item_list, item_list + count);
+    }, thread_num);
+    return;
+  }
+
+  /*
+   * ParallelScan() - Reduces the key value pairs in [low key, high key) with 
+   *                  thread_num threads, and returns the result
+   * 
+   * 1. The range is split into chunks by separators in the top levels of the 
+   *    tree. Each thread owns a run of adjacent chunks, and processes it from the
+   *    front. A thread that runs out of chunks steals from the back of the runs
+   *    of other threads
+   * 2. Each chunk starts from a copy of init. Pairs are added to it by 
+   *    cb(ResultType *, const KeyType &, const ValueType &), which is called by
+   *    all threads on different chunks. Chunk results are combined in key order 
+   *    by reducer(ResultType *, const ResultType &) starting from init, so init
+   *    must be the identity of the reducer
+   * 3. The scan is not atomic, and each leaf is a consistent snapshot of its 
+   *    delta chain
+   */
+  template <typename ResultType, typename Callback, typename Reducer>
+  ResultType ParallelScan(const KeyType &low_key, const KeyType &high_key, const ResultType &init, 
+                          Callback &&cb, Reducer &&reducer, size_t thread_num = 1) {
+    always_assert(thread_num > 0);
+    ResultType result = init;
+    if((low_key < high_key) == false) { return result; }
+    std::vector<KeyType> separator_list = 
+      GetSeparators(thread_num * SCAN_CHUNK_PER_THREAD, BoundKeyType{low_key}, BoundKeyType{high_key});
+    size_t chunk_num = separator_list.size() + 1;
+    std::vector<ResultType> chunk_result_list(chunk_num, init);
+    std::vector<ChunkQueue> queue_list(thread_num);
+    for(size_t i = 0;i < thread_num;i++) { queue_list[i].Init(i * chunk_num / thread_num, (i + 1) * chunk_num / thread_num); }
+    std::atomic<size_t> steal_count{0};
+    auto func = [this, &low_key, &high_key, &cb, thread_num, chunk_num, &separator_list, &chunk_result_list, &queue_list, &steal_count](size_t thread_id) {
+      size_t chunk;
+      while(true) {
+        bool found = queue_list[thread_id].PopFront(&chunk);
+        for(size_t i = 1;found == false && i < thread_num;i++) {
+          found = queue_list[(thread_id + i) % thread_num].PopBack(&chunk);
+          if(found == true) { steal_count.fetch_add(1); }
+        }
+        if(found == false) { break; }
+
+        ResultType *chunk_result_p = &chunk_result_list[chunk];
+        ScanRange(chunk == 0 ? BoundKeyType{low_key} : BoundKeyType{separator_list[chunk - 1]}, 
+                  chunk == chunk_num - 1 ? BoundKeyType{high_key} : BoundKeyType{separator_list[chunk]},
+                  [&cb, chunk_result_p](LeafBaseType *leaf_p, NodeSizeType begin, NodeSizeType end) {
+                    for(NodeSizeType i = begin;i < end;i++) { cb(chunk_result_p, leaf_p->KeyAt(i), leaf_p->ValueAt(i)); }
+                  });
+      }
+    };
+
+    std::vector<std::thread> thread_list{};
+    for(size_t i = 1;i < thread_num;i++) { thread_list.emplace_back(func, i); }
+    func(0);
+    for(std::thread &thread : thread_list) { thread.join(); }
+    stat_counter.Add(StatScanSteal, steal_count.load());
+    for(const ResultType &chunk_result : chunk_result_list) { reducer(&result, chunk_result); }
+    return result;
+  }
+
+  /*
+   * ScanAggregate() - Calls the aggregator on key value pairs in [low key, high key)
+   *                   that satisfy the predicate, without copying them out
+   * 
+   * 1. Base nodes are read in place. The range within a base node is found by 
+   *    counting keys less than the bounds in the key array, which is vectorized
+   *    for integral keys, see CountLess()
+   * 2. For a leaf with deltas, the consolidator merges the deltas with the base
+   *    node and passes each pair to the predicate, without building a new node
+   * 3. The predicate is of signature bool(const KeyType &, const ValueType &), 
+   *    and the aggregator is of signature void(const KeyType &, const ValueType &).
+   *    Returns the number of pairs passed to the aggregator
+   * 4. The scan is not atomic, and each leaf is a consistent snapshot of its 
+   *    delta chain
+   */
+  template <typename Predicate, typename Aggregator>
+  size_t ScanAggregate(const KeyType &low_key, const KeyType &high_key, Predicate &&pred, Aggregator &&agg) {
+    size_t count = 0;
+    if((low_key < high_key) == false) { return count; }
+    ForEachLeaf(BoundKeyType{low_key}, BoundKeyType{high_key}, 
+      [&low_key, &high_key, &pred, &agg, &count](NodeBaseType *leaf_p, const BoundKeyType &cursor) {
+        if(leaf_p->GetType() == NodeType::LeafBase) {
+          LeafBaseType *base_p = static_cast<LeafBaseType *>(leaf_p);
+          std::pair<NodeSizeType, NodeSizeType> range = GetLeafRange(base_p, cursor, BoundKeyType{high_key});
+          for(NodeSizeType i = range.first;i < range.second;i++) {
+            if(pred(base_p->KeyAt(i), base_p->ValueAt(i)) == true) { agg(base_p->KeyAt(i), base_p->ValueAt(i)); count++; }
+          }
+          return;
+        }
+
+        ConsolidatorType consolidator{leaf_p, true};
+        ConsolidationTraverserType::Traverse(leaf_p, &consolidator);
+        consolidator.VisitLeaf([&low_key, &high_key, &pred, &agg, &count](const KeyType &key, const ValueType &value) {
+          if((key < low_key) == false && key < high_key && pred(key, value) == true) { agg(key, value); count++; }
+        });
+      });
+
+    return count;
+  }
+
+  /*
+   * CreateSnapshot() - Returns the version of a new snapshot of the tree
+   * 
+   * 1. Changes whose Insert() or Delete() returned before the call are visible
+   *    at the snapshot, and changes started after it are not. A change in 
+   *    progress is either visible or not, the same for all readers
+   * 2. Writers are not blocked. Consolidation keeps the versions of keys that
+   *    changed after the oldest active snapshot, so each snapshot must be 
+   *    released by ReleaseSnapshot() when it is no longer read
+   */
+  uint64_t CreateSnapshot() {
+    std::lock_guard<std::mutex> guard{snapshot_lock};
+    uint64_t snapshot = version_clock.load();
+    snapshot_set.insert(snapshot);
+    min_snapshot.store(*snapshot_set.begin());
+    // The clock advances after the watermark is published. A consolidation that
+    // resolves a version newer than the snapshot therefore sees the snapshot
+    version_clock.fetch_add(1);
+    return snapshot;
+  }
+
+  // * ReleaseSnapshot() - Ends a snapshot returned by CreateSnapshot()
+  void ReleaseSnapshot(uint64_t snapshot) {
+    std::lock_guard<std::mutex> guard{snapshot_lock};
+    auto it = snapshot_set.find(snapshot);
+    always_assert(it != snapshot_set.end());
+    snapshot_set.erase(it);
+    min_snapshot.store(snapshot_set.empty() ? DeltaVersion::LATEST : *snapshot_set.begin());
+    return;
+  }
+
+  // * PerformGC() - Advances the epoch and reclaims garbage
+  inline bool PerformGC() { return epoch_manager_p->PerformGC(); }
+  // * RegisterThread() - Returns a new thread context with a free thread index
+  inline ThreadContext *RegisterThread() { return new ThreadContext{ThreadIndex::Acquire()}; }
+  // * UnregisterThread() - Releases the thread index and frees the context
+  inline void UnregisterThread(ThreadContext *thread_p) {
+    ThreadIndex::Release(thread_p->thread_index);
+    delete thread_p;
+    return;
+  }
+  // * GetMappingTable() - Returns the mapping table
+  inline MappingTableType *GetMappingTable() { return table_p; }
+  // * GetRootID() - Returns the node ID of the current root
+  inline NodeIDType GetRootID() const { return root_id.load(); }
+  // * SetHTMEnabled() - Enables or disables the RTM split path before the tree is shared. Returns 
+  //                     whether it is enabled, which is false if the CPU does not support RTM
+  inline bool SetHTMEnabled(bool enabled) { return htm_enabled = enabled && HTMIsSupported(); }
+  // * IsHTMEnabled() - Returns whether splits try to post the separator in an RTM transaction
+  inline bool IsHTMEnabled() const { return htm_enabled; }
+
+  /*
+   * BulkLoad() - Builds the tree from key value pairs sorted by key
+   * 
+   * 1. The tree must be empty, and no other thread may access it during bulk load
+   * 2. Leaves are filled to BULK_LOAD_LEAF_SIZE items, and inner levels are built
+   *    bottom up. No delta or SMO is involved
+   * 3. Returns false without changing the tree if keys are not strictly increasing
+   */
+  bool BulkLoad(const std::vector<KeyValuePairType> &item_list) {
+    AssertInitialState();
+    for(size_t i = 1;i < item_list.size();i++) {
+      if((item_list[i - 1].first < item_list[i].first) == false) { return false; }
+    }
+
+    LeafLevel level{};
+    for(size_t start = 0;start < item_list.size();start += BULK_LOAD_LEAF_SIZE) {
+      size_t end = std::min(start + size_t{BULK_LOAD_LEAF_SIZE}, item_list.size());
+      BoundKeyType low_key = start == 0 ? BoundKeyType::GetInf() : BoundKeyType::Get(item_list[start].first);
+      BoundKeyType high_key = end == item_list.size() ? BoundKeyType::GetInf() : BoundKeyType::Get(item_list[end].first);
+      LeafBaseType *leaf_p = LeafBaseType::Get(NodeType::LeafBase, static_cast<NodeSizeType>(end - start), low_key, high_key);
+      for(size_t i = start;i < end;i++) {
+        leaf_p->KeyAt(static_cast<int>(i - start)) = item_list[i].first;
+        leaf_p->ValueAt(static_cast<int>(i - start)) = item_list[i].second;
+      }
+      AddLeaf(&level, leaf_p, low_key, high_key);
+    }
+
+    InstallLeafLevel(level);
+    return true;
+  }
+
+  /*
+   * Checkpoint() - Writes all key value pairs into a checkpoint file in key order
+   * 
+   * 1. Leaves are consolidated one by one, and their items are regrouped into 
+   *    blocks of BULK_LOAD_LEAF_SIZE items. Each block is the image of a leaf 
+   *    base node at the map address chosen for the file
+   * 2. Concurrent operations are allowed and never blocked. Leaves are found by
+   *    walking the mapping table, and each is read from a consistent snapshot 
+   *    of its delta chain pinned in its own epoch, so GC is not held back for 
+   *    the duration of the checkpoint. The file is not a snapshot of the tree
+   * 3. The file replaces the old one only after it is fsync()'ed. Returns false
+   *    on I/O errors, in which case the old file is kept
+   * 4. If logging is enabled, the replay LSN is taken before leaves are read. 
+   *    Every change with a smaller LSN is in the file, and later changes may or 
+   *    may not be. Replaying them again converges, since successful inserts and
+   *    deletes of a key alternate
+   * 5. Dirty bits of the mapping table are cleared before leaves are read, and
+   *    the file becomes the base of later incremental checkpoints. If writing
+   *    fails, incremental checkpoints are refused until the next full one
+   */
+  bool Checkpoint(const std::string &path) {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Checkpoint requires trivially copyable keys and values");
+    FileWriter writer{};
+    if(writer.Open(path) == false) { return false; }
+    CheckpointHeader header{};
+    writer.Write(&header, sizeof(header));
+    writer.Pad(CheckpointHeader::BLOCK_ALIGNMENT);
+    // Leaves are usually less than full, so this is larger than the file. Leaves used in place from a 
+    // resident file are not in base node bytes, and are counted by the size of the file
+    MemoryUsage usage = GetMemoryUsage();
+    const char *map_address_p = static_cast<const char *>(
+      MappedFile::ReserveAddress(2 * (usage.base_node + usage.delta + usage.mapped_file)));
+    header.log_lsn = log_p == nullptr ? 0 : log_p->GetReplayLSN();
+    table_p->ClearDirty();
+    checkpoint_id = 0;
+
+    std::vector<CheckpointIndexEntry> index_list{};
+    std::vector<KeyType> key_list{};
+    std::vector<ValueType> value_list{};
+    std::vector<char> image{};
+    // A block is written when the first key of the next block is known, which is its high key
+    auto write_block = [&](const BoundKeyType &high_key) {
+      NodeSizeType size = static_cast<NodeSizeType>(key_list.size());
+      BoundKeyType low_key = index_list.empty() ? BoundKeyType::GetInf() : BoundKeyType::Get(key_list[0]);
+      size_t offset = writer.GetOffset();
+      image.assign(LeafBaseType::GetAllocationSize(size), 0);
+      LeafBaseType *leaf_p = LeafBaseType::GetAt(image.data(), NodeType::LeafBase, size, low_key, high_key);
+      std::copy(key_list.begin(), key_list.end(), &leaf_p->KeyAt(0));
+      std::copy(value_list.begin(), value_list.end(), &leaf_p->ValueAt(0));
+      if(map_address_p != nullptr) { leaf_p->Relocate(map_address_p + offset); }
+      writer.Write(image.data(), image.size());
+      writer.Pad(CheckpointHeader::BLOCK_ALIGNMENT);
+      index_list.push_back(CheckpointIndexEntry{offset, key_list.size(), key_list[0]});
+      key_list.clear();
+      value_list.clear();
+      return;
+    };
+    ScanLeavesFuzzy([&key_list, &value_list, &write_block](const KeyValuePairType *item_p, size_t count) {
+      for(size_t i = 0;i < count;i++) {
+        if(key_list.size() == BULK_LOAD_LEAF_SIZE) { write_block(BoundKeyType::Get(item_p[i].first)); }
+        key_list.push_back(item_p[i].first);
+        value_list.push_back(item_p[i].second);
+      }
+    });
+    if(key_list.empty() == false) { write_block(BoundKeyType::GetInf()); }
+
+    header.magic = CheckpointHeader::MAGIC;
+    header.version = CheckpointHeader::VERSION;
+    header.key_size = sizeof(KeyType);
+    header.value_size = sizeof(ValueType);
+    header.index_entry_size = sizeof(CheckpointIndexEntry);
+    header.node_header_size = LeafBaseType::GetItemOffset();
+    header.block_count = index_list.size();
+    header.item_count = 0;
+    for(const CheckpointIndexEntry &entry : index_list) { header.item_count += entry.item_count; }
+    header.index_offset = writer.GetOffset();
+    writer.Write(index_list.data(), index_list.size() * sizeof(CheckpointIndexEntry));
+    header.file_size = writer.GetOffset();
+    header.map_address = reinterpret_cast<uint64_t>(map_address_p);
+    header.checkpoint_id = NewCheckpointID();
+    writer.WriteAt(0, &header, sizeof(header));
+    if(writer.Commit() == false) { return false; }
+    checkpoint_id = header.checkpoint_id;
+    checkpoint_sequence = 0;
+    return true;
+  }
+
+  /*
+   * CheckpointIncremental() - Writes leaves changed since the last checkpoint
+   * 
+   * 1. The slots whose dirty bits are set are collected and cleared first. Each
+   *    such leaf is consolidated within its own epoch and written as an image
+   *    with its key range. Inner nodes are not written, since they are rebuilt
+   *    on load
+   * 2. A dirty slot may hold a split sibling that is not in the tree, because 
+   *    its CAS has not happened yet or has failed. The leaf written for a slot 
+   *    is the one a traversal to its low key reaches, which is the leaf itself
+   *    if it is in the tree, or the leaf holding the items of its range
+   * 3. Concurrent operations are allowed as in Checkpoint(), but not another
+   *    checkpoint. A leaf changed after its bit is cleared is written again by
+   *    the next segment
+   * 4. Returns false if no full checkpoint was taken or loaded by the tree, or 
+   *    on I/O errors. In the latter case the collected bits are set again
+   */
+  bool CheckpointIncremental(const std::string &path) {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Checkpoint requires trivially copyable keys and values");
+    if(checkpoint_id == 0) { return false; }
+    FileWriter writer{};
+    if(writer.Open(path) == false) { return false; }
+    IncrementalCheckpointHeader header{};
+    writer.Write(&header, sizeof(header));
+    writer.Pad(CheckpointHeader::BLOCK_ALIGNMENT);
+    header.log_lsn = log_p == nullptr ? 0 : log_p->GetReplayLSN();
+    std::vector<NodeIDType> dirty_list{};
+    table_p->ClearDirty(&dirty_list);
+
+    std::vector<IncrementalIndexEntry> index_list{};
+    std::vector<char> image{};
+    // Leaves already written. Changes after the dirty bits are cleared are in the next segment
+    std::set<NodeIDType> written_set{};
+    for(NodeIDType dirty_id : dirty_list) {
+      EpochNodeType *epoch_p = EnterEpoch();
+      NodeIDType node_id;
+      NodeBaseType *node_p = FindReachableLeaf(dirty_id, &node_id);
+      if(node_p == nullptr || written_set.insert(node_id).second == false) { 
+        ExitEpoch(epoch_p);
+        continue; 
+      }
+
+      LeafBaseType *leaf_p;
+      bool consolidated = node_p->GetType() != NodeType::LeafBase;
+      if(consolidated == true) {
+        ConsolidatorType consolidator{node_p};
+        ConsolidationTraverserType::Traverse(node_p, &consolidator);
+        leaf_p = consolidator.GetNewLeafBase();
+      } else {
+        leaf_p = static_cast<LeafBaseType *>(node_p);
+      }
+
+      NodeSizeType size = leaf_p->GetSize();
+      IncrementalIndexEntry entry{writer.GetOffset(), size, *leaf_p->GetLowKey(), *leaf_p->GetHighKey()};
+      image.assign(LeafBaseType::GetAllocationSize(size), 0);
+      LeafBaseType *image_p = LeafBaseType::GetAt(image.data(), NodeType::LeafBase, size, entry.low_key, entry.high_key);
+      if(size != 0) {
+        std::copy(&leaf_p->KeyAt(0), &leaf_p->KeyAt(0) + size, &image_p->KeyAt(0));
+        std::copy(&leaf_p->ValueAt(0), &leaf_p->ValueAt(0) + size, &image_p->ValueAt(0));
+      }
+      if(consolidated == true) { LeafBaseType::Destroy(leaf_p); }
+      ExitEpoch(epoch_p);
+
+      writer.Write(image.data(), image.size());
+      writer.Pad(CheckpointHeader::BLOCK_ALIGNMENT);
+      index_list.push_back(entry);
+      header.item_count += size;
+    }
+
+    header.magic = IncrementalCheckpointHeader::MAGIC;
+    header.version = IncrementalCheckpointHeader::VERSION;
+    header.key_size = sizeof(KeyType);
+    header.value_size = sizeof(ValueType);
+    header.index_entry_size = sizeof(IncrementalIndexEntry);
+    header.node_header_size = LeafBaseType::GetItemOffset();
+    header.base_id = checkpoint_id;
+    header.sequence = checkpoint_sequence + 1;
+    header.block_count = index_list.size();
+    header.index_offset = writer.GetOffset();
+    writer.Write(index_list.data(), index_list.size() * sizeof(IncrementalIndexEntry));
+    header.file_size = writer.GetOffset();
+    writer.WriteAt(0, &header, sizeof(header));
+    if(writer.Commit() == false) {
+      for(NodeIDType node_id : dirty_list) { table_p->MarkDirty(node_id); }
+      return false;
+    }
+
+    checkpoint_sequence++;
+    return true;
+  }
+
+  /*
+   * Load() - Rebuilds the tree from a file written by Checkpoint()
+   * 
+   * 1. The tree must be empty, and no other thread may access it during load
+   * 2. In Copy mode, the file is mapped, validated, and each block is copied into
+   *    a leaf. The mapping is released before returning
+   * 3. In Resident mode, the file is mapped at its map address and the leaves are
+   *    used in place. Only the header and the index are read, and the inner 
+   *    levels are built from the index. The mapping is kept until the tree is 
+   *    destroyed. Updates are posted as deltas on the mapped leaves, and the
+   *    first consolidation of a leaf copies it to the heap
+   * 4. Resident mode falls back to Copy mode if the address range is taken, or
+   *    if DeltaChainType has state, which node images cannot carry
+   * 5. Returns false without changing the tree if the file cannot be mapped, was
+   *    written by a tree of other node layout, or fails validation. Blocks are 
+   *    not validated in Resident mode, since that would read the whole file
+   */
+  bool Load(const std::string &path, LoadMode mode = LoadMode::Copy) {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Checkpoint requires trivially copyable keys and values");
+    AssertInitialState();
+    if(mode == LoadMode::Resident && LoadResident(path) == true) { return true; }
+    return Load(path, std::vector<std::string>{});
+  }
+
+  /*
+   * Load() - Rebuilds the tree from a full checkpoint and incremental segments
+   *          taken after it
+   * 
+   * 1. All files are mapped and validated first. Segments must belong to the
+   *    full checkpoint and be given in order starting from sequence 1
+   * 2. Ranges of the segments are merged into an ordered map of disjoint pieces,
+   *    where a later range cuts or removes the pieces it overlaps. Items of the
+   *    full checkpoint and of the pieces are then merged in one ordered pass, 
+   *    and leaves are built as in bulk load. Files are copied, not used in place
+   * 3. The loaded files become the base of later incremental checkpoints, which
+   *    continue the sequence
+   * 4. Returns false without changing the tree if any file fails validation
+   */
+  bool Load(const std::string &path, const std::vector<std::string> &incremental_path_list) {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Checkpoint requires trivially copyable keys and values");
+    AssertInitialState();
+    MappedFile file{};
+    if(file.Open(path) == false) { return false; }
+    file.AdviseSequential();
+    if(ValidateCheckpoint(file, true) == false) { return false; }
+    const CheckpointHeader *header_p = reinterpret_cast<const CheckpointHeader *>(file.GetData());
+    std::vector<std::unique_ptr<MappedFile>> segment_list{};
+    for(const std::string &segment_path : incremental_path_list) {
+      segment_list.emplace_back(new MappedFile{});
+      MappedFile *segment_p = segment_list.back().get();
+      if(segment_p->Open(segment_path) == false) { return false; }
+      segment_p->AdviseSequential();
+      if(ValidateIncremental(*segment_p, header_p->checkpoint_id, segment_list.size()) == false) { return false; }
+    }
+
+    OverlayMapType overlay{};
+    for(const std::unique_ptr<MappedFile> &segment_p : segment_list) {
+      const IncrementalCheckpointHeader *segment_header_p = \
+        reinterpret_cast<const IncrementalCheckpointHeader *>(segment_p->GetData());
+      const IncrementalIndexEntry *index_p = \
+        reinterpret_cast<const IncrementalIndexEntry *>(segment_p->GetData() + segment_header_p->index_offset);
+      for(uint64_t i = 0;i < segment_header_p->block_count;i++) {
+        LeafBaseType *block_p = reinterpret_cast<LeafBaseType *>(const_cast<char *>(segment_p->GetData() + index_p[i].offset));
+        AddOverlayPiece(&overlay, index_p[i].low_key, OverlayPiece{index_p[i].high_key, block_p, 0, block_p->GetSize()});
+      }
+    }
+
+    LeafLevel level{};
+    std::vector<KeyType> key_list{};
+    std::vector<ValueType> value_list{};
+    // A leaf is built when the first key of the next leaf is known, which is its high key
+    auto build_leaf = [&](const BoundKeyType &high_key) {
+      NodeSizeType size = static_cast<NodeSizeType>(key_list.size());
+      BoundKeyType low_key = level.id_list.empty() ? BoundKeyType::GetInf() : BoundKeyType::Get(key_list[0]);
+      LeafBaseType *leaf_p = LeafBaseType::Get(NodeType::LeafBase, size, low_key, high_key);
+      std::copy(key_list.begin(), key_list.end(), &leaf_p->KeyAt(0));
+      std::copy(value_list.begin(), value_list.end(), &leaf_p->ValueAt(0));
+      AddLeaf(&level, leaf_p, low_key, high_key);
+      key_list.clear();
+      value_list.clear();
+      return;
+    };
+    auto add_item = [&](const KeyType &key, const ValueType &value) {
+      if(key_list.size() == BULK_LOAD_LEAF_SIZE) { build_leaf(BoundKeyType::Get(key)); }
+      key_list.push_back(key);
+      value_list.push_back(value);
+      return;
+    };
+    auto add_piece = [&](const OverlayPiece &piece) {
+      for(NodeSizeType i = piece.begin;i < piece.end;i++) { add_item(piece.block_p->KeyAt(i), piece.block_p->ValueAt(i)); }
+      return;
+    };
+
+    const CheckpointIndexEntry *index_p = \
+      reinterpret_cast<const CheckpointIndexEntry *>(file.GetData() + header_p->index_offset);
+    typename OverlayMapType::iterator it = overlay.begin();
+    for(uint64_t i = 0;i < header_p->block_count;i++) {
+      LeafBaseType *block_p = reinterpret_cast<LeafBaseType *>(const_cast<char *>(file.GetData() + index_p[i].offset));
+      for(NodeSizeType j = 0;j < block_p->GetSize();j++) {
+        const KeyType &key = block_p->KeyAt(j);
+        while(it != overlay.end() && it->second.high_key.IsInf() == false && it->second.high_key.key <= key) { 
+          add_piece(it->second); 
+          ++it;
+        }
+        // Items covered by a piece are replaced by the piece
+        if(it != overlay.end() && (it->first.IsInf() || it->first.key <= key)) { continue; }
+        add_item(key, block_p->ValueAt(j));
+      }
+    }
+    for(;it != overlay.end();++it) { add_piece(it->second); }
+    if(key_list.empty() == false) { build_leaf(BoundKeyType::GetInf()); }
+
+    InstallLeafLevel(level);
+    table_p->ClearDirty();
+    checkpoint_id = header_p->checkpoint_id;
+    checkpoint_sequence = segment_list.size();
+    return true;
+  }
+
+  // * IsResident() - Returns whether leaves are used in place in a mapped checkpoint
+  inline bool IsResident() const { return resident_file_p != nullptr; }
+
+  /*
+   * EnableLog() - Opens the write-ahead log and records later inserts and deletes
+   * 
+   * 1. No other thread may access the tree during the call
+   * 2. An existing log is appended to, and its LSNs are continued. Call 
+   *    Recover() first to apply it to the tree
+   * 3. Returns false if the log cannot be opened. If it fails later, operations
+   *    waiting for their changes to be durable exit through err_printf()
+   */
+  bool EnableLog(const std::string &path, const WriteAheadLog::Config &config = WriteAheadLog::Config{}) {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Logging requires trivially copyable keys and values");
+    DisableLog();
+    WriteAheadLog *new_log_p = new WriteAheadLog{};
+    if(new_log_p->Open(path, config) == false) {
+      delete new_log_p;
+      return false;
+    }
+
+    log_p = new_log_p;
+    return true;
+  }
+
+  // * DisableLog() - Writes buffered records and closes the log. No other thread may access the tree
+  void DisableLog() {
+    delete log_p;
+    log_p = nullptr;
+    return;
+  }
+
+  // * GetLog() - Returns the write-ahead log, or nullptr if logging is disabled
+  inline WriteAheadLog *GetLog() { return log_p; }
+
+  /*
+   * Recover() - Rebuilds the tree from a checkpoint and the write-ahead log
+   * 
+   * 1. The tree must be empty and logging disabled. No other thread may access
+   *    the tree during recovery
+   * 2. The checkpoint is loaded if the file exists, and log records from its 
+   *    log LSN on are applied in LSN order. Without a checkpoint the whole log
+   *    is applied
+   * 3. Returns false if the checkpoint or the log exists but cannot be read, or
+   *    if a record does not match the key and value sizes. The tree may be
+   *    partially recovered in the latter case
+   */
+  bool Recover(const std::string &checkpoint_path, const std::string &log_path, LoadMode mode = LoadMode::Copy) {
+    assert(log_p == nullptr);
+    uint64_t start_lsn = 0;
+    if(FileExists(checkpoint_path) == true) {
+      CheckpointHeader header{};
+      if(ReadHeader(checkpoint_path, &header) == false || Load(checkpoint_path, mode) == false) { return false; }
+      start_lsn = header.log_lsn;
+    } else {
+      AssertInitialState();
+    }
+
+    return ReplayLog(log_path, start_lsn);
+  }
+
+  /*
+   * Recover() - Rebuilds the tree from a full checkpoint, incremental segments
+   *             and the write-ahead log
+   * 
+   * The log is replayed from the log LSN of the last segment. The checkpoint 
+   * must exist
+   */
+  bool Recover(const std::string &checkpoint_path, const std::vector<std::string> &incremental_path_list, 
+               const std::string &log_path) {
+    assert(log_p == nullptr);
+    CheckpointHeader header{};
+    if(ReadHeader(checkpoint_path, &header) == false) { return false; }
+    uint64_t start_lsn = header.log_lsn;
+    if(incremental_path_list.empty() == false) {
+      IncrementalCheckpointHeader segment_header{};
+      if(ReadHeader(incremental_path_list.back(), &segment_header) == false) { return false; }
+      start_lsn = segment_header.log_lsn;
+    }
+    if(Load(checkpoint_path, incremental_path_list) == false) { return false; }
+
+    return ReplayLog(log_path, start_lsn);
+  }
+
+  /*
+   * GetStatistics() - Returns a snapshot of statistics
+   * 
+   * Counters are read without synchronization. The structure is walked within
+   * an epoch, and inner nodes with deltas are consolidated into temporary nodes
+   */
+  Statistics GetStatistics() {
+    Statistics stat{};
+    for(size_t i = 0;i < STAT_COUNTER_COUNT;i++) { stat.counter_list[i] = stat_counter.Get(i); }
+
+    EpochNodeType *epoch_p = EnterEpoch();
+    std::vector<bool> visited{};
+    std::vector<NodeIDType> current_list{root_id.load()}, next_list{};
+    while(current_list.empty() == false) {
+      typename Statistics::LevelStatistics level{};
+      // Split siblings not yet in the parent are appended to the current level
+      for(size_t i = 0;i < current_list.size();i++) {
+        NodeIDType node_id = current_list[i];
+        if(node_id >= visited.size()) { visited.resize(node_id + 1, false); }
+        if(visited[node_id] == true) { continue; }
+        visited[node_id] = true;
+        NodeBaseType *node_p = table_p->At(node_id);
+        if(node_p == nullptr) { continue; }
+
+        size_t threshold = node_p->IsLeaf() ? LEAF_SIZE_THRESHOLD : INNER_SIZE_THRESHOLD;
+        level.leaf = node_p->IsLeaf();
+        level.node_count++;
+        level.item_count += node_p->GetSize();
+        level.delta_count += node_p->GetHeight();
+        stat.chain_height_list[std::min<size_t>(node_p->GetHeight(), size_t{Statistics::MAX_HEIGHT_BUCKET})]++;
+        stat.fill_list[std::min<size_t>(node_p->GetSize() * 10 / threshold, Statistics::FILL_BUCKET_COUNT - 1)]++;
+
+        LeafSplitType *split_p = GetSplitDelta(node_p);
+        if(split_p != nullptr) { current_list.push_back(split_p->GetSplitNodeID()); }
+        if(node_p->IsLeaf() == false) { GetChildren(node_p, &next_list); }
+      }
+
+      size_t threshold = level.leaf ? LEAF_SIZE_THRESHOLD : INNER_SIZE_THRESHOLD;
+      level.fill_factor = level.node_count == 0 ? 0.0 : static_cast<double>(level.item_count) / (level.node_count * threshold);
+      stat.level_list.push_back(level);
+      current_list.swap(next_list);
+      next_list.clear();
+    }
+
+    ExitEpoch(epoch_p);
+    return stat;
+  }
+
+  /*
+   * GetMemoryUsage() - Returns bytes used by each subsystem
+   * 
+   * This only sums per-thread counters, and is cheap enough to be called for
+   * every quota check
+   */
+  MemoryUsage GetMemoryUsage() const {
+    MemoryUsage usage{};
+    usage.mapping_table_reserved = table_p->GetReservedSize();
+    usage.mapping_table_used = table_p->GetUsedSize();
+    usage.base_node = static_cast<size_t>(std::max<int64_t>(memory_counter.GetSigned(MemoryBaseNode), 0));
+    usage.delta = static_cast<size_t>(std::max<int64_t>(memory_counter.GetSigned(MemoryDelta), 0));
+    int64_t backlog = stat_counter.GetSigned(StatGarbageBytes) - stat_counter.GetSigned(StatFreedBytes);
+    usage.gc_backlog = static_cast<size_t>(std::max<int64_t>(backlog, 0));
+    usage.mapped_file = resident_file_p == nullptr ? 0 : resident_file_p->GetSize();
+    return usage;
+  }
+
+  /*
+   * Analyze() - Checks the structure of the tree and measures it
+   * 
+   * 1. Each delta chain is checked by DeltaChainVerifier. The low key and high key
+   *    of each node must match the separators in its parent. A node whose high key
+   *    is smaller than the parent's bound must have an unfinished split, and the 
+   *    split sibling continues the range
+   * 2. Each node in the mapping table must be reached exactly once
+   * 3. The top levels are expanded by the calling thread until there are enough
+   *    subtrees, which are then verified by thread_num threads. The calling thread
+   *    holds an epoch for all of them
+   * 4. The result is only exact if no thread modifies the tree
+   */
+  Analysis Analyze(size_t thread_num = 1) {
+    always_assert(thread_num > 0);
+    EpochNodeType *epoch_p = EnterEpoch();
+    NodeIDType slot_count = table_p->GetNextSlot();
+    std::vector<std::atomic<bool>> visited_list(slot_count);
+    for(auto &visited : visited_list) { visited.store(false); }
+
+    Analysis result{};
+    std::vector<VerifyTask> task_list{VerifyTask{root_id.load(), BoundKeyType::GetInf(), BoundKeyType::GetInf(), 1}};
+    std::vector<VerifyTask> next_list{};
+    while(task_list.empty() == false && task_list.size() < thread_num * VERIFY_TASK_PER_THREAD) {
+      for(const VerifyTask &task : task_list) { VerifyNode(task, &visited_list, &result, &next_list); }
+      task_list.swap(next_list);
+      next_list.clear();
+    }
+
+    std::atomic<size_t> next_task{0};
+    std::vector<Analysis> result_list(thread_num);
+    auto func = [this, &task_list, &next_task, &visited_list, &result_list](size_t thread_id) {
+      std::vector<VerifyTask> stack{};
+      for(size_t i = next_task.fetch_add(1);i < task_list.size();i = next_task.fetch_add(1)) {
+        stack.push_back(task_list[i]);
+        while(stack.empty() == false) {
+          VerifyTask task = stack.back();
+          stack.pop_back();
+          VerifyNode(task, &visited_list, &result_list[thread_id], &stack);
+        }
+      }
+    };
+
+    std::vector<std::thread> thread_list{};
+    for(size_t i = 1;i < thread_num;i++) { thread_list.emplace_back(func, i); }
+    func(0);
+    for(std::thread &thread : thread_list) { thread.join(); }
+    for(const Analysis &thread_result : result_list) { result.Merge(thread_result); }
+
+    for(NodeIDType node_id = 0;node_id < slot_count;node_id++) {
+      if(visited_list[node_id].load() == false && table_p->At(node_id) != nullptr) {
+        result.unreachable_count++;
+        result.AddError(node_id, "not reachable from the root");
+      }
+    }
+    if(result.min_leaf_depth != result.max_leaf_depth) { result.AddError(root_id.load(), "leaves on different levels"); }
+
+    ExitEpoch(epoch_p);
+    return result;
+  }
+
+  // * Verify() - Returns true if Analyze() finds no error
+  inline bool Verify(size_t thread_num = 1) { return Analyze(thread_num).IsValid(); }
+
+  // * GetLatency() - Returns the latency histogram of an operation type merged over threads
+  //                  (always empty unless BWTREE_LATENCY is defined)
+  inline LatencyHistogram GetLatency(LatencyOp op) const { return latency_recorder.Merge(op); }
+  // * ResetLatency() - Clears latency histograms. Must not be called concurrently with operations
+  inline void ResetLatency() { latency_recorder.Reset(); }
+
+  // * PrintLatency() - Prints a summary line for each operation type that has samples
+  void PrintLatency(FILE *fp) const {
+    static const char *op_name_list[LATENCY_OP_COUNT] = \
+      {"insert", "delete", "get", "scan", "consolidate", "split", "finish-split"};
+    for(size_t op = 0;op < LATENCY_OP_COUNT;op++) {
+      LatencyHistogram histogram = latency_recorder.Merge(op);
+      if(histogram.GetCount() != 0) { histogram.Print(fp, op_name_list[op], false); }
+    }
+
+    return;
+  }
+
+ private:
+  // * EnterEpoch() - Joins the epoch before an operation
+  inline EpochNodeType *EnterEpoch() { return epoch_manager_p->JoinEpoch(); }
+  
+  // * ExitEpoch() - Leaves the epoch after an operation, and tries GC periodically
+  inline void ExitEpoch(EpochNodeType *epoch_p, ThreadContext *thread_p = nullptr) {
+    epoch_manager_p->LeaveEpoch(epoch_p);
+    static thread_local size_t op_count = 0;
+    size_t &count = thread_p == nullptr ? op_count : thread_p->op_count;
+    if(++count % GC_INTERVAL == 0) { epoch_manager_p->PerformGC(); }
+    return;
+  }
+
+  // * FreeDeltaChain() - Frees a delta chain including the base node
+  void FreeDeltaChain(NodeBaseType *node_p) {
+    // Leaves in the resident file are not freed
+    const char *mapped_begin_p = resident_file_p == nullptr ? nullptr : resident_file_p->GetData();
+    size_t mapped_size = resident_file_p == nullptr ? 0 : resident_file_p->GetSize();
+    DeltaChainFreeHelperType dcfh{table_p, mapped_begin_p, mapped_begin_p + mapped_size};
+    FreeTraverserType::Traverse(node_p, &dcfh);
+    return;
+  }
+
+  // * RetireDeltaChain() - Hands a delta chain that has been replaced to the epoch manager
+  void RetireDeltaChain(NodeBaseType *node_p, size_t thread_index = ThreadIndex::Get()) {
+    DeltaChainSizeHelperType dcsh{};
+    SizeTraverserType::Traverse(node_p, &dcsh);
+    size_t mapped_size = GetMappedBaseSize(node_p);
+    memory_counter.Sub(MemoryBaseNode, dcsh.GetBaseSize() - mapped_size, thread_index);
+    memory_counter.Sub(MemoryDelta, dcsh.GetDeltaSize(), thread_index);
+    stat_counter.Add(StatGarbageBytes, dcsh.GetSize() - mapped_size, thread_index);
+    epoch_manager_p->AddGarbage(node_p);
+    return;
+  }
+
+  // * RetireDeltaChainList() - Hands a batch of replaced delta chains to the epoch manager
+  void RetireDeltaChainList(const std::vector<NodeBaseType *> &node_list, size_t thread_index = ThreadIndex::Get()) {
+    size_t base_size = 0;
+    size_t delta_size = 0;
+    for(NodeBaseType *node_p : node_list) {
+      DeltaChainSizeHelperType dcsh{};
+      SizeTraverserType::Traverse(node_p, &dcsh);
+      base_size += dcsh.GetBaseSize() - GetMappedBaseSize(node_p);
+      delta_size += dcsh.GetDeltaSize();
+    }
+    memory_counter.Sub(MemoryBaseNode, base_size, thread_index);
+    memory_counter.Sub(MemoryDelta, delta_size, thread_index);
+    stat_counter.Add(StatGarbageBytes, base_size + delta_size, thread_index);
+    epoch_manager_p->AddGarbageList(node_list.data(), node_list.size());
+    return;
+  }
+
+  // * FreeGarbage() - Called by the epoch manager to free a delta chain
+  void FreeGarbage(NodeBaseType *node_p) {
+    stat_counter.Add(StatFreedBytes, GetChainSize(node_p) - GetMappedBaseSize(node_p));
+    FreeDeltaChain(node_p);
+    return;
+  }
+
+  // * GetMappedBaseSize() - Returns the size of the base node if it is in the resident file, or 0
+  size_t GetMappedBaseSize(NodeBaseType *node_p) {
+    ExtendedBaseType *base_p = node_p->template GetBase<DeltaChainType>();
+    if(resident_file_p == nullptr || resident_file_p->Contains(base_p) == false) { return 0; }
+    return static_cast<LeafBaseType *>(base_p)->GetAllocationSize();
+  }
+
+  // * GetChainSize() - Returns the number of bytes of a delta chain
+  static size_t GetChainSize(NodeBaseType *node_p) {
+    DeltaChainSizeHelperType dcsh{};
+    SizeTraverserType::Traverse(node_p, &dcsh);
+    return dcsh.GetSize();
+  }
+
+  // * class VerifyTask - A subtree to be verified, and the range given by the parent
+  class VerifyTask {
+   public:
+    NodeIDType node_id;
+    BoundKeyType low_key;
+    BoundKeyType high_key;
+    uint64_t depth;
+  };
+
+  // * BoundKeyEqual() - Returns whether two bound keys are both infinite or have equal keys
+  static bool BoundKeyEqual(const BoundKeyType &key1, const BoundKeyType &key2) {
+    return key1.IsInf() == key2.IsInf() && (key1.IsInf() == true || key1 == key2.key);
+  }
+
+  /*
+   * VerifyNode() - Verifies a node and its unfinished split siblings, and appends
+   *                tasks of their children
+   * 
+   * The children of an inner node cover [separator i, separator i + 1). The low 
+   * key of the first child and the high key of the last child are the bounds of
+   * the inner node itself
+   */
+  void VerifyNode(const VerifyTask &task, std::vector<std::atomic<bool>> *visited_list_p, 
+                  Analysis *result_p, std::vector<VerifyTask> *task_list_p) {
+    NodeIDType node_id = task.node_id;
+    BoundKeyType low_key = task.low_key;
+    while(true) {
+      if(node_id >= visited_list_p->size()) { result_p->AddError(node_id, "node ID out of range"); return; }
+      if((*visited_list_p)[node_id].exchange(true) == true) { result_p->AddError(node_id, "reachable more than once"); return; }
+      NodeBaseType *node_p = table_p->At(node_id);
+      if(node_p == nullptr) { result_p->AddError(node_id, "empty mapping table slot"); return; }
+
+      DeltaChainVerifierType verifier{};
+      VerifyTraverserType::Traverse(node_p, &verifier);
+      if(verifier.GetError() != nullptr) { result_p->AddError(node_id, verifier.GetError()); }
+      if(BoundKeyEqual(*node_p->GetLowKey(), low_key) == false) { result_p->AddError(node_id, "low key differs from the parent"); }
+
+      size_t chain_size = GetChainSize(node_p);
+      size_t base_size = node_p->IsLeaf() ? 
+        sizeof(LeafBaseType) + size_t{node_p->GetSize()} * (sizeof(KeyType) + sizeof(ValueType)) :
+        sizeof(InnerBaseType) + size_t{node_p->GetSize()} * (sizeof(KeyType) + sizeof(NodeIDType));
+      result_p->node_count++;
+      result_p->total_bytes += chain_size;
+      result_p->wasted_bytes += chain_size > base_size ? chain_size - base_size : 0;
+      if(node_p->IsLeaf()) {
+        result_p->leaf_count++;
+        result_p->item_count += node_p->GetSize();
+        result_p->min_leaf_depth = std::min(result_p->min_leaf_depth, task.depth);
+        result_p->max_leaf_depth = std::max(result_p->max_leaf_depth, task.depth);
+        if(node_p->GetType() != NodeType::LeafBase) { VerifyLeafContent(node_id, node_p, result_p); }
+      } else {
+        AddChildTasks(node_id, node_p, task.depth, result_p, task_list_p);
+      }
+
+      // The node covers the rest of the parent's range, or it has an unfinished split
+      const BoundKeyType &high_key = *node_p->GetHighKey();
+      if(BoundKeyEqual(high_key, task.high_key) == true) { break; }
+      if(high_key.IsInf() == true || (task.high_key.IsInf() == false && task.high_key <= high_key.key)) { 
+        result_p->AddError(node_id, "high key larger than the parent"); 
+        break; 
+      }
+      LeafSplitType *split_p = GetSplitDelta(node_p);
+      if(split_p == nullptr) { result_p->AddError(node_id, "high key smaller than the parent without split"); break; }
+      low_key = high_key;
+      node_id = split_p->GetSplitNodeID();
+    }
+
+    return;
+  }
+
+  // * VerifyLeafContent() - Checks the logical content of a leaf with deltas
+  void VerifyLeafContent(NodeIDType node_id, NodeBaseType *node_p, Analysis *result_p) {
+    ConsolidatorType consolidator{node_p};
+    ConsolidationTraverserType::Traverse(node_p, &consolidator);
+    LeafBaseType *leaf_p = consolidator.GetNewLeafBase();
+    // Deltas may be valid one by one but contradict each other
+    DeltaChainVerifierType verifier{};
+    VerifyTraverserType::Traverse(leaf_p, &verifier);
+    if(verifier.GetError() != nullptr) { result_p->AddError(node_id, verifier.GetError()); }
+    if(leaf_p->GetSize() != node_p->GetSize()) { result_p->AddError(node_id, "size differs from the consolidated node"); }
+    LeafBaseType::Destroy(leaf_p);
+    return;
+  }
+
+  // * AddChildTasks() - Checks the logical content of an inner node and appends its children
+  void AddChildTasks(NodeIDType node_id, NodeBaseType *node_p, uint64_t depth, 
+                     Analysis *result_p, std::vector<VerifyTask> *task_list_p) {
+    InnerBaseType *inner_p;
+    bool consolidated = node_p->GetType() != NodeType::InnerBase;
+    if(consolidated == true) {
+      ConsolidatorType consolidator{node_p};
+      ConsolidationTraverserType::Traverse(node_p, &consolidator);
+      inner_p = consolidator.GetNewInnerBase();
+      // Deltas may be valid one by one but contradict each other
+      DeltaChainVerifierType verifier{};
+      VerifyTraverserType::Traverse(inner_p, &verifier);
+      if(verifier.GetError() != nullptr) { result_p->AddError(node_id, verifier.GetError()); }
+      if(inner_p->GetSize() != node_p->GetSize()) { result_p->AddError(node_id, "size differs from the consolidated node"); }
+    } else {
+      inner_p = static_cast<InnerBaseType *>(node_p);
+    }
+
+    for(NodeSizeType i = 0;i < inner_p->GetSize();i++) {
+      BoundKeyType low_key = i == 0 ? *inner_p->GetLowKey() : BoundKeyType::Get(inner_p->KeyAt(i));
+      BoundKeyType high_key = i + 1 == inner_p->GetSize() ? *inner_p->GetHighKey() : BoundKeyType::Get(inner_p->KeyAt(i + 1));
+      task_list_p->push_back(VerifyTask{inner_p->ValueAt(i), low_key, high_key, depth + 1});
+    }
+
+    if(consolidated == true) { InnerBaseType::Destroy(inner_p); }
+    return;
+  }
+
+  // * GetChildren() - Appends child node IDs of an inner node, excluding split siblings
+  void GetChildren(NodeBaseType *node_p, std::vector<NodeIDType> *child_list_p) {
+    InnerBaseType *inner_p;
+    bool consolidated = node_p->GetType() != NodeType::InnerBase;
+    if(consolidated == true) {
+      ConsolidatorType consolidator{node_p};
+      ConsolidationTraverserType::Traverse(node_p, &consolidator);
+      inner_p = consolidator.GetNewInnerBase();
+    } else {
+      inner_p = static_cast<InnerBaseType *>(node_p);
+    }
+
+    for(NodeSizeType i = 0;i < inner_p->GetSize();i++) { child_list_p->push_back(inner_p->ValueAt(i)); }
+    if(consolidated == true) { InnerBaseType::Destroy(inner_p); }
+    return;
+  }
+
+  // * FindLowerBound() - Returns the index of the first key not less than the given key
+  static NodeSizeType FindLowerBound(LeafBaseType *leaf_p, const KeyType &key) {
+    if(leaf_p->GetSize() == 0 || leaf_p->KeyInNode(key) == false) { return NodeSizeType{0}; }
+    NodeSizeType index = static_cast<NodeSizeType>(leaf_p->Search(key));
+    return leaf_p->KeyAt(index) < key ? index + 1 : index;
+  }
+
+  /*
+   * GetSeparators() - Returns increasing separator keys inside (low key, high key)
+   *                   from the top levels of the tree, expanded level by level
+   *                   until there are at least the given number of partitions 
+   *                   or the leaf level is reached
+   * 
+   * 1. Only children overlapping the range are expanded. Infinite keys mean the
+   *    range is not bounded on that side
+   * 2. Separators of unfinished splits are missed, which only makes partitions larger
+   */
+  std::vector<KeyType> GetSeparators(size_t partition_num, const BoundKeyType &low_key = BoundKeyType::GetInf(), 
+                                     const BoundKeyType &high_key = BoundKeyType::GetInf()) {
+    EpochNodeType *epoch_p = EnterEpoch();
+    std::vector<KeyType> separator_list{};
+    std::vector<NodeIDType> id_list{root_id.load()};
+    while(separator_list.size() + 1 < partition_num && id_list.empty() == false && table_p->At(id_list[0])->IsLeaf() == false) {
+      std::vector<KeyType> next_separator_list{};
+      std::vector<NodeIDType> next_id_list{};
+      for(NodeIDType node_id : id_list) {
+        NodeBaseType *node_p = table_p->At(node_id);
+        InnerBaseType *inner_p;
+        bool consolidated = node_p->GetType() != NodeType::InnerBase;
+        if(consolidated == true) {
+          ConsolidatorType consolidator{node_p};
+          ConsolidationTraverserType::Traverse(node_p, &consolidator);
+          inner_p = consolidator.GetNewInnerBase();
+        } else {
+          inner_p = static_cast<InnerBaseType *>(node_p);
+        }
+
+        // The first key is the low key of the node, which is the separator in the parent
+        if(inner_p->GetLowKey()->IsInf() == false) { next_separator_list.push_back(inner_p->GetLowKey()->key); }
+        for(NodeSizeType i = 0;i < inner_p->GetSize();i++) {
+          if(i != 0) { next_separator_list.push_back(inner_p->KeyAt(i)); }
+          // Child i covers [key i, key i + 1)
+          bool after_low = low_key.IsInf() || i + 1 == inner_p->GetSize() || low_key.key < inner_p->KeyAt(i + 1);
+          bool before_high = high_key.IsInf() || i == 0 || inner_p->KeyAt(i) < high_key.key;
+          if(after_low && before_high) { next_id_list.push_back(inner_p->ValueAt(i)); }
+        }
+        if(consolidated == true) { InnerBaseType::Destroy(inner_p); }
+      }
+
+      // Nodes on a level are in key order, except that a node may have been split
+      // after its parent was read
+      std::sort(next_separator_list.begin(), next_separator_list.end());
+      next_separator_list.erase(std::unique(next_separator_list.begin(), next_separator_list.end()), next_separator_list.end());
+      separator_list.clear();
+      for(const KeyType &key : next_separator_list) {
+        if((low_key.IsInf() || low_key.key < key) && (high_key.IsInf() || key < high_key.key)) { separator_list.push_back(key); }
+      }
+      id_list.swap(next_id_list);
+    }
+
+    ExitEpoch(epoch_p);
+    // The last level may have many more separators than needed. Evenly spaced ones are kept
+    if(separator_list.size() + 1 > partition_num) {
+      std::vector<KeyType> sample_list{};
+      for(size_t i = 1;i < partition_num;i++) { sample_list.push_back(separator_list[i * separator_list.size() / partition_num]); }
+      separator_list.swap(sample_list);
+    }
+    return separator_list;
+  }
+
+  // * class ChunkQueue - A run of adjacent chunks of ParallelScan() owned by one thread
+  class ChunkQueue {
+   public:
+    ChunkQueue() : lock{}, begin{0}, end{0} {}
+
+    // * Init() - Sets the run to chunks [begin, end)
+    void Init(size_t pbegin, size_t pend) { begin = pbegin; end = pend; }
+    // * PopFront() - Takes the first chunk. Called by the owner
+    bool PopFront(size_t *chunk_p) {
+      std::lock_guard<std::mutex> guard{lock};
+      if(begin == end) { return false; }
+      *chunk_p = begin++;
+      return true;
+    }
+    // * PopBack() - Takes the last chunk. Called by other threads
+    bool PopBack(size_t *chunk_p) {
+      std::lock_guard<std::mutex> guard{lock};
+      if(begin == end) { return false; }
+      *chunk_p = --end;
+      return true;
+    }
+
+   private:
+    std::mutex lock;
+    size_t begin;
+    size_t end;
+  };
+
+  /*
+   * ScanRange() - Calls the callback on the consolidated content of the leaves 
+   *               covering [low key, high key), in key order
+   * 
+   * The callback is of signature void(LeafBaseType *, NodeSizeType begin, 
+   * NodeSizeType end), where items [begin, end) of the leaf are in the range
+   */
+  template <typename Callback>
+  void ScanRange(const BoundKeyType &low_key, const BoundKeyType &high_key, Callback &&cb) {
+    ForEachLeaf(low_key, high_key, [&high_key, &cb](NodeBaseType *leaf_p, const BoundKeyType &cursor) {
+      LeafBaseType *base_p;
+      bool consolidated = leaf_p->GetType() != NodeType::LeafBase;
+      if(consolidated == true) {
+        ConsolidatorType consolidator{leaf_p};
+        ConsolidationTraverserType::Traverse(leaf_p, &consolidator);
+        base_p = consolidator.GetNewLeafBase();
+      } else {
+        base_p = static_cast<LeafBaseType *>(leaf_p);
+      }
+
+      std::pair<NodeSizeType, NodeSizeType> range = GetLeafRange(base_p, cursor, high_key);
+      if(range.first < range.second) { cb(base_p, range.first, range.second); }
+      if(consolidated == true) { LeafBaseType::Destroy(base_p); }
+    });
+    return;
+  }
+
+  /*
+   * ForEachLeaf() - Calls the callback on the delta chain of each leaf covering
+   *                 [low key, high key), in key order, within one epoch
+   * 
+   * 1. The callback is of signature void(NodeBaseType *, const BoundKeyType &),
+   *    where the key is the start of the range in the leaf
+   * 2. An infinite low key starts from the leftmost leaf, which is never split away
+   */
+  template <typename Callback>
+  void ForEachLeaf(const BoundKeyType &low_key, const BoundKeyType &high_key, Callback &&cb) {
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{};
+    BoundKeyType cursor = low_key;
+    std::vector<NodeIDType> child_list{};
+    while(true) {
+      NodeBaseType *leaf_p;
+      if(cursor.IsInf() == true) {
+        leaf_p = table_p->At(root_id.load());
+        while(leaf_p->IsLeaf() == false) {
+          child_list.clear();
+          GetChildren(leaf_p, &child_list);
+          leaf_p = table_p->At(child_list[0]);
+        }
+      } else {
+        ValueSearcherType searcher{cursor.key};
+        if(Traverse(cursor.key, &context, &searcher) == false) { continue; }
+        leaf_p = context.leaf_p;
+      }
+
+      cb(leaf_p, cursor);
+      const BoundKeyType &leaf_high_key = *leaf_p->GetHighKey();
+      if(leaf_high_key.IsInf() || (high_key.IsInf() == false && (leaf_high_key.key < high_key.key) == false)) { break; }
+      cursor = leaf_high_key;
+    }
+
+    ExitEpoch(epoch_p);
+    return;
+  }
+
+  // * GetLeafRange() - Returns indices [begin, end) of the items in [low key, high key) of a leaf base node
+  static std::pair<NodeSizeType, NodeSizeType> GetLeafRange(LeafBaseType *leaf_p, const BoundKeyType &low_key, 
+                                                            const BoundKeyType &high_key) {
+    return std::make_pair(low_key.IsInf() ? NodeSizeType{0} : CountLessKeys(leaf_p, low_key.key), 
+                          high_key.IsInf() ? leaf_p->GetSize() : CountLessKeys(leaf_p, high_key.key));
+  }
+
+  // * CountLessKeys() - Returns the number of keys less than the key in a leaf base node. Vectorized for integral keys
+  static NodeSizeType CountLessKeys(LeafBaseType *leaf_p, const KeyType &key) {
+    const KeyType *key_begin_p = &leaf_p->KeyAt(0);
+    return static_cast<NodeSizeType>(IsSIMDType<KeyType>::value ? 
+      CountLess(key_begin_p, leaf_p->GetSize(), key) : 
+      std::lower_bound(key_begin_p, key_begin_p + leaf_p->GetSize(), key) - key_begin_p);
+  }
+
+  // * class ReverseScanParent - The cached parent of the current leaf in ReverseScan(), and the index of the leaf
+  class ReverseScanParent {
+   public:
+    ReverseScanParent() : inner_p{nullptr}, consolidated{false}, index{0} {}
+    ~ReverseScanParent() { Reset(nullptr, false, 0); }
+
+    // * Reset() - Caches another parent. A consolidated parent is owned and destroyed with the cache
+    void Reset(InnerBaseType *pinner_p, bool pconsolidated, NodeSizeType pindex) {
+      if(consolidated == true) { InnerBaseType::Destroy(inner_p); }
+      inner_p = pinner_p;
+      consolidated = pconsolidated;
+      index = pindex;
+    }
+
+    InnerBaseType *inner_p;
+    bool consolidated;
+    NodeSizeType index;
+  };
+
+  /*
+   * ReverseScanFrom() - Implements ReverseScan() from a start key, which is the
+   *                     maximum key if infinite
+   */
+  size_t ReverseScanFrom(const BoundKeyType &start_key, size_t count, std::vector<KeyValuePairType> *result_p, 
+                         ThreadContext *thread_p) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyScan);)
+    size_t copied = 0;
+    if(count == 0) { return copied; }
+    EpochNodeType *epoch_p = EnterEpoch();
+    ReverseScanParent parent{};
+    // Keys not greater than the start key are copied from the first leaf, and keys less than the low key afterwards
+    BoundKeyType bound = start_key;
+    bool inclusive = true;
+    NodeBaseType *leaf_p = DescendLeft(bound, inclusive, &parent);
+    while(true) {
+      LeafBaseType *base_p;
+      bool consolidated = leaf_p->GetType() != NodeType::LeafBase;
+      if(consolidated == true) {
+        ConsolidatorType consolidator{leaf_p};
+        ConsolidationTraverserType::Traverse(leaf_p, &consolidator);
+        base_p = consolidator.GetNewLeafBase();
+      } else {
+        base_p = static_cast<LeafBaseType *>(leaf_p);
+      }
+
+      NodeSizeType end;
+      if(bound.IsInf() == true) {
+        end = base_p->GetSize();
+      } else if(inclusive == true) {
+        const KeyType *key_begin_p = &base_p->KeyAt(0);
+        end = static_cast<NodeSizeType>(std::upper_bound(key_begin_p, key_begin_p + base_p->GetSize(), bound.key) - key_begin_p);
+      } else {
+        end = CountLessKeys(base_p, bound.key);
+      }
+      for(NodeSizeType i = end;i > 0 && copied < count;i--) {
+        result_p->emplace_back(base_p->KeyAt(i - 1), base_p->ValueAt(i - 1));
+        copied++;
+      }
+
+      BoundKeyType low_key = *base_p->GetLowKey();
+      if(consolidated == true) { LeafBaseType::Destroy(base_p); }
+      if(copied == count || low_key.IsInf() == true) { break; }
+      bound = low_key;
+      inclusive = false;
+      leaf_p = GetLeftLeaf(bound, &parent);
+    }
+
+    ExitEpoch(epoch_p, thread_p);
+    return copied;
+  }
+
+  /*
+   * GetLeftLeaf() - Returns the leaf on the left of the leaf whose low key is 
+   *                 the given key
+   * 
+   * The previous child of the cached parent is taken if it still ends at the 
+   * key after following its split siblings. Otherwise the tree is descended
+   */
+  NodeBaseType *GetLeftLeaf(const BoundKeyType &low_key, ReverseScanParent *parent_p) {
+    if(parent_p->inner_p != nullptr && parent_p->index > 0) {
+      parent_p->index--;
+      NodeBaseType *node_p = MoveRightBelow(table_p->At(parent_p->inner_p->ValueAt(parent_p->index)), low_key, false);
+      const BoundKeyType &high_key = *node_p->GetHighKey();
+      if(high_key.IsInf() == false && high_key.key == low_key.key) { return node_p; }
+    }
+
+    stat_counter.Add(StatReverseDescent, 1);
+    return DescendLeft(low_key, false, parent_p);
+  }
+
+  /*
+   * DescendLeft() - Returns the leaf holding the largest key less than the bound,
+   *                 or not greater than it if inclusive, and caches its parent
+   * 
+   * An infinite bound descends to the rightmost leaf. The leaf may hold no such 
+   * key, in which case the scan continues on its left
+   */
+  NodeBaseType *DescendLeft(const BoundKeyType &bound, bool inclusive, ReverseScanParent *parent_p) {
+    NodeBaseType *node_p = table_p->At(root_id.load());
+    parent_p->Reset(nullptr, false, 0);
+    while(true) {
+      node_p = MoveRightBelow(node_p, bound, inclusive);
+      if(node_p->IsLeaf() == true) { return node_p; }
+      InnerBaseType *inner_p;
+      bool consolidated = node_p->GetType() != NodeType::InnerBase;
+      if(consolidated == true) {
+        ConsolidatorType consolidator{node_p};
+        ConsolidationTraverserType::Traverse(node_p, &consolidator);
+        inner_p = consolidator.GetNewInnerBase();
+      } else {
+        inner_p = static_cast<InnerBaseType *>(node_p);
+      }
+
+      // Child i covers [KeyAt(i), KeyAt(i + 1)), and KeyAt(0) is the low key of the node
+      NodeSizeType index = inner_p->GetSize() - 1;
+      if(bound.IsInf() == false) {
+        const KeyType *key_begin_p = &inner_p->KeyAt(0) + 1;
+        const KeyType *key_end_p = key_begin_p + index;
+        index = static_cast<NodeSizeType>((inclusive == true ? std::upper_bound(key_begin_p, key_end_p, bound.key) :
+                                                               std::lower_bound(key_begin_p, key_end_p, bound.key)) - key_begin_p);
+      }
+
+      node_p = table_p->At(inner_p->ValueAt(index));
+      parent_p->Reset(inner_p, consolidated, index);
+    }
+  }
+
+  // * MoveRightBelow() - Follows split siblings that may hold keys less than the bound, or not greater than it if inclusive
+  NodeBaseType *MoveRightBelow(NodeBaseType *node_p, const BoundKeyType &bound, bool inclusive) {
+    while(true) {
+      LeafSplitType *split_p = GetSplitDelta(node_p);
+      if(split_p == nullptr) { return node_p; }
+      const KeyType &split_key = split_p->GetSplitKey();
+      if(bound.IsInf() == false && (inclusive == true ? bound.key < split_key : (split_key < bound.key) == false)) { 
+        return node_p; 
+      }
+      node_p = table_p->At(split_p->GetSplitNodeID());
+    }
+  }
+
+  /*
+   * ScanLeaves() - Calls the callback on the logical content of each leaf in 
+   *                key order, starting from the leaf covering the start key
+   * 
+   * 1. Leaves with delta chains are consolidated into a temporary base node which
+   *    is not installed. Base nodes are passed directly
+   * 2. The next leaf is found by traversing from the root using the high key
+   * 3. The callback is of signature bool(const KeyType &start_key, LeafBaseType *)
+   *    and returns false to stop the scan
+   * 4. If a snapshot is given, every leaf is copied at the snapshot
+   */
+  template <typename Callback>
+  void ScanLeaves(const KeyType &start_key, Callback &&cb, uint64_t snapshot = DeltaVersion::LATEST, 
+                  ThreadContext *thread_p = nullptr) {
+    EpochNodeType *epoch_p = EnterEpoch();
+    Context context{thread_p};
+    KeyType key = start_key;
+    while(true) {
+      ValueSearcherType searcher{key};
+      if(Traverse(key, &context, &searcher) == false) { continue; }
+      
+      LeafBaseType *leaf_p;
+      bool consolidated = context.leaf_p->GetType() != NodeType::LeafBase;
+      if(snapshot != DeltaVersion::LATEST) {
+        leaf_p = GetLeafAtSnapshot(context.leaf_p, snapshot);
+        consolidated = true;
+      } else if(consolidated == true) {
+        ConsolidatorType consolidator{context.leaf_p};
+        ConsolidationTraverserType::Traverse(context.leaf_p, &consolidator);
+        leaf_p = consolidator.GetNewLeafBase();
+      } else {
+        leaf_p = static_cast<LeafBaseType *>(context.leaf_p);
+      }
+      
+      bool next = cb(key, leaf_p);
+      BoundKeyType high_key = *leaf_p->GetHighKey();
+      if(consolidated == true) { LeafBaseType::Destroy(leaf_p); }
+      if(next == false || high_key.IsInf()) { break; }
+      key = high_key.key;
+    }
+
+    ExitEpoch(epoch_p, thread_p);
+    return;
+  }
+
+  // * class CheckpointIndexEntry - An entry of the sparse index of a checkpoint file
+  class CheckpointIndexEntry {
+   public:
+    uint64_t offset;
+    uint64_t item_count;
+    KeyType first_key;
+  };
+
+  /*
+   * ValidateCheckpoint() - Checks the header, the index and optionally the 
+   *                        blocks of a mapped checkpoint file
+   * 
+   * First keys in the index must be strictly increasing. If blocks are checked,
+   * keys must be strictly increasing over the whole file, and the first key of 
+   * each block must match the index, such that the leaves built from the blocks
+   * form a valid tree
+   */
+  bool ValidateCheckpoint(const MappedFile &file, bool check_block) {
+    if(file.GetSize() < sizeof(CheckpointHeader)) { return false; }
+    const CheckpointHeader *header_p = reinterpret_cast<const CheckpointHeader *>(file.GetData());
+    if(header_p->magic != CheckpointHeader::MAGIC || header_p->version != CheckpointHeader::VERSION ||
+       header_p->key_size != sizeof(KeyType) || header_p->value_size != sizeof(ValueType) ||
+       header_p->index_entry_size != sizeof(CheckpointIndexEntry) || 
+       header_p->node_header_size != LeafBaseType::GetItemOffset() || header_p->file_size != file.GetSize()) {
+      return false;
+    }
+
+    uint64_t index_offset = header_p->index_offset;
+    if(index_offset < sizeof(CheckpointHeader) || index_offset > file.GetSize() || 
+       (index_offset & (CheckpointHeader::BLOCK_ALIGNMENT - 1)) != 0 ||
+       file.GetSize() - index_offset != header_p->block_count * sizeof(CheckpointIndexEntry)) {
+      return false;
+    }
+
+    const CheckpointIndexEntry *index_p = reinterpret_cast<const CheckpointIndexEntry *>(file.GetData() + index_offset);
+    const KeyType *prev_key_p = nullptr;
+    uint64_t item_count = 0;
+    for(uint64_t i = 0;i < header_p->block_count;i++) {
+      const CheckpointIndexEntry &entry = index_p[i];
+      if(entry.item_count == 0 || entry.item_count > LEAF_SIZE_THRESHOLD || entry.offset < sizeof(CheckpointHeader) ||
+         (entry.offset & (CheckpointHeader::BLOCK_ALIGNMENT - 1)) != 0 || entry.offset > index_offset ||
+         LeafBaseType::GetAllocationSize(static_cast<NodeSizeType>(entry.item_count)) > index_offset - entry.offset) {
+        return false;
+      }
+      if(i != 0 && (index_p[i - 1].first_key < entry.first_key) == false) { return false; }
+      item_count += entry.item_count;
+      if(check_block == false) { continue; }
+
+      const KeyType *key_list = reinterpret_cast<const KeyType *>(file.GetData() + entry.offset + LeafBaseType::GetItemOffset());
+      if((key_list[0] == entry.first_key) == false) { return false; }
+      for(uint64_t j = 0;j < entry.item_count;j++) {
+        if(prev_key_p != nullptr && (*prev_key_p < key_list[j]) == false) { return false; }
+        prev_key_p = &key_list[j];
+      }
+    }
+
+    return item_count == header_p->item_count;
+  }
+
+  /*
+   * LoadResident() - Maps a checkpoint at its map address and installs the node
+   *                  images as leaves
+   * 
+   * Returns false if the file cannot be used in place, without changing the tree
+   */
+  bool LoadResident(const std::string &path) {
+    // The delta chain of a node image must not have state
+    if(std::is_empty<DeltaChainType>::value == false) { return false; }
+    CheckpointHeader header{};
+    if(ReadHeader(path, &header) == false || header.map_address == 0) { return false; }
+
+    MappedFile *file_p = new MappedFile{};
+    if(file_p->Open(path, reinterpret_cast<const void *>(header.map_address)) == false || 
+       ValidateCheckpoint(*file_p, false) == false) {
+      delete file_p;
+      return false;
+    }
+
+    const CheckpointIndexEntry *index_p = \
+      reinterpret_cast<const CheckpointIndexEntry *>(file_p->GetData() + header.index_offset);
+    LeafLevel level{};
+    for(uint64_t i = 0;i < header.block_count;i++) {
+      BoundKeyType low_key = i == 0 ? BoundKeyType::GetInf() : BoundKeyType::Get(index_p[i].first_key);
+      BoundKeyType high_key = i + 1 == header.block_count ? BoundKeyType::GetInf() : BoundKeyType::Get(index_p[i + 1].first_key);
+      // Base nodes are never written after they are installed, so the read-only mapping is never written
+      NodeBaseType *leaf_p = reinterpret_cast<NodeBaseType *>(const_cast<char *>(file_p->GetData() + index_p[i].offset));
+      level.id_list.push_back(table_p->AllocateNodeID(leaf_p));
+      level.low_key_list.push_back(low_key);
+      level.high_key_list.push_back(high_key);
+    }
+
+    resident_file_p = file_p;
+    InstallLeafLevel(level);
+    table_p->ClearDirty();
+    checkpoint_id = header.checkpoint_id;
+    checkpoint_sequence = 0;
+    return true;
+  }
+
+  /*
+   * ReplayLog() - Applies log records from the start LSN on with logging disabled
+   * 
+   * Returns false if the log exists but cannot be read, or if a record does not
+   * match the key and value sizes
+   */
+  bool ReplayLog(const std::string &log_path, uint64_t start_lsn) {
+    bool ret = true;
+    bool replayed = WriteAheadLog::Replay(log_path, start_lsn, [this, &ret](uint32_t type, const char *data_p, size_t size) {
+      KeyType key;
+      ValueType value;
+      if(type == LogInsert && size == sizeof(KeyType) + sizeof(ValueType)) {
+        memcpy(&key, data_p, sizeof(KeyType));
+        memcpy(&value, data_p + sizeof(KeyType), sizeof(ValueType));
+        Insert(key, value);
+      } else if(type == LogDelete && size == sizeof(KeyType)) {
+        memcpy(&key, data_p, sizeof(KeyType));
+        Delete(key);
+      } else if(type == LogDeleteRange && size == sizeof(KeyType) * 2) {
+        KeyType high_key;
+        memcpy(&key, data_p, sizeof(KeyType));
+        memcpy(&high_key, data_p + sizeof(KeyType), sizeof(KeyType));
+        DeleteRange(key, high_key);
+      } else {
+        ret = false;
+      }
+    });
+
+    return replayed == true && ret == true;
+  }
+
+  // * ReadHeader() - Reads the header of a full or incremental checkpoint without mapping the file
+  template <typename HeaderType>
+  static bool ReadHeader(const std::string &path, HeaderType *header_p) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if(fp == nullptr) { return false; }
+    size_t read_size = fread(header_p, 1, sizeof(HeaderType), fp);
+    fclose(fp);
+    return read_size == sizeof(HeaderType) && header_p->magic == HeaderType::MAGIC && 
+           header_p->version == HeaderType::VERSION;
+  }
+
+  // * NewCheckpointID() - Returns a random non-zero ID for a full checkpoint
+  static uint64_t NewCheckpointID() {
+    std::random_device device{};
+    uint64_t id = 0;
+    while(id == 0) { id = (static_cast<uint64_t>(device()) << 32) ^ device(); }
+    return id;
+  }
+
+  // * class IncrementalIndexEntry - An entry of the index of an incremental checkpoint
+  class IncrementalIndexEntry {
+   public:
+    uint64_t offset;
+    uint64_t item_count;
+    // An infinite low key is the minimum
+    BoundKeyType low_key;
+    BoundKeyType high_key;
+  };
+
+  /*
+   * ValidateIncremental() - Checks the header, the index and the blocks of a 
+   *                         mapped incremental checkpoint
+   * 
+   * The segment must belong to the given full checkpoint and have the given 
+   * sequence number. Keys of each block must be strictly increasing and within
+   * the key range of the block
+   */
+  bool ValidateIncremental(const MappedFile &file, uint64_t base_id, uint64_t sequence) {
+    if(file.GetSize() < sizeof(IncrementalCheckpointHeader)) { return false; }
+    const IncrementalCheckpointHeader *header_p = reinterpret_cast<const IncrementalCheckpointHeader *>(file.GetData());
+    if(header_p->magic != IncrementalCheckpointHeader::MAGIC || header_p->version != IncrementalCheckpointHeader::VERSION ||
+       header_p->key_size != sizeof(KeyType) || header_p->value_size != sizeof(ValueType) ||
+       header_p->index_entry_size != sizeof(IncrementalIndexEntry) || 
+       header_p->node_header_size != LeafBaseType::GetItemOffset() || header_p->file_size != file.GetSize() ||
+       header_p->base_id != base_id || header_p->sequence != sequence) {
+      return false;
+    }
+
+    uint64_t index_offset = header_p->index_offset;
+    if(index_offset < sizeof(IncrementalCheckpointHeader) || index_offset > file.GetSize() || 
+       (index_offset & (CheckpointHeader::BLOCK_ALIGNMENT - 1)) != 0 ||
+       file.GetSize() - index_offset != header_p->block_count * sizeof(IncrementalIndexEntry)) {
+      return false;
+    }
+
+    const IncrementalIndexEntry *index_p = reinterpret_cast<const IncrementalIndexEntry *>(file.GetData() + index_offset);
+    uint64_t item_count = 0;
+    for(uint64_t i = 0;i < header_p->block_count;i++) {
+      const IncrementalIndexEntry &entry = index_p[i];
+      if(entry.offset < sizeof(IncrementalCheckpointHeader) || (entry.offset & (CheckpointHeader::BLOCK_ALIGNMENT - 1)) != 0 || 
+         entry.offset > index_offset || entry.item_count > std::numeric_limits<NodeSizeType>::max() ||
+         LeafBaseType::GetAllocationSize(static_cast<NodeSizeType>(entry.item_count)) > index_offset - entry.offset) {
+        return false;
+      }
+      if(entry.low_key.IsInf() == false && entry.high_key.IsInf() == false && (entry.low_key.key < entry.high_key.key) == false) {
+        return false;
+      }
+
+      LeafBaseType *block_p = reinterpret_cast<LeafBaseType *>(const_cast<char *>(file.GetData() + entry.offset));
+      if(block_p->GetSize() != entry.item_count) { return false; }
+      for(NodeSizeType j = 0;j < block_p->GetSize();j++) {
+        const KeyType &key = block_p->KeyAt(j);
+        if(j != 0 && (block_p->KeyAt(j - 1) < key) == false) { return false; }
+        if(entry.low_key.IsInf() == false && key < entry.low_key.key) { return false; }
+        if(entry.high_key.IsInf() == false && (key < entry.high_key.key) == false) { return false; }
+      }
+      item_count += entry.item_count;
+    }
+
+    return item_count == header_p->item_count;
+  }
+
+  /*
+   * class OverlayPiece - Items of an incremental checkpoint that replace all 
+   *                      items from the low key, which is the map key, to the
+   *                      high key
+   * 
+   * Items [begin, end) of the block are within the range
+   */
+  class OverlayPiece {
+   public:
+    BoundKeyType high_key;
+    LeafBaseType *block_p;
+    NodeSizeType begin;
+    NodeSizeType end;
+  };
+
+  // * class LowKeyLess - Orders low keys, where the infinite low key is the minimum
+  class LowKeyLess {
+   public:
+    inline bool operator()(const BoundKeyType &key1, const BoundKeyType &key2) const {
+      if(key1.IsInf() == true) { return key2.IsInf() == false; }
+      return key2.IsInf() == false && key1.key < key2.key;
+    }
+  };
+
+  using OverlayMapType = std::map<BoundKeyType, OverlayPiece, LowKeyLess>;
+
+  // * PieceLowerBound() - Returns the index of the first item of the piece not less than the key
+  static NodeSizeType PieceLowerBound(const OverlayPiece &piece, const KeyType &key) {
+    KeyType *begin_p = &piece.block_p->KeyAt(0);
+    return static_cast<NodeSizeType>(std::lower_bound(begin_p + piece.begin, begin_p + piece.end, key) - begin_p);
+  }
+
+  /*
+   * AddOverlayPiece() - Adds a piece on top of the pieces in the map
+   * 
+   * 1. A piece that contains the low key is cut at the low key. If it also 
+   *    extends beyond the high key, its part from the high key on is kept
+   * 2. Pieces that start within the range are removed, except their parts from
+   *    the high key on
+   */
+  static void AddOverlayPiece(OverlayMapType *overlay_p, const BoundKeyType &low_key, const OverlayPiece &piece) {
+    const BoundKeyType &high_key = piece.high_key;
+    typename OverlayMapType::iterator it = overlay_p->lower_bound(low_key);
+    // The infinite low key is not greater than any key, so the low key is finite if there is a previous piece
+    if(it != overlay_p->begin()) {
+      OverlayPiece &prev = std::prev(it)->second;
+      if(prev.high_key.IsInf() == true || low_key.key < prev.high_key.key) {
+        if(high_key.IsInf() == false && (prev.high_key.IsInf() == true || high_key.key < prev.high_key.key)) {
+          OverlayPiece right = prev;
+          right.begin = PieceLowerBound(prev, high_key.key);
+          overlay_p->emplace(high_key, right);
+        }
+        prev.end = PieceLowerBound(prev, low_key.key);
+        prev.high_key = low_key;
+      }
+    }
+
+    while(it != overlay_p->end() && (high_key.IsInf() == true || it->first.IsInf() == true || it->first.key < high_key.key)) {
+      OverlayPiece &next = it->second;
+      if(high_key.IsInf() == false && (next.high_key.IsInf() == true || high_key.key < next.high_key.key)) {
+        OverlayPiece right = next;
+        right.begin = PieceLowerBound(next, high_key.key);
+        overlay_p->erase(it);
+        overlay_p->emplace(high_key, right);
+        break;
+      }
+      it = overlay_p->erase(it);
+    }
+
+    overlay_p->emplace(low_key, piece);
+    return;
+  }
+
+  /*
+   * LogChange() - Appends the record of a successful insert or delete to the log
+   * 
+   * The value is only recorded for inserts. Returns the ticket to wait for
+   */
+  uint64_t LogChange(uint64_t lsn, LogRecordType type, const KeyType &key, const ValueType *value_p) {
+    char record[sizeof(KeyType) + sizeof(ValueType)];
+    memcpy(record, &key, sizeof(KeyType));
+    if(value_p != nullptr) { memcpy(record + sizeof(KeyType), value_p, sizeof(ValueType)); }
+    return log_p->Commit(lsn, type, record, value_p == nullptr ? sizeof(KeyType) : sizeof(record));
+  }
+
+  /*
+   * WaitLogDurable() - Waits until the group of a logged change is synced
+   * 
+   * The change is already visible to other threads and cannot be taken back, so
+   * a failed log that will never make it durable is a fatal error
+   */
+  void WaitLogDurable(uint64_t ticket) {
+    if(log_p->WaitDurable(ticket) == false) { err_printf("The write-ahead log failed; a visible change is not durable\n"); }
+    return;
+  }
+
+  // * LogRange() - Appends the record of a range delete on one leaf to the log
+  uint64_t LogRange(uint64_t lsn, const KeyType &low_key, const KeyType &high_key) {
+    char record[sizeof(KeyType) * 2];
+    memcpy(record, &low_key, sizeof(KeyType));
+    memcpy(record + sizeof(KeyType), &high_key, sizeof(KeyType));
+    return log_p->Commit(lsn, LogDeleteRange, record, sizeof(record));
+  }
+
+  // * CountRange() - Returns the number of keys in [low key, high key) on a leaf delta chain
+  NodeSizeType CountRange(NodeBaseType *node_p, const KeyType &low_key, const KeyType &high_key) {
+    LeafBaseType *base_p;
+    bool consolidated = node_p->GetType() != NodeType::LeafBase;
+    if(consolidated == true) {
+      ConsolidatorType consolidator{node_p};
+      ConsolidationTraverserType::Traverse(node_p, &consolidator);
+      base_p = consolidator.GetNewLeafBase();
+    } else {
+      base_p = static_cast<LeafBaseType *>(node_p);
+    }
+
+    NodeSizeType count = 0;
+    for(NodeSizeType i = FindLowerBound(base_p, low_key);i < base_p->GetSize() && base_p->KeyAt(i) < high_key;i++) { count++; }
+    if(consolidated == true) { LeafBaseType::Destroy(base_p); }
+    return count;
+  }
+
+  // * class LeafLevel - Node IDs and key ranges of leaves to be installed by bulk load
+  class LeafLevel {
+   public:
+    std::vector<NodeIDType> id_list;
+    std::vector<BoundKeyType> low_key_list;
+    std::vector<BoundKeyType> high_key_list;
+  };
+
+  // * AddLeaf() - Allocates a node ID for a leaf built on the heap and appends it to the level
+  void AddLeaf(LeafLevel *level_p, LeafBaseType *leaf_p, const BoundKeyType &low_key, const BoundKeyType &high_key) {
+    level_p->id_list.push_back(table_p->AllocateNodeID(leaf_p));
+    level_p->low_key_list.push_back(low_key);
+    level_p->high_key_list.push_back(high_key);
+    memory_counter.Add(MemoryBaseNode, leaf_p->GetMemorySize());
+    return;
+  }
+
+  // * AssertInitialState() - Checks that the tree is in the state left by the constructor
+  void AssertInitialState() {
+    NodeBaseType *root_p = table_p->At(root_id.load());
+    always_assert(root_p->GetType() == NodeType::InnerBase && root_p->GetSize() == 1);
+    NodeBaseType *leaf_p = table_p->At(static_cast<InnerBaseType *>(root_p)->ValueAt(0));
+    always_assert(leaf_p->GetType() == NodeType::LeafBase && leaf_p->GetSize() == 0);
+    return;
+  }
+
+  /*
+   * InstallLeafLevel() - Builds inner levels over leaves in key order, and 
+   *                      replaces the empty tree with them
+   * 
+   * 1. The separator of each child is its low key. An inner node covers the range
+   *    from the low key of its first child to the high key of its last child
+   * 2. At least one inner level is built, since the root is always an inner node
+   * 3. The tree must be in the state left by the constructor. The initial leaf 
+   *    and root are retired and their node IDs are released
+   */
+  void InstallLeafLevel(LeafLevel level) {
+    if(level.id_list.empty() == true) { return; }
+    NodeIDType old_root_id = root_id.load();
+    NodeBaseType *old_root_p = table_p->At(old_root_id);
+    NodeIDType old_leaf_id = static_cast<InnerBaseType *>(old_root_p)->ValueAt(0);
+    NodeBaseType *old_leaf_p = table_p->At(old_leaf_id);
+
+    // Node IDs and key ranges of nodes on the level being built
+    std::vector<NodeIDType> &id_list = level.id_list;
+    std::vector<BoundKeyType> &low_key_list = level.low_key_list;
+    std::vector<BoundKeyType> &high_key_list = level.high_key_list;
+    do {
+      std::vector<NodeIDType> parent_id_list{};
+      std::vector<BoundKeyType> parent_low_key_list{};
+      std::vector<BoundKeyType> parent_high_key_list{};
+      for(size_t start = 0;start < id_list.size();start += BULK_LOAD_INNER_SIZE) {
+        size_t end = std::min(start + size_t{BULK_LOAD_INNER_SIZE}, id_list.size());
+        InnerBaseType *inner_p = InnerBaseType::Get(NodeType::InnerBase, static_cast<NodeSizeType>(end - start), 
+                                                    low_key_list[start], high_key_list[end - 1]);
+        for(size_t i = start;i < end;i++) {
+          // The first key is the low key of the node, which is not used by search
+          if(low_key_list[i].IsInf() == false) { inner_p->KeyAt(static_cast<int>(i - start)) = low_key_list[i].key; }
+          inner_p->ValueAt(static_cast<int>(i - start)) = id_list[i];
+        }
+        parent_id_list.push_back(table_p->AllocateNodeID(inner_p));
+        parent_low_key_list.push_back(low_key_list[start]);
+        parent_high_key_list.push_back(high_key_list[end - 1]);
+        memory_counter.Add(MemoryBaseNode, inner_p->GetMemorySize());
+      }
+
+      id_list.swap(parent_id_list);
+      low_key_list.swap(parent_low_key_list);
+      high_key_list.swap(parent_high_key_list);
+    } while(id_list.size() > 1);
+
+    root_id.store(id_list[0]);
+    RetireDeltaChain(old_root_p);
+    RetireDeltaChain(old_leaf_p);
+    table_p->ReleaseNodeID(old_root_id);
+    table_p->ReleaseNodeID(old_leaf_id);
+    return;
+  }
+
+  /*
+   * ScanLeavesFuzzy() - Calls the callback on the items of all leaves in key 
+   *                     order, walking the mapping table while writers continue
+   * 
+   * 1. The first pass reads the low key of every leaf slot, a batch of slots per
+   *    epoch, and sorts the leaves by low key. Low keys of leaves never change
+   * 2. The second pass keeps a cursor, which is the high key of the last leaf.
+   *    The leaf whose low key equals the cursor is captured next: its chain head
+   *    is pinned in an epoch of its own, its items from the cursor on are copied
+   *    out, and the epoch is left before the callback is called. Leaves whose 
+   *    low keys are below the cursor are covered already
+   * 3. A split sibling is in the mapping table before its split delta is 
+   *    installed, and stays there if the CAS fails until it is released. It is
+   *    then retired through the epoch manager, so a slot read within an epoch 
+   *    is never freed memory. A leaf is only used if it is proven to be in the
+   *    tree: it has deltas, it is the sibling in the split delta of the last 
+   *    leaf, or the cached parent maps the cursor to it. Otherwise, and for 
+   *    leaves created after the first pass, the slot is skipped and the leaf is
+   *    found by a traversal, which also refreshes the parent
+   * 4. The callback is of signature void(const KeyValuePairType *, size_t), and
+   *    is called with the items of each non-empty leaf. No operation is blocked,
+   *    and each leaf is a consistent snapshot of its delta chain
+   */
+  template <typename Callback>
+  void ScanLeavesFuzzy(Callback &&cb) {
+    std::vector<std::pair<BoundKeyType, NodeIDType>> leaf_list{};
+    NodeIDType slot_count = table_p->GetNextSlot();
+    for(NodeIDType begin = MappingTableType::FIRST_NODE_ID;begin < slot_count;begin += FUZZY_SCAN_BATCH_SIZE) {
+      EpochNodeType *epoch_p = EnterEpoch();
+      for(NodeIDType node_id = begin;node_id < std::min<NodeIDType>(begin + FUZZY_SCAN_BATCH_SIZE, slot_count);node_id++) {
+        NodeBaseType *node_p = table_p->At(node_id);
+        if(node_p != nullptr && node_p->IsLeaf() == true) { leaf_list.emplace_back(*node_p->GetLowKey(), node_id); }
+      }
+      ExitEpoch(epoch_p);
+    }
+    LowKeyLess less{};
+    std::sort(leaf_list.begin(), leaf_list.end(), 
+              [&less](const std::pair<BoundKeyType, NodeIDType> &p1, const std::pair<BoundKeyType, NodeIDType> &p2) {
+      return less(p1.first, p2.first);
+    });
+
+    std::vector<KeyValuePairType> item_list{};
+    // The infinite cursor is the minimum before the first leaf
+    BoundKeyType cursor = BoundKeyType::GetInf();
+    NodeIDType parent_id = MappingTableType::INVALID_NODE_ID;
+    NodeIDType sibling_id = MappingTableType::INVALID_NODE_ID;
+    size_t index = 0;
+    while(true) {
+      EpochNodeType *epoch_p = EnterEpoch();
+      NodeBaseType *leaf_p = nullptr;
+      while(index < leaf_list.size() && less(leaf_list[index].first, cursor) == true) { index++; }
+      for(;index < leaf_list.size() && less(cursor, leaf_list[index].first) == false;index++) {
+        NodeIDType node_id = leaf_list[index].second;
+        NodeBaseType *node_p = table_p->At(node_id);
+        if(node_p != nullptr && IsLeafInTree(node_id, node_p, cursor, parent_id, sibling_id) == true) { 
+          leaf_p = node_p;
+          break;
+        }
+      }
+
+      if(leaf_p == nullptr) {
+        Context context{};
+        if(cursor.IsInf() == true) {
+          std::vector<NodeIDType> child_list{};
+          leaf_p = table_p->At(root_id.load());
+          while(leaf_p->IsLeaf() == false) {
+            child_list.clear();
+            GetChildren(leaf_p, &child_list);
+            leaf_p = table_p->At(child_list[0]);
+          }
+        } else {
+          ValueSearcherType searcher{cursor.key};
+          while(Traverse(cursor.key, &context, &searcher) == false) {}
+          leaf_p = context.leaf_p;
+          parent_id = context.path[context.depth - 2];
+        }
+      }
+
+      LeafBaseType *base_p;
+      bool consolidated = leaf_p->GetType() != NodeType::LeafBase;
+      if(consolidated == true) {
+        ConsolidatorType consolidator{leaf_p};
+        ConsolidationTraverserType::Traverse(leaf_p, &consolidator);
+        base_p = consolidator.GetNewLeafBase();
+      } else {
+        base_p = static_cast<LeafBaseType *>(leaf_p);
+      }
+
+      for(NodeSizeType i = cursor.IsInf() ? 0 : FindLowerBound(base_p, cursor.key);i < base_p->GetSize();i++) {
+        item_list.emplace_back(base_p->KeyAt(i), base_p->ValueAt(i));
+      }
+      LeafSplitType *split_p = GetSplitDelta(leaf_p);
+      sibling_id = split_p == nullptr ? MappingTableType::INVALID_NODE_ID : split_p->GetSplitNodeID();
+      BoundKeyType high_key = *base_p->GetHighKey();
+      if(consolidated == true) { LeafBaseType::Destroy(base_p); }
+      ExitEpoch(epoch_p);
+
+      if(item_list.empty() == false) { cb(item_list.data(), item_list.size()); }
+      item_list.clear();
+      if(high_key.IsInf() == true) { break; }
+      cursor = high_key;
+    }
+
+    return;
+  }
+
+  /*
+   * IsLeafInTree() - Returns whether a leaf whose low key equals the cursor is
+   *                  proven to be in the tree, rather than a split sibling 
+   *                  whose CAS failed
+   * 
+   * Must be called within an epoch. A leaf with deltas has been reached by a
+   * traversal, and the leftmost leaf is never a split sibling
+   */
+  bool IsLeafInTree(NodeIDType node_id, NodeBaseType *node_p, const BoundKeyType &cursor, 
+                    NodeIDType parent_id, NodeIDType sibling_id) {
+    if(cursor.IsInf() == true || node_p->GetType() != NodeType::LeafBase || node_id == sibling_id) { return true; }
+    if(parent_id == MappingTableType::INVALID_NODE_ID) { return false; }
+    ValueSearcherType searcher{cursor.key};
+    ValueSearchTraverserType::Traverse(table_p->At(parent_id), &searcher);
+    return searcher.IsAborted() == false && searcher.GoRight() == false && searcher.GetNextID() == node_id;
+  }
+
+  /*
+   * FindReachableLeaf() - Returns the leaf in the tree that covers the low key of
+   *                       the leaf in a mapping table slot, and stores its ID
+   * 
+   * 1. A leaf in the tree is reached by a traversal to its low key, since low 
+   *    keys never change. A split sibling whose CAS has not happened yet or has
+   *    failed is not, and the leaf reached holds the items of its range instead
+   * 2. Returns nullptr if the slot is empty or holds an inner node. Must be 
+   *    called within an epoch
+   */
+  NodeBaseType *FindReachableLeaf(NodeIDType node_id, NodeIDType *leaf_id_p) {
+    NodeBaseType *node_p = table_p->At(node_id);
+    if(node_p == nullptr || node_p->IsLeaf() == false) { return nullptr; }
+    *leaf_id_p = node_id;
+    // Only the leftmost leaf has an infinite low key, and it is never a split sibling
+    const BoundKeyType &low_key = *node_p->GetLowKey();
+    if(low_key.IsInf() == true) { return node_p; }
+    Context context{};
+    ValueSearcherType searcher{low_key.key};
+    while(Traverse(low_key.key, &context, &searcher) == false) {}
+    *leaf_id_p = context.path[context.depth - 1];
+    return context.leaf_p;
+  }
+
+  /*
+   * Traverse() - Finds the leaf node that covers the key
+   * 
+   * 1. The path from the root is recorded in the context, and the last element
+   *    is the leaf node ID
+   * 2. Unfinished splits on the path are completed before the traversal continues
+   * 3. The searcher is reset and then used on each level. After traversal it 
+   *    holds the search result on the leaf level
+   * 4. Returns false if the traversal should be restarted from the root
+   */
+  bool Traverse(const KeyType &key, Context *context_p, ValueSearcherType *searcher_p) {
+    context_p->depth = 0;
+    NodeIDType node_id = root_id.load();
+    while(true) {
+      NodeBaseType *node_p = table_p->At(node_id);
+      if(FinishSplit(context_p, context_p->depth, node_id, node_p) == false) { 
+        stat_counter.Add(StatTraverseRestart, 1, context_p->thread_index);
+        return false; 
+      }
+
+      *searcher_p = ValueSearcherType{key};
+      ValueSearchTraverserType::Traverse(node_p, searcher_p);
+      if(searcher_p->IsAborted()) { 
+        stat_counter.Add(StatTraverseRestart, 1, context_p->thread_index);
+        return false; 
+      } else if(searcher_p->GoRight()) { 
+        node_id = searcher_p->GetNextID(); 
+        continue; 
+      }
+
+      assert(context_p->depth < MAX_DEPTH);
+      context_p->path[context_p->depth++] = node_id;
+      if(node_p->IsLeaf()) {
+        context_p->leaf_p = node_p;
+        return true;
+      }
+
+      node_id = searcher_p->GetNextID();
+    }
+
+    return false;
+  }
+
+  /*
+   * GetSplitDelta() - Returns the split delta on the chain, or nullptr if not split
+   * 
+   * The high key of a delta chain points into the split delta if the node has been
+   * split. Otherwise it points to the high key of the base node
+   */
+  LeafSplitType *GetSplitDelta(NodeBaseType *node_p) {
+    BoundKeyType *high_key_p = node_p->GetHighKey();
+    if(high_key_p == node_p->template GetBase<DeltaChainType>()->GetHighKey()) { return nullptr; }
+    LeafSplitType *split_p = reinterpret_cast<LeafSplitType *>(
+      reinterpret_cast<char *>(high_key_p) - LeafSplitType::T1_OFFSET);
+    assert(split_p->GetType() == NodeType::LeafSplit || split_p->GetType() == NodeType::InnerSplit);
+    return split_p;
+  }
+
+  /*
+   * FinishSplit() - Inserts the separator of an unfinished split into the parent
+   * 
+   * 1. level is the number of ancestors of the node, i.e. the parent is recorded
+   *    at level - 1 of the context
+   * 2. If the node is the root, a new root is installed and the caller restarts
+   * 3. The sibling covers [split key, high key before split) in the parent
+   * 4. Returns true if there is no unfinished split; false if the caller should restart
+   */
+  bool FinishSplit(Context *context_p, size_t level, NodeIDType node_id, NodeBaseType *node_p) {
+    LeafSplitType *split_p = GetSplitDelta(node_p);
+    if(split_p == nullptr) { return true; }
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyFinishSplit);)
+    const KeyType &split_key = split_p->GetSplitKey();
+    NodeIDType sibling_id = split_p->GetSplitNodeID();
+    const BoundKeyType &next_key = *split_p->GetNext()->GetHighKey();
+
+    if(level == 0) {
+      if(root_id.load() != node_id) { return false; }
+      InnerBaseType *new_root_p = \
+        InnerBaseType::Get(NodeType::InnerBase, 2, BoundKeyType::GetInf(), BoundKeyType::GetInf());
+      new_root_p->ValueAt(0) = node_id;
+      new_root_p->KeyAt(1) = split_key;
+      new_root_p->ValueAt(1) = sibling_id;
+      NodeIDType new_root_id = table_p->AllocateNodeID(new_root_p, context_p->thread_index);
+      if(root_id.compare_exchange_strong(node_id, new_root_id) == false) {
+        stat_counter.Add(StatSplitCASFailure, 1, context_p->thread_index);
+        RetireUnpublishedNode(new_root_id, new_root_p, context_p->thread_index);
+      } else {
+        memory_counter.Add(MemoryBaseNode, new_root_p->GetMemorySize(), context_p->thread_index);
+      }
+      // Restart such that the new root is on the path
+      return false;
+    }
+
+    NodeIDType parent_id = context_p->path[level - 1];
+    while(true) {
+      NodeBaseType *parent_p = table_p->At(parent_id);
+      // If the parent has split at or before the split key, the separator must
+      // have been inserted before the parent split, and moved to its sibling
+      if(parent_p->KeyLargerThanNode(split_key)) { return true; }
+
+      ValueSearcherType searcher{split_key};
+      ValueSearchTraverserType::Traverse(parent_p, &searcher);
+      if(searcher.IsAborted()) {
+        return false;
+      } else if(searcher.GetNextID() == sibling_id) {
+        return true;
+      } else if(searcher.GetNextID() != node_id) {
+        return false;
+      }
+
+      if(parent_p->GetHeight() >= INNER_HEIGHT_THRESHOLD) {
+        if(ConsolidateNode(context_p, level - 1, parent_id, parent_p) == false) { return false; }
+        continue;
+      }
+
+      AppendHelperType ah{parent_id, parent_p, table_p};
+      InnerInsertType *delta_p = ah.AppendInnerInsert(split_key, sibling_id, next_key);
+      if(delta_p == nullptr) {
+        memory_counter.Add(MemoryDelta, sizeof(InnerInsertType), context_p->thread_index);
+        if(ah.GetNode()->GetHeight() >= INNER_HEIGHT_THRESHOLD) {
+          ConsolidateNode(context_p, level - 1, parent_id, ah.GetNode());
+        }
+
+        return true;
+      }
+
+      ah.DestroyDelta(delta_p);
+      stat_counter.Add(StatAppendCASFailure, 1, context_p->thread_index);
+    }
+
+    return false;
+  }
+
+  /*
+   * GetRangeKeys() - Returns the sorted keys in [low, high) that may exist in a 
+   *                  leaf delta chain, i.e. inserted keys and base node keys
+   */
+  static std::vector<KeyType> GetRangeKeys(NodeBaseType *node_p, const KeyType &low_key, const KeyType &high_key) {
+    std::vector<KeyType> key_list{};
+    while(node_p->GetType() != NodeType::LeafBase) {
+      switch(node_p->GetType()) {
+        case NodeType::LeafInsert: {
+          LeafInsertType *insert_p = static_cast<LeafInsertType *>(node_p);
+          if(low_key <= insert_p->GetInsertKey() && insert_p->GetInsertKey() < high_key) { 
+            key_list.push_back(insert_p->GetInsertKey()); 
+          }
+          node_p = insert_p->GetNext();
+          break;
+        }
+        case NodeType::LeafDelete: node_p = static_cast<LeafDeleteType *>(node_p)->GetNext(); break;
+        case NodeType::LeafRangeDelete: node_p = static_cast<LeafRangeDeleteType *>(node_p)->GetNext(); break;
+        case NodeType::LeafSplit: node_p = static_cast<LeafSplitType *>(node_p)->GetNext(); break;
+        default:
+          assert(false && "Unexpected node type on a leaf delta chain");
+          return key_list;
+      }
+    }
+
+    LeafBaseType *base_p = static_cast<LeafBaseType *>(node_p);
+    for(NodeSizeType i = FindLowerBound(base_p, low_key);i < base_p->GetSize() && base_p->KeyAt(i) < high_key;i++) {
+      key_list.push_back(base_p->KeyAt(i));
+    }
+    std::sort(key_list.begin(), key_list.end());
+    key_list.erase(std::unique(key_list.begin(), key_list.end()), key_list.end());
+    return key_list;
+  }
+
+  /*
+   * ForEachLeafChange() - Calls the callback on insert and delete deltas of a leaf
+   *                       delta chain from the top, and returns the base node
+   * 
+   * The callback is of signature 
+   * void(const KeyType &, const ValueType &, DeltaVersion *, bool exists)
+   * 
+   * A range delete delta is reported as a delete of every key in the range that
+   * may exist below it
+   */
+  template <typename Callback>
+  static LeafBaseType *ForEachLeafChange(NodeBaseType *node_p, Callback &&cb) {
+    while(true) {
+      switch(node_p->GetType()) {
+        case NodeType::LeafInsert: {
+          LeafInsertType *insert_p = static_cast<LeafInsertType *>(node_p);
+          cb(insert_p->GetInsertKey(), insert_p->GetInsertValue(), &insert_p->GetVersion(), true);
+          node_p = insert_p->GetNext();
+          break;
+        }
+        case NodeType::LeafDelete: {
+          LeafDeleteType *delete_p = static_cast<LeafDeleteType *>(node_p);
+          cb(delete_p->GetDeleteKey(), delete_p->GetDeleteValue(), &delete_p->GetVersion(), false);
+          node_p = delete_p->GetNext();
+          break;
+        }
+        case NodeType::LeafRangeDelete: {
+          LeafRangeDeleteType *range_p = static_cast<LeafRangeDeleteType *>(node_p);
+          for(const KeyType &key : GetRangeKeys(range_p->GetNext(), range_p->GetRangeLowKey(), range_p->GetRangeHighKey())) {
+            cb(key, ValueType{}, &range_p->GetVersion(), false);
+          }
+          node_p = range_p->GetNext();
+          break;
+        }
+        case NodeType::LeafSplit:
+          node_p = static_cast<LeafSplitType *>(node_p)->GetNext();
+          break;
+        case NodeType::LeafBase:
+          return static_cast<LeafBaseType *>(node_p);
+        default:
+          // Leaves are never merged or removed
+          assert(false && "Unexpected node type on a leaf delta chain");
+          return nullptr;
+      }
+    }
+  }
+
+  // * ResolveVersions() - Sets the versions of pending deltas on a leaf delta chain
+  void ResolveVersions(NodeBaseType *node_p) {
+    ForEachLeafChange(node_p, [this](const KeyType &, const ValueType &, DeltaVersion *version_p, bool) {
+      version_p->Resolve(version_clock);
+    });
+    return;
+  }
+
+  /*
+   * GetLeafAtSnapshot() - Returns a new leaf base node holding the content of a
+   *                       leaf delta chain at the snapshot
+   * 
+   * The newest change of a key visible to the snapshot decides its state. Keys
+   * without such a change are read from the base node at the snapshot. The caller
+   * destroys the node
+   */
+  LeafBaseType *GetLeafAtSnapshot(NodeBaseType *node_p, uint64_t snapshot) {
+    using VersionType = typename LeafBaseType::Version;
+    const BoundKeyType &high_key = *node_p->GetHighKey();
+    std::vector<VersionType> change_list{};
+    LeafBaseType *base_p = ForEachLeafChange(node_p, 
+      [this, snapshot, &high_key, &change_list](const KeyType &key, const ValueType &value, DeltaVersion *version_p, bool exists) {
+        if(version_p->Resolve(version_clock) > snapshot || (high_key.IsInf() == false && key >= high_key.key)) { return; }
+        for(const VersionType &change : change_list) { if(change.key == key) { return; } }
+        change_list.push_back(VersionType{key, value, version_p->Get(), exists});
+      });
+
+    std::sort(change_list.begin(), change_list.end(), 
+              [](const VersionType &a, const VersionType &b) { return a.key < b.key; });
+    std::vector<KeyValuePairType> base_list{};
+    base_p->CopyAtSnapshot(snapshot, high_key, &base_list);
+    std::vector<KeyValuePairType> item_list{};
+    size_t base_index = 0;
+    for(const VersionType &change : change_list) {
+      while(base_index < base_list.size() && base_list[base_index].first < change.key) {
+        item_list.push_back(base_list[base_index++]);
+      }
+      if(base_index < base_list.size() && base_list[base_index].first == change.key) { base_index++; }
+      if(change.exists == true) { item_list.emplace_back(change.key, change.value); }
+    }
+    item_list.insert(item_list.end(), base_list.begin() + base_index, base_list.end());
+
+    LeafBaseType *leaf_p = LeafBaseType::Get(NodeType::LeafBase, item_list.size(), *node_p->GetLowKey(), high_key);
+    for(size_t i = 0;i < item_list.size();i++) {
+      leaf_p->KeyAt(i) = item_list[i].first;
+      leaf_p->ValueAt(i) = item_list[i].second;
+    }
+
+    return leaf_p;
+  }
+
+  /*
+   * BuildVersionList() - Returns the versions to be kept by the consolidated base
+   *                      node of a leaf delta chain, or nullptr if none is needed
+   * 
+   * 1. Changes on the chain are appended to the versions of the key in the old
+   *    base node, or to the state of the key in the old base node if it has no 
+   *    versions of the key
+   * 2. For each key, the versions before the first one newer than the watermark 
+   *    are replaced by the state they lead to. A key whose versions are all 
+   *    visible to every active snapshot keeps no version
+   * 3. Versions on the chain must have been resolved
+   */
+  typename LeafBaseType::VersionListType *BuildVersionList(NodeBaseType *node_p, uint64_t watermark) {
+    using VersionType = typename LeafBaseType::Version;
+    using VersionListType = typename LeafBaseType::VersionListType;
+    const BoundKeyType &high_key = *node_p->GetHighKey();
+    std::vector<VersionType> change_list{};
+    LeafBaseType *base_p = ForEachLeafChange(node_p, 
+      [&high_key, &change_list](const KeyType &key, const ValueType &value, DeltaVersion *version_p, bool exists) {
+        if(high_key.IsInf() || key < high_key.key) { change_list.push_back(VersionType{key, value, version_p->Get(), exists}); }
+      });
+
+    // Changes are collected from the top of the chain. The stable sort keeps 
+    // changes of the same key in the order they were made
+    std::reverse(change_list.begin(), change_list.end());
+    std::stable_sort(change_list.begin(), change_list.end(), 
+                     [](const VersionType &a, const VersionType &b) { return a.key < b.key; });
+    const VersionListType *old_list_p = base_p->GetVersionList();
+    size_t old_num = old_list_p == nullptr ? 0 : old_list_p->size();
+    size_t old_index = 0;
+    size_t change_index = 0;
+    VersionListType *version_list_p = new VersionListType{};
+    std::vector<VersionType> key_version_list{};
+    while(true) {
+      bool change_end = change_index == change_list.size();
+      bool old_end = old_index == old_num || 
+        (high_key.IsInf() == false && (*old_list_p)[old_index].key >= high_key.key);
+      if(change_end && old_end) { break; }
+      const KeyType key = (old_end || (change_end == false && change_list[change_index].key < (*old_list_p)[old_index].key)) ?
+        change_list[change_index].key : (*old_list_p)[old_index].key;
+      
+      key_version_list.clear();
+      if(old_end == false && (*old_list_p)[old_index].key == key) {
+        while(old_index < old_num && (*old_list_p)[old_index].key == key) { key_version_list.push_back((*old_list_p)[old_index++]); }
+      } else {
+        int index = base_p->GetSize() == 0 ? -1 : base_p->PointSearch(key);
+        key_version_list.push_back(VersionType{key, index >= 0 ? base_p->ValueAt(index) : ValueType{}, 0, index >= 0});
+      }
+      while(change_index < change_list.size() && change_list[change_index].key == key) { 
+        key_version_list.push_back(change_list[change_index++]); 
+      }
+
+      size_t first = 1;
+      while(first < key_version_list.size() && key_version_list[first].version <= watermark) { first++; }
+      if(first == key_version_list.size()) { continue; }
+      version_list_p->push_back(key_version_list[first - 1]);
+      version_list_p->back().version = 0;
+      version_list_p->insert(version_list_p->end(), key_version_list.begin() + first, key_version_list.end());
+    }
+
+    if(version_list_p->empty() == true) {
+      delete version_list_p;
+      return nullptr;
+    }
+
+    return version_list_p;
+  }
+
+  /*
+   * ConsolidateNode() - Replaces the delta chain with a new base node
+   * 
+   * 1. The unfinished split on the chain is completed first, because the
+   *    sibling would become unreachable after the split delta is gone
+   * 2. The old chain is handed to the epoch manager if the CAS succeeds
+   * 3. The new base node is split if the size reaches the threshold
+   * 4. Returns false if the caller should restart from the root
+   * 5. A new leaf base node keeps versions if there is an active snapshot
+   * 6. If a garbage list is given, the old chain is appended to it instead, and
+   *    the caller retires the list with RetireDeltaChainList()
+   */
+  bool ConsolidateNode(Context *context_p, size_t level, NodeIDType node_id, NodeBaseType *node_p,
+                       std::vector<NodeBaseType *> *garbage_list_p = nullptr) {
+    if(FinishSplit(context_p, level, node_id, node_p) == false) { return false; }
+
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencyConsolidate);)
+    ConsolidatorType consolidator{node_p};
+    ConsolidationTraverserType::Traverse(node_p, &consolidator);
+    bool split;
+    if(node_p->IsLeaf()) {
+      LeafBaseType *new_base_p = consolidator.GetNewLeafBase();
+      ResolveVersions(node_p);
+      // Loaded after versions are resolved, see CreateSnapshot()
+      uint64_t watermark = min_snapshot.load();
+      if(watermark != DeltaVersion::LATEST) { new_base_p->SetVersionList(BuildVersionList(node_p, watermark)); }
+      if(table_p->CAS(node_id, node_p, new_base_p) == false) {
+        stat_counter.Add(StatConsolidateCASFailure, 1, context_p->thread_index);
+        LeafBaseType::Destroy(new_base_p);
+        return true;
+      }
+      
+      stat_counter.Add(StatConsolidationBytes, new_base_p->GetAllocationSize(), context_p->thread_index);
+      memory_counter.Add(MemoryBaseNode, new_base_p->GetMemorySize(), context_p->thread_index);
+      split = new_base_p->GetSize() >= LEAF_SIZE_THRESHOLD && SplitNode(context_p, level, node_id, new_base_p);
+    } else {
+      InnerBaseType *new_base_p = consolidator.GetNewInnerBase();
+      if(table_p->CAS(node_id, node_p, new_base_p) == false) {
+        stat_counter.Add(StatConsolidateCASFailure, 1, context_p->thread_index);
+        InnerBaseType::Destroy(new_base_p);
+        return true;
+      }
+      
+      stat_counter.Add(StatConsolidationBytes, new_base_p->GetAllocationSize(), context_p->thread_index);
+      memory_counter.Add(MemoryBaseNode, new_base_p->GetMemorySize(), context_p->thread_index);
+      split = new_base_p->GetSize() >= INNER_SIZE_THRESHOLD && SplitNode(context_p, level, node_id, new_base_p);
+    }
+
+    stat_counter.Add(StatConsolidation, 1, context_p->thread_index);
+    if(garbage_list_p != nullptr) { garbage_list_p->push_back(node_p); }
+    else { RetireDeltaChain(node_p, context_p->thread_index); }
+    if(split == true) { FinishSplit(context_p, level, node_id, table_p->At(node_id)); }
+    return true;
+  }
+
+  /*
+   * SplitNode() - Posts a split delta on a base node that has just been installed
+   * 
+   * The upper half is copied into a new sibling node. If RTM is enabled, the split
+   * delta and the separator in the parent are first tried in one transaction, see
+   * PostSplitHTM(). Returns false if the CAS fails, in which case the sibling and 
+   * its node ID are retired
+   */
+  template <typename BaseNodeType>
+  bool SplitNode(Context *context_p, size_t level, NodeIDType node_id, BaseNodeType *node_p) {
+    IF_LATENCY(typename LatencyRecorderType::Scope latency_scope(&latency_recorder, LatencySplit);)
+    BaseNodeType *sibling_p = node_p->Split();
+    NodeIDType sibling_id = table_p->AllocateNodeID(sibling_p, context_p->thread_index);
+    AppendHelperType ah{node_id, node_p, table_p};
+    LeafSplitType *delta_p = node_p->IsLeaf() ? 
+      ah.PrepareLeafSplit(sibling_p->KeyAt(0), sibling_id, sibling_p->GetSize()) :
+      ah.PrepareInnerSplit(sibling_p->KeyAt(0), sibling_id, sibling_p->GetSize());
+    if((htm_enabled == true && PostSplitHTM(context_p, level, node_id, node_p, delta_p) == true) || 
+       ah.Install(delta_p) == nullptr) { 
+      stat_counter.Add(StatSplit, 1, context_p->thread_index);
+      memory_counter.Add(MemoryBaseNode, sibling_p->GetMemorySize(), context_p->thread_index);
+      memory_counter.Add(MemoryDelta, sizeof(LeafSplitType), context_p->thread_index);
+      return true; 
+    }
+
+    stat_counter.Add(StatSplitCASFailure, 1, context_p->thread_index);
+    ah.DestroyDelta(delta_p);
+    RetireUnpublishedNode(sibling_id, sibling_p, context_p->thread_index);
+    return false;
+  }
+
+  /*
+   * RetireUnpublishedNode() - Releases the node ID of a node whose CAS failed, and
+   *                           hands the node to the epoch manager
+   * 
+   * Threads that walk the mapping table, such as checkpoints, may have read the
+   * slot before it is released, so the node is only freed after their epochs
+   */
+  template <typename BaseNodeType>
+  void RetireUnpublishedNode(NodeIDType node_id, BaseNodeType *node_p, size_t thread_index) {
+    table_p->ReleaseNodeID(node_id);
+    // The node was never counted as live, and is counted here such that retiring it balances
+    memory_counter.Add(MemoryBaseNode, node_p->GetMemorySize(), thread_index);
+    RetireDeltaChain(node_p, thread_index);
+    return;
+  }
+
+  /*
+   * PostSplitHTM() - Installs the split delta and the separator in the parent in one
+   *                  RTM transaction
+   * 
+   * 1. No thread observes the split without its separator, so no thread needs
+   *    to help along
+   * 2. Only tried if the parent on the path still routes the split key to the node
+   *    and is not due for consolidation. Root splits always take the CAS path
+   * 3. Returns false if the transaction is not committed. The split delta is not 
+   *    installed and the caller falls back to the multi-step protocol
+   */
+  bool PostSplitHTM(Context *context_p, size_t level, NodeIDType node_id, 
+                    NodeBaseType *node_p, LeafSplitType *delta_p) {
+    if(level == 0) { return false; }
+    NodeIDType parent_id = context_p->path[level - 1];
+    NodeBaseType *parent_p = table_p->At(parent_id);
+    const KeyType &split_key = delta_p->GetSplitKey();
+    if(parent_p->KeyInNode(split_key) == false || parent_p->GetHeight() >= INNER_HEIGHT_THRESHOLD) { return false; }
+    ValueSearcherType searcher{split_key};
+    ValueSearchTraverserType::Traverse(parent_p, &searcher);
+    if(searcher.IsAborted() || searcher.GoRight() || searcher.GetNextID() != node_id) { return false; }
+
+    AppendHelperType parent_ah{parent_id, parent_p, table_p};
+    InnerInsertType *insert_p = parent_ah.PrepareInnerInsert(split_key, delta_p->GetSplitNodeID(), *node_p->GetHighKey());
+    NodeIDType id_list[2] = {node_id, parent_id};
+    NodeBaseType *old_list[2] = {node_p, parent_p};
+    NodeBaseType *new_list[2] = {delta_p, insert_p};
+    if(table_p->CASMulti(2, id_list, old_list, new_list) == false) {
+      parent_ah.DestroyDelta(insert_p);
+      return false;
+    }
+
+    stat_counter.Add(StatSplitHTM, 1, context_p->thread_index);
+    memory_counter.Add(MemoryDelta, sizeof(InnerInsertType), context_p->thread_index);
+    return true;
+  }
+
+  MappingTableType *table_p;
+  std::atomic<NodeIDType> root_id;
+  EpochManagerType *epoch_manager_p;
+  // Checkpoint file whose leaves are used in place, or nullptr
+  MappedFile *resident_file_p;
+  // Write-ahead log of inserts and deletes, or nullptr
+  WriteAheadLog *log_p;
+  // ID of the full checkpoint taken or loaded last, or 0, and the number of segments on top of it
+  uint64_t checkpoint_id;
+  uint64_t checkpoint_sequence;
+  // Versions of leaf deltas are taken from the clock. Active snapshots are kept
+  // in the set, and the smallest one is the watermark, or LATEST if there is none
+  std::atomic<uint64_t> version_clock;
+  std::mutex snapshot_lock;
+  std::multiset<uint64_t> snapshot_set;
+  std::atomic<uint64_t> min_snapshot;
+  // Whether splits try PostSplitHTM() first. Only true if the CPU supports RTM
+  bool htm_enabled;
+  // Only written if BWTREE_LATENCY is defined
+  LatencyRecorderType latency_recorder;
+  ShardedCounterType stat_counter;
+  MemoryCounterType memory_counter;
+};
+
+/*
+ * class ShardedBwTree - Partitions the key space over independent trees
+ * 
+ * 1. Each shard is a BwTree with its own mapping table, root node and epoch
+ *    manager, so node ID allocation, root changes and GC are not shared by 
+ *    threads working on different shards
+ * 2. With hash partitioning, a key belongs to the shard chosen by its hash. 
+ *    A scan reads up to count pairs from every shard and merges them in key order
+ * 3. With range partitioning, shard i holds keys in [split key i - 1, split key i).
+ *    A scan starts at the shard of the start key and continues on the next shards
+ * 4. Scans are not atomic across shards, as they are not across leaves
+ */
+template <typename TreeType, typename KeyHash = std::hash<typename TreeType::KeyType>>
+class ShardedBwTree {
+ public:
+  using KeyType = typename TreeType::KeyType;
+  using ValueType = typename TreeType::ValueType;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+
+  // * enum class PartitionMode - How keys are assigned to shards
+  enum class PartitionMode {
+    Hash = 0,
+    Range,
+  };
+
+  // * ShardedBwTree() - Constructor of a hash partitioned tree with the given number of shards
+  ShardedBwTree(size_t shard_num, HugePageMode table_mode = HugePageMode::None) : 
+    mode{PartitionMode::Hash}, split_key_list{}, shard_list{} {
+    always_assert(shard_num > 0);
+    for(size_t i = 0;i < shard_num;i++) { shard_list.push_back(new TreeType{table_mode}); }
+    return;
+  }
+
+  // * ShardedBwTree() - Constructor of a range partitioned tree. The split keys must be increasing
+  ShardedBwTree(const std::vector<KeyType> &psplit_key_list, HugePageMode table_mode = HugePageMode::None) : 
+    mode{PartitionMode::Range}, split_key_list{psplit_key_list}, shard_list{} {
+    for(size_t i = 1;i < split_key_list.size();i++) { always_assert(split_key_list[i - 1] < split_key_list[i]); }
+    for(size_t i = 0;i <= split_key_list.size();i++) { shard_list.push_back(new TreeType{table_mode}); }
+    return;
+  }
+
+  // * ~ShardedBwTree() - Destructor. No thread should be accessing the tree
+  ~ShardedBwTree() {
+    for(TreeType *tree_p : shard_list) { delete tree_p; }
+    return;
+  }
+
+  ShardedBwTree(const ShardedBwTree &) = delete;
+  ShardedBwTree &operator=(const ShardedBwTree &) = delete;
+
+  // * GetShardIndex() - Returns the index of the shard holding the key
+  size_t GetShardIndex(const KeyType &key) const {
+    if(mode == PartitionMode::Range) {
+      return std::upper_bound(split_key_list.begin(), split_key_list.end(), key) - split_key_list.begin();
+    }
+    // Mixes the hash, since std::hash of integers is usually the identity
+    uint64_t hash = static_cast<uint64_t>(KeyHash{}(key)) * 0x9E3779B97F4A7C15UL;
+    return static_cast<size_t>((hash >> 32) % shard_list.size());
+  }
+
+  // * GetShardNum() - Returns the number of shards
+  inline size_t GetShardNum() const { return shard_list.size(); }
+  // * GetShard() - Returns a shard, e.g. for statistics or checkpoints of each shard
+  inline TreeType *GetShard(size_t index) { return shard_list[index]; }
+  // * GetPartitionMode() - Returns how keys are assigned to shards
+  inline PartitionMode GetPartitionMode() const { return mode; }
+
+  // * Insert() - Inserts a key value pair. Returns false if the key already exists
+  inline bool Insert(const KeyType &key, const ValueType &value) { return GetShardOf(key)->Insert(key, value); }
+  // * Delete() - Deletes a key. Returns false if the key does not exist
+  inline bool Delete(const KeyType &key) { return GetShardOf(key)->Delete(key); }
+  // * GetValue() - Searches the key and copies the value. Returns false if the key does not exist
+  inline bool GetValue(const KeyType &key, ValueType *value_p) { return GetShardOf(key)->GetValue(key, value_p); }
+
+  /*
+   * Scan() - Copies at most count key value pairs whose keys are not less than
+   *          the start key, in key order
+   * 
+   * Returns the number of pairs copied
+   */
+  size_t Scan(const KeyType &start_key, size_t count, std::vector<KeyValuePairType> *result_p) {
+    if(mode == PartitionMode::Range) {
+      size_t first = GetShardIndex(start_key);
+      size_t copied = 0;
+      for(size_t i = first;i < shard_list.size() && copied < count;i++) {
+        copied += shard_list[i]->Scan(i == first ? start_key : split_key_list[i - 1], count - copied, result_p);
+      }
+      return copied;
+    }
+
+    std::vector<std::vector<KeyValuePairType>> shard_result_list(shard_list.size());
+    for(size_t i = 0;i < shard_list.size();i++) { shard_list[i]->Scan(start_key, count, &shard_result_list[i]); }
+    // Pairs of the next key of a shard and the shard index, smallest key on the top
+    using HeadType = std::pair<KeyType, size_t>;
+    auto head_greater = [](const HeadType &a, const HeadType &b) { return b.first < a.first; };
+    std::priority_queue<HeadType, std::vector<HeadType>, decltype(head_greater)> head_queue{head_greater};
+    std::vector<size_t> index_list(shard_list.size(), 0);
+    for(size_t i = 0;i < shard_list.size();i++) {
+      if(shard_result_list[i].empty() == false) { head_queue.emplace(shard_result_list[i][0].first, i); }
+    }
+
+    size_t copied = 0;
+    while(copied < count && head_queue.empty() == false) {
+      size_t shard = head_queue.top().second;
+      head_queue.pop();
+      result_p->push_back(shard_result_list[shard][index_list[shard]++]);
+      copied++;
+      if(index_list[shard] < shard_result_list[shard].size()) { 
+        head_queue.emplace(shard_result_list[shard][index_list[shard]].first, shard); 
+      }
+    }
+
+    return copied;
+  }
+
+  // * PerformGC() - Advances the epoch and reclaims garbage of every shard
+  void PerformGC() {
+    for(TreeType *tree_p : shard_list) { tree_p->PerformGC(); }
+    return;
+  }
+
+  // * Verify() - Returns true if every shard is valid
+  bool Verify() {
+    for(TreeType *tree_p : shard_list) { 
+      if(tree_p->Verify() == false) { return false; }
+    }
+
+    return true;
+  }
+
+ private:
+  // * GetShardOf() - Returns the shard holding the key
+  inline TreeType *GetShardOf(const KeyType &key) { return shard_list[GetShardIndex(key)]; }
 
+  PartitionMode mode;
+  // Only used by range partitioning
+  std::vector<KeyType> split_key_list;
+  std::vector<TreeType *> shard_list;
 };
 
 } // namespace bwtree
 } // namespace index_building_block
 } // namespace wangziqi2013
 
-#endif
\ No newline at end of file
+#endif
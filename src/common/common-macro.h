@@ -59,7 +59,7 @@
 // This assert will work even under debug mode
 #define always_assert(cond)                                \
   do {                                                     \
-    if(!(cond)) err_printf("Assertion \"" #cond "\" fails\n"); \
+    if(!(cond)) err_printf("Assertion \"%s\" fails\n", #cond); \
   } while (0); 
 #endif
 
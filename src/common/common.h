@@ -30,6 +30,7 @@
 
 // The following are C++ STL inclusions
 #include <vector>
+#include <string>
 
 // Empty namesapce definition to allow the compiler know them
 // in advance
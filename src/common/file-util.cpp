@@ -0,0 +1,143 @@
+
+#include "file-util.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <random>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+// Kernels before 4.17 do not know the flag, and treat the address as a hint
+#ifdef MAP_FIXED_NOREPLACE
+static constexpr int MAP_FIXED_NOREPLACE_FLAG = MAP_FIXED_NOREPLACE;
+#else
+static constexpr int MAP_FIXED_NOREPLACE_FLAG = 0;
+#endif
+
+bool FileExists(const std::string &path) {
+  return access(path.c_str(), F_OK) == 0;
+}
+
+bool FileWriter::Open(const std::string &ppath) {
+  Abort();
+  path = ppath;
+  tmp_path = ppath + ".tmp";
+  offset = 0;
+  failed = false;
+  fp = fopen(tmp_path.c_str(), "wb");
+  return fp != nullptr;
+}
+
+bool FileWriter::Write(const void *p, size_t size) {
+  if(fp == nullptr || failed == true) { return false; }
+  if(size != 0 && fwrite(p, 1, size, fp) != size) { failed = true; return false; }
+  offset += size;
+  return true;
+}
+
+bool FileWriter::Pad(size_t alignment) {
+  static const char zero_list[256] = {};
+  size_t pad_size = (alignment - offset % alignment) % alignment;
+  while(pad_size != 0) {
+    size_t size = std::min(pad_size, sizeof(zero_list));
+    if(Write(zero_list, size) == false) { return false; }
+    pad_size -= size;
+  }
+
+  return true;
+}
+
+bool FileWriter::WriteAt(size_t write_offset, const void *p, size_t size) {
+  if(fp == nullptr || failed == true) { return false; }
+  assert(write_offset + size <= offset);
+  if(fseek(fp, static_cast<long>(write_offset), SEEK_SET) != 0 || fwrite(p, 1, size, fp) != size ||
+     fseek(fp, 0, SEEK_END) != 0) {
+    failed = true;
+    return false;
+  }
+
+  return true;
+}
+
+bool FileWriter::Commit() {
+  if(fp == nullptr) { return false; }
+  bool ret = failed == false && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+  ret = fclose(fp) == 0 && ret;
+  fp = nullptr;
+  ret = ret && rename(tmp_path.c_str(), path.c_str()) == 0;
+  if(ret == false) { unlink(tmp_path.c_str()); }
+  return ret;
+}
+
+void FileWriter::Abort() {
+  if(fp == nullptr) { return; }
+  fclose(fp);
+  fp = nullptr;
+  unlink(tmp_path.c_str());
+  return;
+}
+
+bool MappedFile::Open(const std::string &path, const void *address_p) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) { return false; }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+  int flags = MAP_PRIVATE | (address_p == nullptr ? 0 : MAP_FIXED_NOREPLACE_FLAG);
+  void *p = mmap(const_cast<void *>(address_p), static_cast<size_t>(st.st_size), PROT_READ, flags, fd, 0);
+  // The mapping keeps a reference to the file
+  close(fd);
+  if(p == MAP_FAILED) { return false; }
+  if(address_p != nullptr && p != address_p) { munmap(p, static_cast<size_t>(st.st_size)); return false; }
+  data_p = static_cast<const char *>(p);
+  size = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if(data_p == nullptr) { return; }
+  munmap(const_cast<char *>(data_p), size);
+  data_p = nullptr;
+  size = 0;
+  return;
+}
+
+void MappedFile::AdviseSequential() {
+  if(data_p != nullptr) { madvise(const_cast<char *>(data_p), size, MADV_SEQUENTIAL); }
+  return;
+}
+
+/*
+ * ReserveAddress() - Picks a random free range between 16 TB and 64 TB
+ *
+ * The default layout of x86-64 Linux places the program and the heap below
+ * this region, and shared libraries and mappings below the stack above it.
+ * Ranges are aligned to 1 GB. Returns nullptr if no free range is found
+ */
+const void *MappedFile::ReserveAddress(size_t size) {
+  if(sizeof(void *) < 8 || size == 0) { return nullptr; }
+  static constexpr uintptr_t REGION_BEGIN = uintptr_t{1} << 44;
+  static constexpr uintptr_t REGION_END = uintptr_t{1} << 46;
+  static constexpr uintptr_t SLOT_SIZE = uintptr_t{1} << 30;
+  static constexpr int RETRY_COUNT = 16;
+  uintptr_t slot_num = (size + SLOT_SIZE - 1) / SLOT_SIZE;
+  uintptr_t total_slot_num = (REGION_END - REGION_BEGIN) / SLOT_SIZE;
+  if(slot_num >= total_slot_num) { return nullptr; }
+  
+  std::random_device device{};
+  std::mt19937_64 rng{(static_cast<uint64_t>(device()) << 32) ^ device()};
+  for(int i = 0;i < RETRY_COUNT;i++) {
+    void *address_p = reinterpret_cast<void *>(REGION_BEGIN + rng() % (total_slot_num - slot_num) * SLOT_SIZE);
+    void *p = mmap(address_p, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE_FLAG, -1, 0);
+    if(p == MAP_FAILED) { continue; }
+    munmap(p, size);
+    if(p == address_p) { return address_p; }
+  }
+
+  return nullptr;
+}
+
+} // namespace index_building_block
+} // namespace wangziqi2013
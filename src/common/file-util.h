@@ -0,0 +1,103 @@
+
+/*
+ * file-util.h - This file declares helpers for writing and mapping files
+ *
+ * FileWriter writes a file sequentially and installs it atomically. MappedFile
+ * maps a whole file read-only. Both report I/O errors by return values rather
+ * than exiting, since a missing or broken file is usually recoverable
+ */
+
+#pragma once
+#ifndef _FILE_UTIL_H
+#define _FILE_UTIL_H
+
+#include "common.h"
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * class FileWriter - Writes a file sequentially through a temporary file
+ *
+ * 1. Data is written to "<path>.tmp". Commit() flushes and fsync()s it, and then
+ *    renames it to the path, such that readers see either the old file or the
+ *    complete new one
+ * 2. The file is removed if the writer is destroyed without Commit()
+ * 3. Once a write fails, all later calls fail and Commit() returns false
+ */
+class FileWriter {
+ public:
+  FileWriter() : fp{nullptr}, offset{0}, failed{false}, path{}, tmp_path{} {}
+  ~FileWriter() { Abort(); }
+  FileWriter(const FileWriter &) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+
+  // * Open() - Creates the temporary file. Returns false on failure
+  bool Open(const std::string &ppath);
+  // * Write() - Appends bytes at the current offset
+  bool Write(const void *p, size_t size);
+  // * Pad() - Appends zeros until the offset is a multiple of the alignment
+  bool Pad(size_t alignment);
+  // * WriteAt() - Overwrites bytes that have been written before, without moving the offset
+  bool WriteAt(size_t write_offset, const void *p, size_t size);
+  // * Commit() - Makes the file durable and moves it to the path
+  bool Commit();
+  // * Abort() - Closes and removes the temporary file if it is not committed
+  void Abort();
+  // * GetOffset() - Returns the number of bytes written so far
+  inline size_t GetOffset() const { return offset; }
+
+ private:
+  FILE *fp;
+  size_t offset;
+  bool failed;
+  std::string path;
+  std::string tmp_path;
+};
+
+// * FileExists() - Returns whether a file exists at the path
+bool FileExists(const std::string &path);
+
+/*
+ * class MappedFile - Maps a whole file read-only
+ *
+ * 1. The mapping is private and stays valid until Close() or destruction, even
+ *    if the file is replaced or removed in the meantime
+ * 2. Files containing absolute pointers can be mapped at a given address. The
+ *    mapping fails if the address range is not free, and existing mappings are
+ *    never replaced
+ */
+class MappedFile {
+ public:
+  MappedFile() : data_p{nullptr}, size{0} {}
+  ~MappedFile() { Close(); }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // * Open() - Maps the file, at the given address if it is not nullptr. Returns
+  //            false if it cannot be opened or mapped
+  bool Open(const std::string &path, const void *address_p = nullptr);
+  // * Close() - Unmaps the file
+  void Close();
+  // * AdviseSequential() - Hints that the mapping will be read in order
+  void AdviseSequential();
+  // * Contains() - Returns whether an address is within the mapping
+  inline bool Contains(const void *p) const { 
+    return static_cast<const char *>(p) >= data_p && static_cast<const char *>(p) < data_p + size; 
+  }
+  // * ReserveAddress() - Returns the address of a free range of the given size,
+  //                      which is likely to stay free in later processes
+  static const void *ReserveAddress(size_t size);
+  // * GetData() * GetSize() - Returns the address and the size of the mapping
+  inline const char *GetData() const { return data_p; }
+  inline size_t GetSize() const { return size; }
+
+ private:
+  const char *data_p;
+  size_t size;
+};
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
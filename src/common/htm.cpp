@@ -0,0 +1,32 @@
+
+#include "htm.h"
+#ifdef HTM_COMPILED
+#include <cpuid.h>
+#endif
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * DetectRTM() - Reads the RTM bit of CPUID leaf 7
+ *
+ * The bit is cleared on CPUs where TSX is disabled by microcode
+ */
+static bool DetectRTM() {
+#ifdef HTM_COMPILED
+  unsigned int eax, ebx, ecx, edx;
+  if(__get_cpuid_max(0, nullptr) < 7) { return false; }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return (ebx & (1U << 11)) != 0;
+#else
+  return false;
+#endif
+}
+
+bool HTMIsSupported() {
+  static const bool supported = DetectRTM();
+  return supported;
+}
+
+} // namespace index_building_block
+} // namespace wangziqi2013
@@ -0,0 +1,39 @@
+
+/*
+ * htm.h - This file declares helpers for hardware transactional memory (RTM)
+ *
+ * RTM is only compiled on x86 with GCC compatible compilers, and only used if
+ * the CPU reports it at runtime. Code using it must always have a fallback,
+ * since a transaction may abort for any reason
+ */
+
+#pragma once
+#ifndef _HTM_H
+#define _HTM_H
+
+#include "common.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+// Defined if RTM intrinsics can be compiled
+#define HTM_COMPILED
+// Functions calling RTM intrinsics must be marked, since the file is not compiled with -mrtm
+// NOTE: Do not add semicolon after this
+#define HTM_TARGET __attribute__((target("rtm")))
+#else
+#define HTM_TARGET
+#endif
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+// Number of times a transaction is started before giving up, if the CPU hints that a retry may succeed
+static constexpr size_t HTM_RETRY_NUM = 4;
+
+// * HTMIsSupported() - Returns whether the CPU supports RTM. Detected once with CPUID
+bool HTMIsSupported();
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
@@ -0,0 +1,70 @@
+
+#include "huge-page.h"
+#include <sys/mman.h>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+// Bytes mapped by HugePageAllocate() and not yet freed
+static std::atomic<size_t> huge_page_mapped_bytes{0};
+
+// * GetMappedSize() - Returns the size that is actually mapped for a requested size
+static size_t GetMappedSize(size_t size, HugePageMode mode) {
+  return mode == HugePageMode::None ? size : (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+/*
+ * MapAligned() - Maps memory aligned to HUGE_PAGE_SIZE
+ *
+ * mmap() only guarantees alignment of the base page. We map one more huge page
+ * and unmap the unaligned head and tail
+ */
+static void *MapAligned(size_t size) {
+  size_t map_size = size + HUGE_PAGE_SIZE;
+  char *p = static_cast<char *>(mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if(p == MAP_FAILED) { err_printf("mmap() failed for %lu bytes\n", map_size); }
+  char *aligned_p = reinterpret_cast<char *>(
+    (reinterpret_cast<uintptr_t>(p) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+  if(aligned_p != p) { munmap(p, aligned_p - p); }
+  size_t tail_size = (p + map_size) - (aligned_p + size);
+  if(tail_size != 0) { munmap(aligned_p + size, tail_size); }
+
+  return aligned_p;
+}
+
+void *HugePageAllocate(size_t size, HugePageMode mode) {
+  size_t mapped_size = GetMappedSize(size, mode);
+  void *p = nullptr;
+  if(mode == HugePageMode::None) {
+    p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) { err_printf("mmap() failed for %lu bytes\n", mapped_size); }
+  } else {
+#ifdef MAP_HUGETLB
+    if(mode == HugePageMode::Explicit) {
+      p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if(p == MAP_FAILED) { p = nullptr; }
+    }
+#endif
+    if(p == nullptr) {
+      p = MapAligned(mapped_size);
+#ifdef MADV_HUGEPAGE
+      madvise(p, mapped_size, MADV_HUGEPAGE);
+#endif
+    }
+  }
+
+  huge_page_mapped_bytes.fetch_add(mapped_size, std::memory_order_relaxed);
+  return p;
+}
+
+void HugePageFree(void *p, size_t size, HugePageMode mode) {
+  size_t mapped_size = GetMappedSize(size, mode);
+  munmap(p, mapped_size);
+  huge_page_mapped_bytes.fetch_sub(mapped_size, std::memory_order_relaxed);
+  return;
+}
+
+size_t HugePageGetMappedBytes() { return huge_page_mapped_bytes.load(std::memory_order_relaxed); }
+
+} // namespace index_building_block
+} // namespace wangziqi2013
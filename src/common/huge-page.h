@@ -0,0 +1,205 @@
+
+/*
+ * huge-page.h - This file declares huge page backed memory allocation
+ *
+ * Large tables are allocated directly with HugePageAllocate(). Small objects
+ * such as tree nodes are allocated from HugePageArena, which carves them out
+ * of 2 MB chunks, such that objects allocated together share TLB entries
+ */
+
+#pragma once
+#ifndef _HUGE_PAGE_H
+#define _HUGE_PAGE_H
+
+#include "common.h"
+#include <atomic>
+#include <mutex>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+// * enum class HugePageMode - How memory is backed by huge pages
+enum class HugePageMode {
+  // Regular pages
+  None = 0,
+  // Transparent huge pages requested by madvise(MADV_HUGEPAGE)
+  Transparent,
+  // Reserved huge pages (MAP_HUGETLB). Falls back to Transparent if no huge
+  // page is reserved
+  Explicit,
+};
+
+// Size of a huge page, which is also the alignment of huge page allocations
+static constexpr size_t HUGE_PAGE_SIZE = size_t{2} * 1024 * 1024;
+
+/*
+ * HugePageAllocate() - Maps zeroed anonymous memory
+ *
+ * 1. The size is rounded up to HUGE_PAGE_SIZE unless mode is None, and the 
+ *    address is aligned to HUGE_PAGE_SIZE
+ * 2. Failure of madvise() is ignored, since the memory is still usable. Failure
+ *    of mmap() is a fatal error
+ */
+void *HugePageAllocate(size_t size, HugePageMode mode);
+
+// * HugePageFree() - Unmaps memory returned by HugePageAllocate() with the same size and mode
+void HugePageFree(void *p, size_t size, HugePageMode mode);
+
+// * HugePageGetMappedBytes() - Returns bytes mapped by HugePageAllocate() and not yet freed
+size_t HugePageGetMappedBytes();
+
+/*
+ * class HugePageArena - Size class allocator over huge page chunks
+ *
+ * 1. Each thread bump allocates from its own 2 MB chunk. Freed blocks go to the
+ *    free list of their size class in the freeing thread, and are reused by
+ *    later allocations of that thread
+ * 2. Each block has a 16 byte header that stores the size class, which is also
+ *    the alignment of blocks. Sizes are rounded up to 16 bytes below 128 bytes,
+ *    and to a quarter of the power of two above
+ * 3. Blocks larger than MAX_BLOCK_SIZE are mapped individually and unmapped
+ *    when freed. Chunks of small blocks are never returned to the OS
+ * 4. Thread caches are recycled when threads exit, such that their free blocks
+ *    are not lost
+ */
+template <HugePageMode MODE>
+class HugePageArena {
+ public:
+  static constexpr size_t HEADER_SIZE = 16;
+  static constexpr size_t MAX_BLOCK_SIZE = 256 * 1024;
+  // 8 classes up to 128 bytes, then 4 per power of two up to MAX_BLOCK_SIZE
+  static constexpr size_t CLASS_COUNT = 8 + (18 - 7) * 4;
+  static constexpr uint64_t LARGE_CLASS = static_cast<uint64_t>(-1);
+
+  // * Allocate() - Returns a block of at least the given size, aligned to 16 bytes
+  static void *Allocate(size_t size) {
+    size_t total_size = size + HEADER_SIZE;
+    uint64_t *header_p;
+    if(total_size > MAX_BLOCK_SIZE) {
+      header_p = static_cast<uint64_t *>(HugePageAllocate(total_size, MODE));
+      header_p[0] = LARGE_CLASS;
+      header_p[1] = total_size;
+    } else {
+      size_t size_class = GetClass(total_size);
+      header_p = static_cast<uint64_t *>(GetCache()->Allocate(size_class));
+      header_p[0] = size_class;
+    }
+
+    return reinterpret_cast<char *>(header_p) + HEADER_SIZE;
+  }
+
+  // * Free() - Frees a block returned by Allocate()
+  static void Free(void *p) {
+    uint64_t *header_p = reinterpret_cast<uint64_t *>(static_cast<char *>(p) - HEADER_SIZE);
+    if(header_p[0] == LARGE_CLASS) {
+      HugePageFree(header_p, header_p[1], MODE);
+    } else {
+      assert(header_p[0] < CLASS_COUNT);
+      GetCache()->Free(header_p, header_p[0]);
+    }
+
+    return;
+  }
+
+  // * GetClass() - Returns the size class of a block size including the header
+  static size_t GetClass(size_t size) {
+    assert(size > 0 && size <= MAX_BLOCK_SIZE);
+    if(size <= 128) { return (size - 1) / 16; }
+    size_t shift = 63 - static_cast<size_t>(__builtin_clzl(size - 1));
+    return 8 + (shift - 7) * 4 + (((size - 1) >> (shift - 2)) & 3);
+  }
+
+  // * GetClassSize() - Returns the block size of a size class
+  static size_t GetClassSize(size_t size_class) {
+    if(size_class < 8) { return (size_class + 1) * 16; }
+    size_t shift = (size_class - 8) / 4 + 7;
+    return (size_t{1} << shift) + ((size_class - 8) % 4 + 1) * (size_t{1} << (shift - 2));
+  }
+
+ private:
+  // * class ThreadCache - Free lists and the current chunk of a thread
+  class ThreadCache {
+   public:
+    ThreadCache() : free_list{}, bump_p{nullptr}, bump_end_p{nullptr} {}
+
+    // * Allocate() - Pops the free list, or carves a block from the chunk
+    void *Allocate(size_t size_class) {
+      void *block_p = free_list[size_class];
+      if(block_p != nullptr) {
+        free_list[size_class] = *static_cast<void **>(block_p);
+        return block_p;
+      }
+
+      size_t block_size = GetClassSize(size_class);
+      if(bump_p == nullptr || static_cast<size_t>(bump_end_p - bump_p) < block_size) {
+        // The rest of the old chunk is smaller than the block and is wasted
+        bump_p = static_cast<char *>(HugePageAllocate(HUGE_PAGE_SIZE, MODE));
+        bump_end_p = bump_p + HUGE_PAGE_SIZE;
+      }
+
+      block_p = bump_p;
+      bump_p += block_size;
+      return block_p;
+    }
+
+    // * Free() - Pushes a block into the free list. The header is overwritten
+    inline void Free(void *block_p, size_t size_class) {
+      *static_cast<void **>(block_p) = free_list[size_class];
+      free_list[size_class] = block_p;
+      return;
+    }
+
+    void *free_list[CLASS_COUNT];
+    char *bump_p;
+    char *bump_end_p;
+  };
+
+  // * class CacheHolder - Returns the thread cache to the idle list when the thread exits
+  class CacheHolder {
+   public:
+    CacheHolder() : cache_p{nullptr} {
+      std::lock_guard<std::mutex> guard{GetIdleLock()};
+      std::vector<ThreadCache *> &idle_list = GetIdleList();
+      if(idle_list.empty() == false) {
+        cache_p = idle_list.back();
+        idle_list.pop_back();
+      } else {
+        cache_p = new ThreadCache{};
+      }
+
+      return;
+    }
+
+    ~CacheHolder() {
+      std::lock_guard<std::mutex> guard{GetIdleLock()};
+      GetIdleList().push_back(cache_p);
+      return;
+    }
+
+    ThreadCache *cache_p;
+  };
+
+  // * GetCache() - Returns the cache of the calling thread
+  static ThreadCache *GetCache() {
+    static thread_local CacheHolder holder{};
+    return holder.cache_p;
+  }
+
+  // * GetIdleList() - Returns caches of exited threads. Caches are never freed,
+  //                   because blocks in them may still be in use
+  static std::vector<ThreadCache *> &GetIdleList() { 
+    static std::vector<ThreadCache *> *idle_list_p = new std::vector<ThreadCache *>{}; 
+    return *idle_list_p; 
+  }
+  // * GetIdleLock() - Returns the lock of the idle list. It is never destroyed, 
+  //                   since threads may exit after static destructors run
+  static std::mutex &GetIdleLock() { 
+    static std::mutex *idle_lock_p = new std::mutex{}; 
+    return *idle_lock_p; 
+  }
+};
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
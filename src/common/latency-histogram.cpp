@@ -0,0 +1,72 @@
+
+/*
+ * latency-histogram.cpp - Implementation of the latency histogram
+ */
+
+#include "latency-histogram.h"
+#include <cmath>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * Reset() - Clears all samples
+ */
+void LatencyHistogram::Reset() {
+  memset(counts, 0x00, sizeof(counts));
+  total_count = total_sum = max_value = 0;
+  min_value = static_cast<uint64_t>(-1);
+
+  return;
+}
+
+/*
+ * Merge() - Adds samples of another histogram into this one
+ */
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for(size_t i = 0;i < BUCKET_COUNT;i++) { counts[i] += other.counts[i]; }
+  total_count += other.total_count;
+  total_sum += other.total_sum;
+  max_value = std::max(max_value, other.max_value);
+  min_value = std::min(min_value, other.min_value);
+
+  return;
+}
+
+/*
+ * GetPercentile() - Returns the lower bound of the bucket that contains the
+ *                   sample at the given percentile
+ */
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+  if(total_count == 0) { return 0; }
+  uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * total_count));
+  if(target == 0) { target = 1; }
+  // The largest sample is known exactly
+  if(target >= total_count) { return max_value; }
+  uint64_t seen = 0;
+  for(size_t i = 0;i < BUCKET_COUNT;i++) {
+    seen += counts[i];
+    if(seen >= target) { return std::min(GetLowerBound(i), max_value); }
+  }
+
+  return max_value;
+}
+
+/*
+ * Print() - Prints the summary in nanoseconds
+ */
+void LatencyHistogram::Print(FILE *fp, const char *name, bool detail) const {
+  fprintf(fp, "%-12s count %-10lu mean %-9.0f min %-8lu p50 %-8lu p90 %-8lu p99 %-8lu p99.9 %-8lu max %lu (ns)\n",
+          name, total_count, GetMean(), GetMin(),
+          GetPercentile(50.0), GetPercentile(90.0), GetPercentile(99.0), GetPercentile(99.9), max_value);
+  if(detail == true) {
+    for(size_t i = 0;i < BUCKET_COUNT;i++) {
+      if(counts[i] != 0) { fprintf(fp, "  [%lu, %lu) %lu\n", GetLowerBound(i), GetLowerBound(i + 1), counts[i]); }
+    }
+  }
+
+  return;
+}
+
+} // namespace index_building_block
+} // namespace wangziqi2013
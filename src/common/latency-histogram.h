@@ -0,0 +1,82 @@
+
+/*
+ * latency-histogram.h - This file declares the log-linear latency histogram
+ *
+ * The histogram is used by benchmarks as well as by index structures that
+ * record latency of their own operations
+ */
+
+#pragma once
+#ifndef _LATENCY_HISTOGRAM_H
+#define _LATENCY_HISTOGRAM_H
+
+#include "common.h"
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * class LatencyHistogram - Records latency samples in log-linear buckets
+ *
+ * 1. Values below 2^SUB_BUCKET_BITS are recorded exactly. Above that, each
+ *    power of two range is divided into 2^SUB_BUCKET_BITS sub-buckets, which
+ *    bounds the relative error to 2^-SUB_BUCKET_BITS (like HDR histogram)
+ * 2. Histograms are not thread-safe. Each thread records into its own instance,
+ *    and instances are merged after the measurement
+ */
+class LatencyHistogram {
+ public:
+  static constexpr int SUB_BUCKET_BITS = 5;
+  static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << SUB_BUCKET_BITS;
+  static constexpr size_t BUCKET_COUNT = (65 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
+
+  LatencyHistogram() { Reset(); }
+
+  // * Record() - Records one sample
+  inline void Record(uint64_t value) {
+    counts[GetIndex(value)]++;
+    total_count++;
+    total_sum += value;
+    if(value > max_value) { max_value = value; }
+    if(value < min_value) { min_value = value; }
+  }
+
+  // * GetIndex() - Returns the bucket index of a value
+  inline static size_t GetIndex(uint64_t value) {
+    if(value < SUB_BUCKET_COUNT) { return static_cast<size_t>(value); }
+    int msb = 63 - __builtin_clzll(value);
+    uint64_t sub = (value >> (msb - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+    return static_cast<size_t>((msb - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub);
+  }
+
+  // * GetLowerBound() - Returns the smallest value recorded in a bucket
+  inline static uint64_t GetLowerBound(size_t index) {
+    uint64_t bucket = index / SUB_BUCKET_COUNT;
+    uint64_t sub = index % SUB_BUCKET_COUNT;
+    return bucket == 0 ? sub : (SUB_BUCKET_COUNT + sub) << (bucket - 1);
+  }
+
+  void Reset();
+  void Merge(const LatencyHistogram &other);
+  // * GetPercentile() - Returns the value at a percentile in [0, 100]
+  uint64_t GetPercentile(double percentile) const;
+  // * Print() - Prints a summary line; If detail is set, non-empty buckets are also printed
+  void Print(FILE *fp, const char *name, bool detail) const;
+
+  inline uint64_t GetCount() const { return total_count; }
+  inline uint64_t GetMax() const { return max_value; }
+  inline uint64_t GetMin() const { return total_count == 0 ? 0 : min_value; }
+  inline double GetMean() const { return total_count == 0 ? 0.0 : static_cast<double>(total_sum) / total_count; }
+
+ private:
+  uint64_t counts[BUCKET_COUNT];
+  uint64_t total_count;
+  uint64_t total_sum;
+  uint64_t max_value;
+  uint64_t min_value;
+};
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
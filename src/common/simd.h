@@ -0,0 +1,97 @@
+
+/*
+ * simd.h - This file defines vectorized helpers over arrays of integers
+ *
+ * Vectors are written with GCC vector extensions, such that the compiler picks
+ * the instructions of the target (SSE2 on any x86-64, and wider ones if enabled
+ * by -march). Other compilers and non-integral types use scalar loops
+ */
+
+#pragma once
+#ifndef _SIMD_H
+#define _SIMD_H
+
+#include "common.h"
+#include <type_traits>
+
+#if defined(__GNUC__)
+// Defined if vector extensions can be compiled
+#define SIMD_COMPILED
+#endif
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+// Number of bytes in a vector
+static constexpr size_t SIMD_VECTOR_SIZE = 32;
+// Lane counters are added up after this many vectors, before 8 bit lanes could overflow
+static constexpr size_t SIMD_FLUSH_INTERVAL = 127;
+
+// * struct IsSIMDType - Whether arrays of the type are compared in vectors
+template <typename T>
+struct IsSIMDType : public std::integral_constant<bool,
+#ifdef SIMD_COMPILED
+  std::is_integral<T>::value && std::is_same<T, bool>::value == false && 
+  (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)
+#else
+  false
+#endif
+> {};
+
+// * CountLessScalar() - Returns the number of elements less than the key in an array with a scalar loop
+template <typename T>
+inline size_t CountLessScalar(const T *data_p, size_t num, const T &key) {
+  size_t count = 0;
+  for(size_t i = 0;i < num;i++) { count += data_p[i] < key; }
+  return count;
+}
+
+/*
+ * CountLess() - Returns the number of elements less than the key in an array
+ *
+ * 1. The array need not be sorted. For a sorted array the result is the index
+ *    of the lower bound of the key, and for small arrays such as node key
+ *    blocks, a vectorized count is faster than a binary search since it has no
+ *    unpredictable branches
+ * 2. Integral types are compared one vector at a time, and the tail is counted
+ *    by a scalar loop
+ */
+#ifdef SIMD_COMPILED
+template <typename T>
+inline typename std::enable_if<IsSIMDType<T>::value, size_t>::type
+CountLess(const T *data_p, size_t num, const T &key) {
+  static constexpr size_t LANE_NUM = SIMD_VECTOR_SIZE / sizeof(T);
+  // Comparisons return a vector of signed integers of the same size, with -1 for true
+  using SignedType = typename std::make_signed<T>::type;
+  typedef T VectorType __attribute__((vector_size(SIMD_VECTOR_SIZE)));
+  typedef SignedType MaskType __attribute__((vector_size(SIMD_VECTOR_SIZE)));
+  VectorType key_vector;
+  for(size_t i = 0;i < LANE_NUM;i++) { key_vector[i] = key; }
+
+  size_t count = 0;
+  size_t i = 0;
+  while(i + LANE_NUM <= num) {
+    MaskType sum_vector{};
+    size_t end = std::min(num - num % LANE_NUM, i + LANE_NUM * SIMD_FLUSH_INTERVAL);
+    for(;i < end;i += LANE_NUM) {
+      VectorType data_vector;
+      memcpy(&data_vector, data_p + i, sizeof(VectorType));
+      sum_vector -= reinterpret_cast<MaskType>(data_vector < key_vector);
+    }
+    for(size_t j = 0;j < LANE_NUM;j++) { count += static_cast<size_t>(sum_vector[j]); }
+  }
+
+  return count + CountLessScalar(data_p + i, num - i, key);
+}
+#endif
+
+template <typename T>
+inline typename std::enable_if<IsSIMDType<T>::value == false, size_t>::type
+CountLess(const T *data_p, size_t num, const T &key) {
+  return CountLessScalar(data_p, num, key);
+}
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
@@ -0,0 +1,308 @@
+
+#include "wal.h"
+#include "file-util.h"
+#include <chrono>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+// Records are padded to this size, such that headers in the file are aligned
+static constexpr size_t RECORD_ALIGNMENT = 8;
+static constexpr uint32_t WAL_VERSION = 1;
+
+// * AlignRecord() - Returns the size of a record in the file including padding
+static inline size_t AlignRecord(size_t size) {
+  return (sizeof(WriteAheadLog::RecordHeader) + size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+}
+
+// * WriteAll() - Writes the whole buffer, retrying on partial writes
+static bool WriteAll(int fd, const char *p, size_t size) {
+  while(size != 0) {
+    ssize_t ret = write(fd, p, size);
+    if(ret <= 0) { return false; }
+    p += ret;
+    size -= static_cast<size_t>(ret);
+  }
+
+  return true;
+}
+
+WriteAheadLog::WriteAheadLog() :
+  fd{-1}, config{}, instance_id{0}, next_lsn{1}, buffer_list_lock{}, buffer_list{},
+  requested_group{1}, durable_group{0}, durable_lsn{1}, failed{false}, flush_lock{}, flush_cv{}, durable_cv{},
+  flush_requested{false}, stop{false}, flusher{},
+  record_count{0}, group_count{0}, sync_count{0} {
+  static std::atomic<uint64_t> next_instance_id{1};
+  instance_id = next_instance_id.fetch_add(1);
+  return;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  Close();
+  for(Buffer *buffer_p : buffer_list) { delete buffer_p; }
+  return;
+}
+
+/*
+ * Open() - Opens the log for appending
+ *
+ * An existing file is scanned to find the end of valid records, which is where
+ * new records are written, and the largest LSN
+ */
+bool WriteAheadLog::Open(const std::string &path, const Config &pconfig) {
+  Close();
+  config = pconfig;
+  uint64_t max_lsn = 0;
+  size_t valid_size = 0;
+  MappedFile file{};
+  if(file.Open(path) == true) {
+    if(file.GetSize() < FILE_HEADER_SIZE || *reinterpret_cast<const uint64_t *>(file.GetData()) != MAGIC) { return false; }
+    valid_size = Scan(file.GetData(), file.GetSize(), [&max_lsn](const RecordHeader *header_p, size_t) {
+      max_lsn = std::max(max_lsn, header_p->lsn);
+    });
+    file.Close();
+  }
+
+  fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if(fd < 0) { return false; }
+  if(valid_size == 0) {
+    uint64_t file_header[2] = {MAGIC, WAL_VERSION};
+    if(ftruncate(fd, 0) != 0 || WriteAll(fd, reinterpret_cast<const char *>(file_header), FILE_HEADER_SIZE) == false) {
+      close(fd);
+      fd = -1;
+      return false;
+    }
+  } else if(ftruncate(fd, static_cast<off_t>(valid_size)) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+    close(fd);
+    fd = -1;
+    return false;
+  }
+
+  next_lsn.store(max_lsn + 1);
+  requested_group.store(durable_group + 1);
+  durable_lsn = max_lsn + 1;
+  failed = false;
+  stop = false;
+  flush_requested = false;
+  record_count.store(0);
+  group_count.store(0);
+  sync_count.store(0);
+  flusher = std::thread{[this]() { FlusherThread(); }};
+  return true;
+}
+
+void WriteAheadLog::Close() {
+  if(fd < 0) { return; }
+  {
+    std::lock_guard<std::mutex> guard{flush_lock};
+    stop = true;
+  }
+  flush_cv.notify_all();
+  flusher.join();
+  close(fd);
+  fd = -1;
+  return;
+}
+
+uint64_t WriteAheadLog::Begin() {
+  assert(IsOpen());
+  Buffer *buffer_p = GetBuffer();
+  // Published before the LSN is taken, such that GetReplayLSN() sees either this
+  // bound or a counter larger than the LSN
+  buffer_p->pending_lsn.store(next_lsn.load());
+  return next_lsn.fetch_add(1);
+}
+
+uint64_t WriteAheadLog::Commit(uint64_t lsn, uint32_t type, const void *data_p, size_t size) {
+  Buffer *buffer_p = GetBuffer();
+  RecordHeader header{static_cast<uint32_t>(size), type, lsn, 0};
+  header.checksum = Checksum(header, static_cast<const char *>(data_p));
+  bool full;
+  {
+    std::lock_guard<std::mutex> guard{buffer_p->lock};
+    std::vector<char> &data = buffer_p->data;
+    size_t offset = data.size();
+    data.resize(offset + AlignRecord(size), 0);
+    memcpy(&data[offset], &header, sizeof(header));
+    if(size != 0) { memcpy(&data[offset + sizeof(header)], data_p, size); }
+    full = data.size() >= config.buffer_size;
+  }
+
+  buffer_p->pending_lsn.store(INVALID_LSN);
+  record_count.fetch_add(1, std::memory_order_relaxed);
+  if(full == true) {
+    std::lock_guard<std::mutex> guard{flush_lock};
+    flush_requested = true;
+    flush_cv.notify_one();
+  }
+
+  return lsn;
+}
+
+void WriteAheadLog::Abort() {
+  GetBuffer()->pending_lsn.store(INVALID_LSN);
+  return;
+}
+
+bool WriteAheadLog::WaitDurable(uint64_t ticket) {
+  if(config.wait_durable == false) { return true; }
+  std::unique_lock<std::mutex> guard{flush_lock};
+  durable_cv.wait(guard, [this, ticket]() { return durable_lsn > ticket || failed == true; });
+  return durable_lsn > ticket;
+}
+
+bool WriteAheadLog::Flush() {
+  std::unique_lock<std::mutex> guard{flush_lock};
+  uint64_t ticket = requested_group.load();
+  flush_requested = true;
+  flush_cv.notify_one();
+  durable_cv.wait(guard, [this, ticket]() { return durable_group >= ticket || failed == true; });
+  return durable_group >= ticket;
+}
+
+bool WriteAheadLog::IsFailed() {
+  std::lock_guard<std::mutex> guard{flush_lock};
+  return failed;
+}
+
+uint64_t WriteAheadLog::GetReplayLSN() {
+  uint64_t lsn = next_lsn.load();
+  std::lock_guard<std::mutex> guard{buffer_list_lock};
+  for(Buffer *buffer_p : buffer_list) { lsn = std::min(lsn, buffer_p->pending_lsn.load()); }
+  return lsn;
+}
+
+bool WriteAheadLog::Replay(const std::string &path, uint64_t start_lsn, const ReplayCallback &cb, size_t *count_p) {
+  if(count_p != nullptr) { *count_p = 0; }
+  if(FileExists(path) == false) { return true; }
+  MappedFile file{};
+  if(file.Open(path) == false || file.GetSize() < FILE_HEADER_SIZE ||
+     *reinterpret_cast<const uint64_t *>(file.GetData()) != MAGIC) {
+    return false;
+  }
+
+  file.AdviseSequential();
+  // Pairs of LSN and file offset, sorted by LSN before replay
+  std::vector<std::pair<uint64_t, size_t>> record_list{};
+  Scan(file.GetData(), file.GetSize(), [start_lsn, &record_list](const RecordHeader *header_p, size_t offset) {
+    if(header_p->lsn >= start_lsn) { record_list.emplace_back(header_p->lsn, offset); }
+  });
+  std::sort(record_list.begin(), record_list.end());
+  for(const std::pair<uint64_t, size_t> &record : record_list) {
+    const RecordHeader *header_p = reinterpret_cast<const RecordHeader *>(file.GetData() + record.second);
+    cb(header_p->type, file.GetData() + record.second + sizeof(RecordHeader), header_p->size);
+  }
+
+  if(count_p != nullptr) { *count_p = record_list.size(); }
+  return true;
+}
+
+WriteAheadLog::Buffer *WriteAheadLog::GetBuffer() {
+  // Pairs of instance ID and buffer. Instances are few, so a linear search is enough
+  static thread_local std::vector<std::pair<uint64_t, Buffer *>> cache{};
+  for(const std::pair<uint64_t, Buffer *> &entry : cache) {
+    if(entry.first == instance_id) { return entry.second; }
+  }
+
+  Buffer *buffer_p = new Buffer{};
+  {
+    std::lock_guard<std::mutex> guard{buffer_list_lock};
+    buffer_list.push_back(buffer_p);
+  }
+  cache.emplace_back(instance_id, buffer_p);
+  return buffer_p;
+}
+
+/*
+ * FlushGroup() - Writes all buffers as one group and syncs
+ *
+ * The watermark is taken before buffers are collected. A change below it has
+ * either appended its record, which is collected below, or aborted
+ */
+void WriteAheadLog::FlushGroup() {
+  uint64_t group = requested_group.fetch_add(1);
+  uint64_t lsn = GetReplayLSN();
+  std::vector<char> group_data{};
+  {
+    std::lock_guard<std::mutex> guard{buffer_list_lock};
+    for(Buffer *buffer_p : buffer_list) {
+      std::lock_guard<std::mutex> buffer_guard{buffer_p->lock};
+      group_data.insert(group_data.end(), buffer_p->data.begin(), buffer_p->data.end());
+      buffer_p->data.clear();
+    }
+  }
+
+  bool ok;
+  {
+    std::lock_guard<std::mutex> guard{flush_lock};
+    ok = failed == false;
+  }
+  // After a failure, records are dropped since they could not be replayed after the failed group
+  if(ok == true && group_data.empty() == false) {
+    ok = WriteAll(fd, group_data.data(), group_data.size());
+    group_count.fetch_add(1, std::memory_order_relaxed);
+    if(ok == true && config.sync_mode == SyncMode::Group) {
+      ok = fdatasync(fd) == 0;
+      sync_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard{flush_lock};
+    if(ok == true) { 
+      durable_group = group; 
+      durable_lsn = std::max(durable_lsn, lsn);
+    } else { 
+      failed = true; 
+    }
+  }
+  durable_cv.notify_all();
+  return;
+}
+
+void WriteAheadLog::FlusherThread() {
+  std::unique_lock<std::mutex> guard{flush_lock};
+  while(true) {
+    flush_cv.wait_for(guard, std::chrono::microseconds{config.flush_interval_us},
+                      [this]() { return flush_requested || stop; });
+    bool exit = stop;
+    flush_requested = false;
+    guard.unlock();
+    FlushGroup();
+    guard.lock();
+    if(exit == true) { break; }
+  }
+
+  return;
+}
+
+size_t WriteAheadLog::Scan(const char *data_p, size_t size, const std::function<void(const RecordHeader *, size_t)> &cb) {
+  size_t offset = FILE_HEADER_SIZE;
+  while(offset + sizeof(RecordHeader) <= size) {
+    const RecordHeader *header_p = reinterpret_cast<const RecordHeader *>(data_p + offset);
+    if(header_p->size > size - offset - sizeof(RecordHeader) ||
+       Checksum(*header_p, data_p + offset + sizeof(RecordHeader)) != header_p->checksum) {
+      break;
+    }
+    cb(header_p, offset);
+    offset += AlignRecord(header_p->size);
+  }
+
+  return std::min(offset, size);
+}
+
+uint64_t WriteAheadLog::Checksum(const RecordHeader &header, const char *data_p) {
+  RecordHeader copy = header;
+  copy.checksum = 0;
+  uint64_t hash = 0xCBF29CE484222325UL;
+  const char *p = reinterpret_cast<const char *>(&copy);
+  for(size_t i = 0;i < sizeof(copy);i++) { hash = (hash ^ static_cast<uint8_t>(p[i])) * 0x100000001B3UL; }
+  for(size_t i = 0;i < header.size;i++) { hash = (hash ^ static_cast<uint8_t>(data_p[i])) * 0x100000001B3UL; }
+  return hash;
+}
+
+} // namespace index_building_block
+} // namespace wangziqi2013
@@ -0,0 +1,184 @@
+
+/*
+ * wal.h - This file declares the write-ahead log
+ *
+ * The log stores opaque records ordered by log sequence numbers (LSN). Records
+ * are appended to per-thread buffers, and a flusher thread writes all buffers
+ * as one group and then syncs the file, such that concurrent writers share one
+ * fsync
+ */
+
+#pragma once
+#ifndef _WAL_H
+#define _WAL_H
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * class WriteAheadLog - Group committed log of typed records
+ *
+ * 1. A writer calls Begin() before the change it logs is made visible (e.g.
+ *    before the CAS), and Commit() after it succeeds or Abort() after it fails.
+ *    The LSN is taken in Begin(), so a change that depends on another visible
+ *    change always has a larger LSN. Records may reach the file out of LSN
+ *    order, and Replay() sorts them
+ * 2. Commit() returns a ticket, which is the LSN of the record. WaitDurable()
+ *    blocks until every record with an LSN not larger than the ticket is 
+ *    written and synced, including records of changes that are still between
+ *    Begin() and Commit(). A change is therefore never durable before a change
+ *    it depends on. It returns immediately if wait_durable is false in the 
+ *    config
+ * 3. Durability is a watermark. Before collecting buffers, the flusher takes
+ *    GetReplayLSN(), below which every record is already in a buffer or was
+ *    aborted, and publishes it after the group is synced
+ * 4. If a group cannot be written or synced, the log fails. The group and all
+ *    later ones are never durable, and WaitDurable() and Flush() return false.
+ *    Records after a partial write could not be replayed, so the log stays 
+ *    failed until it is opened again
+ * 5. The flusher writes a group every flush_interval_us, or earlier when a
+ *    thread buffer exceeds buffer_size
+ * 6. Each record carries a checksum. A torn record at the end of the file is
+ *    ignored by Replay() and truncated by Open()
+ * 7. GetReplayLSN() returns an LSN such that every change with a smaller LSN
+ *    is visible. A checkpoint started after the call contains all of them, so
+ *    recovery replays records from that LSN on
+ */
+class WriteAheadLog {
+ public:
+  // * enum class SyncMode - What the flusher does after writing a group
+  enum class SyncMode {
+    // Records survive a process crash but not a power failure
+    None = 0,
+    // fdatasync() after every group
+    Group,
+  };
+
+  // * class Config - Options of the log
+  class Config {
+   public:
+    Config() : flush_interval_us{1000}, buffer_size{64 * 1024}, sync_mode{SyncMode::Group}, wait_durable{true} {}
+    uint64_t flush_interval_us;
+    size_t buffer_size;
+    SyncMode sync_mode;
+    bool wait_durable;
+  };
+
+  // * class RecordHeader - Precedes the payload of each record in the file
+  class RecordHeader {
+   public:
+    uint32_t size;
+    uint32_t type;
+    uint64_t lsn;
+    // FNV-1a over the header with a zero checksum and the payload
+    uint64_t checksum;
+  };
+
+  // Written at the beginning of the file
+  static constexpr uint64_t MAGIC = 0x4C57454552545742UL;
+  static constexpr uint64_t FILE_HEADER_SIZE = 16;
+  // LSN stored in the per-thread slot if the thread is not logging a change
+  static constexpr uint64_t INVALID_LSN = static_cast<uint64_t>(-1);
+  using ReplayCallback = std::function<void(uint32_t type, const char *data_p, size_t size)>;
+
+  WriteAheadLog();
+  ~WriteAheadLog();
+  WriteAheadLog(const WriteAheadLog &) = delete;
+  WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+  // * Open() - Opens or creates the log and starts the flusher. New records
+  //            continue after the largest LSN in the file
+  bool Open(const std::string &path, const Config &pconfig);
+  // * Close() - Writes all buffered records and stops the flusher
+  void Close();
+  // * IsOpen() - Returns whether the log is open
+  inline bool IsOpen() const { return fd >= 0; }
+
+  // * Begin() - Takes the LSN of a change that is about to become visible
+  uint64_t Begin();
+  // * Commit() - Appends the record of a change that has become visible, and returns the ticket, which is the LSN
+  uint64_t Commit(uint64_t lsn, uint32_t type, const void *data_p, size_t size);
+  // * Abort() - Ends a change that did not become visible. Its LSN is not used
+  void Abort();
+  // * WaitDurable() - Blocks until all LSNs up to the ticket are synced, if wait_durable is set. Returns false if the log failed
+  bool WaitDurable(uint64_t ticket);
+  // * Flush() - Writes a group immediately and waits for it. Returns false if the log failed
+  bool Flush();
+  // * IsFailed() - Returns whether a group could not be written or synced
+  bool IsFailed();
+  // * GetReplayLSN() - Returns the smallest LSN of changes that may not be visible yet
+  uint64_t GetReplayLSN();
+
+  // * GetRecordCount() * GetGroupCount() * GetSyncCount() - Counters since Open()
+  inline uint64_t GetRecordCount() const { return record_count.load(); }
+  inline uint64_t GetGroupCount() const { return group_count.load(); }
+  inline uint64_t GetSyncCount() const { return sync_count.load(); }
+
+  /*
+   * Replay() - Calls the callback on records whose LSN is not less than the
+   *            start LSN, in LSN order
+   *
+   * Returns false if the file exists but is not a log. A missing file has no
+   * records. The number of records replayed is stored if count_p is given
+   */
+  static bool Replay(const std::string &path, uint64_t start_lsn, const ReplayCallback &cb, size_t *count_p = nullptr);
+
+ private:
+  // * class Buffer - Records of one thread that are not yet written
+  class Buffer {
+   public:
+    Buffer() : lock{}, data{}, pending_lsn{INVALID_LSN} {}
+    std::mutex lock;
+    std::vector<char> data;
+    // A lower bound of the LSN taken by Begin(), until Commit() or Abort()
+    std::atomic<uint64_t> pending_lsn;
+  };
+
+  // * GetBuffer() - Returns the buffer of the calling thread, and creates one on first use
+  Buffer *GetBuffer();
+  // * FlushGroup() - Writes all buffers as one group and syncs. Marks the log failed on errors. Only called by the flusher
+  void FlushGroup();
+  // * FlusherThread() - Body of the flusher
+  void FlusherThread();
+  // * Scan() - Parses a mapped log and calls the callback on each valid record. Returns the valid length
+  static size_t Scan(const char *data_p, size_t size, const std::function<void(const RecordHeader *, size_t)> &cb);
+  // * Checksum() - Returns the checksum of a record
+  static uint64_t Checksum(const RecordHeader &header, const char *data_p);
+
+  int fd;
+  Config config;
+  // Distinguishes instances in the thread-local buffer cache
+  uint64_t instance_id;
+  std::atomic<uint64_t> next_lsn;
+  std::mutex buffer_list_lock;
+  std::vector<Buffer *> buffer_list;
+
+  // Group numbers: requested is the group that records appended now will join
+  std::atomic<uint64_t> requested_group;
+  uint64_t durable_group;
+  // Every LSN below it is synced or aborted. Protected by flush_lock
+  uint64_t durable_lsn;
+  // Set when a group cannot be written or synced. Protected by flush_lock
+  bool failed;
+  std::mutex flush_lock;
+  std::condition_variable flush_cv;
+  std::condition_variable durable_cv;
+  bool flush_requested;
+  bool stop;
+  std::thread flusher;
+
+  std::atomic<uint64_t> record_count;
+  std::atomic<uint64_t> group_count;
+  std::atomic<uint64_t> sync_count;
+};
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
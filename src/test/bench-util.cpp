@@ -0,0 +1,190 @@
+
+#include "bench-util.h"
+#include <cmath>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * HashKey() - FNV-1a over the 8 bytes of the sequence number
+ */
+uint64_t HashKey(uint64_t seq) {
+  uint64_t hash = 0xCBF29CE484222325UL;
+  for(int i = 0;i < 8;i++) {
+    hash ^= seq & 0xFF;
+    hash *= 0x100000001B3UL;
+    seq >>= 8;
+  }
+
+  return hash;
+}
+
+/*
+ * ZipfianGenerator() - Constructor
+ *
+ * Precomputes constants of the distribution. This takes O(item_count) time
+ */
+ZipfianGenerator::ZipfianGenerator(uint64_t pitem_count, double ptheta, uint64_t seed) :
+  KeyGenerator{seed},
+  item_count{pitem_count},
+  theta{ptheta} {
+  always_assert(item_count > 1 && theta > 0.0 && theta < 1.0);
+  double zeta_2 = Zeta(2, theta);
+  zeta_n = Zeta(item_count, theta);
+  alpha = 1.0 / (1.0 - theta);
+  eta = (1.0 - std::pow(2.0 / item_count, 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+  half_pow_theta = 1.0 + std::pow(0.5, theta);
+
+  return;
+}
+
+/*
+ * Zeta() - Computes the generalized harmonic number
+ */
+double ZipfianGenerator::Zeta(uint64_t n, double theta) {
+  double sum = 0.0;
+  for(uint64_t i = 1;i <= n;i++) { sum += 1.0 / std::pow(static_cast<double>(i), theta); }
+  return sum;
+}
+
+/*
+ * Next() - Returns the next zipfian distributed item
+ */
+uint64_t ZipfianGenerator::Next(uint64_t pitem_count) {
+  double u = NextDouble();
+  double uz = u * zeta_n;
+  uint64_t ret;
+  if(uz < 1.0) {
+    ret = 0;
+  } else if(uz < half_pow_theta) {
+    ret = 1;
+  } else {
+    ret = static_cast<uint64_t>(item_count * std::pow(eta * u - eta + 1.0, alpha));
+  }
+
+  if(ret >= item_count) { ret = item_count - 1; }
+  return ret % pitem_count;
+}
+
+/*
+ * ArgParser() - Constructor; Splits arguments into names and values
+ */
+ArgParser::ArgParser(int argc, char **argv) : args{} {
+  for(int i = 1;i < argc;i++) {
+    std::string arg{argv[i]};
+    if(arg.compare(0, 2, "--") != 0) { err_printf("Unknown argument \"%s\"\n", argv[i]); }
+    size_t pos = arg.find('=');
+    if(pos == std::string::npos) {
+      args.emplace_back(arg.substr(2), "1");
+    } else {
+      args.emplace_back(arg.substr(2, pos - 2), arg.substr(pos + 1));
+    }
+  }
+
+  return;
+}
+
+bool ArgParser::Has(const std::string &name) const {
+  for(const auto &arg : args) { if(arg.first == name) { return true; } }
+  return false;
+}
+
+std::string ArgParser::GetString(const std::string &name, const std::string &default_value) const {
+  for(const auto &arg : args) { if(arg.first == name) { return arg.second; } }
+  return default_value;
+}
+
+uint64_t ArgParser::GetUInt(const std::string &name, uint64_t default_value) const {
+  return Has(name) ? std::stoull(GetString(name, "")) : default_value;
+}
+
+double ArgParser::GetDouble(const std::string &name, double default_value) const {
+  return Has(name) ? std::stod(GetString(name, "")) : default_value;
+}
+
+std::vector<uint64_t> ArgParser::GetUIntList(const std::string &name,
+                                             const std::vector<uint64_t> &default_value) const {
+  if(Has(name) == false) { return default_value; }
+  std::vector<uint64_t> ret{};
+  std::string value = GetString(name, "");
+  size_t start = 0;
+  while(start < value.size()) {
+    size_t end = value.find(',', start);
+    if(end == std::string::npos) { end = value.size(); }
+    ret.push_back(std::stoull(value.substr(start, end - start)));
+    start = end + 1;
+  }
+
+  return ret;
+}
+
+bool BenchReport::ParseFormat(const std::string &name, Format *format_p) {
+  if(name == "csv") {
+    *format_p = Format::CSV;
+  } else if(name == "json") {
+    *format_p = Format::JSON;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+void BenchReport::Begin() {
+  if(format == Format::CSV) {
+    fprintf(fp, "block,case,param_name,param,threads,ops,retries,total_ns,ns_per_op,mops");
+    for(size_t i = 0;perf == true && i < PerfCounter::EVENT_COUNT;i++) {
+      fprintf(fp, ",%s", PerfCounter::GetName(static_cast<PerfCounter::Event>(i)));
+    }
+    fprintf(fp, "\n");
+  } else {
+    fprintf(fp, "[\n");
+  }
+
+  fflush(fp);
+  return;
+}
+
+void BenchReport::AddRow(const char *block, const char *name, const char *param_name, uint64_t param,
+                         uint64_t threads, uint64_t ops, uint64_t retries, uint64_t total_ns,
+                         const PerfCounter::Result &perf_result) {
+  double ns_per_op = ops == 0 ? 0.0 : static_cast<double>(total_ns) * threads / ops;
+  double mops = total_ns == 0 ? 0.0 : ops * 1e3 / total_ns;
+  if(format == Format::CSV) {
+    fprintf(fp, "%s,%s,%s,%lu,%lu,%lu,%lu,%lu,%.3f,%.3f",
+            block, name, param_name, param, threads, ops, retries, total_ns, ns_per_op, mops);
+  } else {
+    fprintf(fp, "%s  {\"block\": \"%s\", \"case\": \"%s\", \"param_name\": \"%s\", \"param\": %lu, "
+            "\"threads\": %lu, \"ops\": %lu, \"retries\": %lu, \"total_ns\": %lu, "
+            "\"ns_per_op\": %.3f, \"mops\": %.3f",
+            row_count == 0 ? "" : ",\n", block, name, param_name, param, threads, ops, retries, total_ns, ns_per_op, mops);
+  }
+
+  for(size_t i = 0;perf == true && i < PerfCounter::EVENT_COUNT;i++) {
+    PerfCounter::Event event = static_cast<PerfCounter::Event>(i);
+    double per_op = ops == 0 ? 0.0 : static_cast<double>(perf_result.Get(event)) / ops;
+    if(format == Format::CSV) {
+      if(perf_result.IsAvailable(event)) { fprintf(fp, ",%.3f", per_op); } else { fprintf(fp, ","); }
+    } else {
+      if(perf_result.IsAvailable(event)) { 
+        fprintf(fp, ", \"%s\": %.3f", PerfCounter::GetName(event), per_op); 
+      } else { 
+        fprintf(fp, ", \"%s\": null", PerfCounter::GetName(event)); 
+      }
+    }
+  }
+  fprintf(fp, format == Format::CSV ? "\n" : "}");
+
+  row_count++;
+  fflush(fp);
+  return;
+}
+
+void BenchReport::End() {
+  if(format == Format::JSON) { fprintf(fp, "%s]\n", row_count == 0 ? "" : "\n"); }
+  fflush(fp);
+  return;
+}
+
+} // namespace index_building_block
+} // namespace wangziqi2013
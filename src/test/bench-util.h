@@ -0,0 +1,174 @@
+
+/*
+ * bench-util.h - This file contains declarations for bench-util.cpp
+ *
+ * Utilities shared by benchmarks, including timers, key generators, latency
+ * histograms, hardware event counters and command line argument parsing
+ */
+
+#pragma once
+#ifndef _BENCH_UTIL_H
+#define _BENCH_UTIL_H
+
+#include "common.h"
+#include "latency-histogram.h"
+#include "perf-counter.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * class Timer - Measures elapsed wall clock time using a steady clock
+ */
+class Timer {
+ public:
+  using ClockType = std::chrono::steady_clock;
+
+  // * Timer() - Constructor; Starts the timer
+  Timer() : start{ClockType::now()} {}
+  // * Reset() - Restarts the timer
+  inline void Reset() { start = ClockType::now(); }
+  // * GetElapsedNanoseconds() - Returns nanoseconds since the last reset
+  inline uint64_t GetElapsedNanoseconds() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ClockType::now() - start).count();
+  }
+  // * GetElapsedSeconds() - Returns seconds since the last reset
+  inline double GetElapsedSeconds() const { return GetElapsedNanoseconds() / 1e9; }
+  // * GetNanoseconds() - Returns the current time stamp in nanoseconds
+  inline static uint64_t GetNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ClockType::now().time_since_epoch()).count();
+  }
+
+ private:
+  ClockType::time_point start;
+};
+
+/*
+ * HashKey() - Maps a sequence number to a scattered 64 bit key (FNV-1a)
+ *
+ * This is the same idea as YCSB's hashed key names: records are inserted in
+ * sequence but their keys are spread over the key space
+ */
+uint64_t HashKey(uint64_t seq);
+
+/*
+ * class KeyGenerator - Base class of generators of integers in [0, item_count)
+ */
+class KeyGenerator {
+ public:
+  KeyGenerator(uint64_t seed) : rng{seed} {}
+  virtual ~KeyGenerator() {}
+  // * Next() - Returns the next integer. The upper bound is given by the caller
+  virtual uint64_t Next(uint64_t item_count) = 0;
+  // * NextDouble() - Returns a uniformly distributed double in [0, 1)
+  inline double NextDouble() { return std::uniform_real_distribution<double>{0.0, 1.0}(rng); }
+
+ protected:
+  std::mt19937_64 rng;
+};
+
+// * class UniformGenerator - Each item is chosen with equal probability
+class UniformGenerator : public KeyGenerator {
+ public:
+  UniformGenerator(uint64_t seed) : KeyGenerator{seed} {}
+  uint64_t Next(uint64_t item_count) override { return rng() % item_count; }
+};
+
+/*
+ * class ZipfianGenerator - Zipfian distributed items, as proposed by Gray et al.
+ *                          in "Quickly Generating Billion-Record Synthetic Databases"
+ *
+ * 1. Item 0 is the most popular. The caller should scatter items if popular
+ *    items should not be clustered (e.g. using HashKey())
+ * 2. zeta(n) is computed once in the constructor for the maximum item count. If
+ *    the caller asks for a smaller count, the result is taken modulo the count
+ */
+class ZipfianGenerator : public KeyGenerator {
+ public:
+  static constexpr double DEFAULT_THETA = 0.99;
+
+  ZipfianGenerator(uint64_t pitem_count, double ptheta, uint64_t seed);
+  uint64_t Next(uint64_t pitem_count) override;
+
+ private:
+  // * Zeta() - Computes sum of 1 / i^theta for i in [1, n]
+  static double Zeta(uint64_t n, double theta);
+
+  uint64_t item_count;
+  double theta;
+  double alpha;
+  double zeta_n;
+  double eta;
+  double half_pow_theta;
+};
+
+/*
+ * class ArgParser - Parses command line arguments of the form --name=value
+ *
+ * Flags without values (--name) are treated as "1"
+ */
+class ArgParser {
+ public:
+  ArgParser(int argc, char **argv);
+
+  // * Has() - Whether the argument is given
+  bool Has(const std::string &name) const;
+  // * GetString() - Returns the value or the default if not given
+  std::string GetString(const std::string &name, const std::string &default_value) const;
+  // * GetUInt() - Returns the value as an unsigned integer
+  uint64_t GetUInt(const std::string &name, uint64_t default_value) const;
+  // * GetDouble() - Returns the value as a double
+  double GetDouble(const std::string &name, double default_value) const;
+  // * GetUIntList() - Returns a comma separated list of unsigned integers
+  std::vector<uint64_t> GetUIntList(const std::string &name, const std::vector<uint64_t> &default_value) const;
+
+ private:
+  std::vector<std::pair<std::string, std::string>> args;
+};
+
+/*
+ * class BenchReport - Writes benchmark results in a stable CSV or JSON format
+ *
+ * 1. Rows are written as soon as they are added, such that partial results
+ *    are available if a long run is interrupted
+ * 2. Columns are fixed: block, case, param_name, param, threads, ops, retries,
+ *    total_ns, ns_per_op, mops. total_ns is wall clock time; ns_per_op is the
+ *    average time of one operation on one thread (i.e. total_ns * threads / ops)
+ * 3. JSON output is an array with one object per line. End() must be called
+ *    to close the array
+ * 4. If perf is true, one column per PerfCounter event is appended, holding the
+ *    event count per operation. Unavailable events are empty (CSV) or null (JSON)
+ */
+class BenchReport {
+ public:
+  enum class Format { CSV, JSON };
+
+  BenchReport(FILE *pfp, Format pformat, bool pperf = false) : fp{pfp}, format{pformat}, perf{pperf}, row_count{0} {}
+
+  // * ParseFormat() - Returns true and sets the format if the name is "csv" or "json"
+  static bool ParseFormat(const std::string &name, Format *format_p);
+
+  // * Begin() - Writes the header (CSV) or the opening bracket (JSON)
+  void Begin();
+  // * AddRow() - Writes one result
+  void AddRow(const char *block, const char *name, const char *param_name, uint64_t param,
+              uint64_t threads, uint64_t ops, uint64_t retries, uint64_t total_ns,
+              const PerfCounter::Result &perf_result = PerfCounter::Result{});
+  // * End() - Finishes the output
+  void End();
+
+ private:
+  FILE *fp;
+  Format format;
+  bool perf;
+  uint64_t row_count;
+};
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
@@ -0,0 +1,129 @@
+
+#include "perf-counter.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+static const char *event_name_list[] = {"cycles", "instructions", "llc_misses", "branch_misses", "dtlb_misses"};
+
+bool PerfCounter::Result::IsAnyAvailable() const {
+  for(size_t i = 0;i < EVENT_COUNT;i++) { if(available_list[i] == true) { return true; } }
+  return false;
+}
+
+void PerfCounter::Result::Merge(const Result &other) {
+  for(size_t i = 0;i < EVENT_COUNT;i++) {
+    if(other.available_list[i] == false) { continue; }
+    value_list[i] += other.value_list[i];
+    available_list[i] = true;
+  }
+
+  return;
+}
+
+void PerfCounter::Result::Print(FILE *fp, uint64_t op_num) const {
+  for(size_t i = 0;i < EVENT_COUNT;i++) {
+    if(available_list[i] == true) {
+      fprintf(fp, "%s%s %.2f", i == 0 ? "" : " ", event_name_list[i], op_num == 0 ? 0.0 : static_cast<double>(value_list[i]) / op_num);
+    } else {
+      fprintf(fp, "%s%s n/a", i == 0 ? "" : " ", event_name_list[i]);
+    }
+  }
+
+  return;
+}
+
+const char *PerfCounter::GetName(Event event) { return event_name_list[event]; }
+
+#ifdef __linux__
+
+/*
+ * PerfCounter() - Constructor
+ *
+ * LLC misses use the generic cache miss event, which is mapped to the last
+ * level cache on most CPUs. dTLB misses are load misses
+ */
+PerfCounter::PerfCounter(bool enabled) {
+  static const uint32_t type_list[] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+  };
+  static const uint64_t config_list[] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+  };
+
+  for(size_t i = 0;i < EVENT_COUNT;i++) {
+    fd_list[i] = -1;
+    if(enabled == false) { continue; }
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type_list[i];
+    attr.size = sizeof(attr);
+    attr.config = config_list[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Calling thread on any CPU, without group
+    fd_list[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  return;
+}
+
+PerfCounter::~PerfCounter() {
+  for(int fd : fd_list) { if(fd != -1) { close(fd); } }
+  return;
+}
+
+void PerfCounter::Start() {
+  for(int fd : fd_list) { if(fd != -1) { ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); } }
+  return;
+}
+
+void PerfCounter::Stop() {
+  for(int fd : fd_list) { if(fd != -1) { ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); } }
+  return;
+}
+
+void PerfCounter::Reset() {
+  for(int fd : fd_list) { if(fd != -1) { ioctl(fd, PERF_EVENT_IOC_RESET, 0); } }
+  return;
+}
+
+PerfCounter::Result PerfCounter::Read() const {
+  Result result{};
+  for(size_t i = 0;i < EVENT_COUNT;i++) {
+    // Value, time enabled, time running
+    uint64_t buffer[3];
+    if(fd_list[i] == -1 || read(fd_list[i], buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer))) { continue; }
+    result.available_list[i] = true;
+    if(buffer[2] != 0 && buffer[2] < buffer[1]) {
+      result.value_list[i] = static_cast<uint64_t>(static_cast<double>(buffer[0]) * buffer[1] / buffer[2]);
+    } else {
+      result.value_list[i] = buffer[0];
+    }
+  }
+
+  return result;
+}
+
+#else
+
+PerfCounter::PerfCounter(bool) { for(int &fd : fd_list) { fd = -1; } }
+PerfCounter::~PerfCounter() {}
+void PerfCounter::Start() {}
+void PerfCounter::Stop() {}
+void PerfCounter::Reset() {}
+PerfCounter::Result PerfCounter::Read() const { return Result{}; }
+
+#endif
+
+} // namespace index_building_block
+} // namespace wangziqi2013
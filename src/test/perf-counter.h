@@ -0,0 +1,87 @@
+
+/*
+ * perf-counter.h - This file declares hardware event counters for benchmarks
+ *
+ * Counters are read with the Linux perf_event_open() system call. On other
+ * platforms, or if the kernel does not allow it, all events are unavailable
+ */
+
+#pragma once
+#ifndef _PERF_COUNTER_H
+#define _PERF_COUNTER_H
+
+#include "common.h"
+
+namespace wangziqi2013 {
+namespace index_building_block {
+
+/*
+ * class PerfCounter - Hardware event counters of the calling thread
+ *
+ * 1. Events are counted in user mode only, for the thread that constructs the
+ *    object. Multi-threaded phases use one instance per thread and merge the
+ *    results
+ * 2. Counters are only running between Start() and Stop(). Several phases can
+ *    be accumulated by calling Start() and Stop() repeatedly
+ * 3. Events that cannot be opened (no permission, not supported by the CPU or
+ *    the hypervisor, or the instance is disabled) are marked as unavailable and
+ *    read as 0. No error is printed
+ * 4. If the kernel multiplexes counters, values are scaled by the ratio of
+ *    enabled time to running time
+ */
+class PerfCounter {
+ public:
+  enum Event : size_t {
+    Cycles = 0,
+    Instructions,
+    LLCMisses,
+    BranchMisses,
+    DTLBMisses,
+    EVENT_COUNT,
+  };
+
+  // * class Result - Values of events, which can be merged over threads
+  class Result {
+   public:
+    Result() : value_list{}, available_list{} {}
+
+    // * IsAvailable() - Returns whether the event has been counted
+    inline bool IsAvailable(Event event) const { return available_list[event]; }
+    // * IsAnyAvailable() - Returns whether any event has been counted
+    bool IsAnyAvailable() const;
+    // * Get() - Returns the value of an event
+    inline uint64_t Get(Event event) const { return value_list[event]; }
+    // * Merge() - Adds available events of another result
+    void Merge(const Result &other);
+    // * Print() - Prints events divided by the number of operations, e.g. "cycles 12.3 ..."
+    void Print(FILE *fp, uint64_t op_num) const;
+
+    uint64_t value_list[EVENT_COUNT];
+    bool available_list[EVENT_COUNT];
+  };
+
+  // * PerfCounter() - Opens counters for the calling thread if enabled is true
+  PerfCounter(bool enabled = true);
+  ~PerfCounter();
+  PerfCounter(const PerfCounter &) = delete;
+  PerfCounter &operator=(const PerfCounter &) = delete;
+
+  // * Start() - Starts counting
+  void Start();
+  // * Stop() - Stops counting. Values are kept until Reset()
+  void Stop();
+  // * Reset() - Sets values to 0
+  void Reset();
+  // * Read() - Returns the values counted so far
+  Result Read() const;
+  // * GetName() - Returns the name of an event, which is also used as column name
+  static const char *GetName(Event event);
+
+ private:
+  int fd_list[EVENT_COUNT];
+};
+
+} // namespace index_building_block
+} // namespace wangziqi2013
+
+#endif
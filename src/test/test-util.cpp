@@ -7,3 +7,6 @@
 
 using namespace wangziqi2013;
 using namespace index_building_block;
+
+// The global printing object for parameterized types
+TestPrint test_out;
@@ -35,7 +35,10 @@ class TestPrint {
  public:
   template <typename T>
   inline TestPrint &operator<<(const T &var) { std::cerr << " " << var; return *this; }
-} test_out;
+};
+
+// Defined in test-util.cpp
+extern TestPrint test_out;
 
 // If called this function prints the current function name
 // as the name of the test case - this always prints in any mode
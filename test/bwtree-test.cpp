@@ -10,14 +10,17 @@ using namespace bwtree;
  * MappingTableTest() - Tests mapping table
  * 
  * 1. Single thread allocation of node ID
- * 2. Concurrent allocation of node ID
+ * 2. Concurrent allocation of node ID. IDs are allocated from per-thread blocks,
+ *    so the table has room for a partially used block of each thread. Slots
+ *    reserved in blocks are not counted as used
  * 3. CAS
  * 4. Overflow under debug mode
  */
 BEGIN_DEBUG_TEST(MappingTableTest) {
   constexpr size_t size = 1024 * 1024; 
   constexpr size_t thread_num = 16;
-  using MappingTableType = DefaultMappingTable<char, size>;
+  using MappingTableType = DefaultMappingTable<char, size + thread_num * 256>;
+  static_assert(MappingTableType::ID_BLOCK_SIZE == 256, "The table size assumes this block size");
   using NodeIDType = typename MappingTableType::NodeIDType;
   MappingTableType *mapping_table = MappingTableType::Get();
 
@@ -30,7 +33,7 @@ BEGIN_DEBUG_TEST(MappingTableTest) {
     const size_t per_thread = size / thread_num;
     const size_t begin_node_id = thread_id * per_thread;
     const size_t end_node_id = begin_node_id + per_thread;
-    char *p = reinterpret_cast<char *>(begin_node_id);
+    char *p = reinterpret_cast<char *>(begin_node_id + 1);
     for(size_t i = begin_node_id;i < end_node_id;i++) {
       NodeIDType node_id = mapping_table->AllocateNodeID(p);
       always_assert(mapping_table->At(node_id) == \
@@ -44,7 +47,16 @@ BEGIN_DEBUG_TEST(MappingTableTest) {
   // This function checks the mapping table
   // And will change its content
   auto verify = [mapping_table]() {
-    for(size_t i = 0;i < size;i++) {
+    // Every allocated slot holds a distinct pointer
+    std::vector<char *> pointer_list{};
+    for(size_t i = 0;i < mapping_table->GetNextSlot();i++) {
+      if(mapping_table->At(i) != nullptr) { pointer_list.push_back(mapping_table->At(i)); }
+    }
+    std::sort(pointer_list.begin(), pointer_list.end());
+    always_assert(pointer_list.size() == size);
+    always_assert(std::unique(pointer_list.begin(), pointer_list.end()) == pointer_list.end());
+
+    for(size_t i = 0;i < mapping_table->GetNextSlot();i++) {
       char *node_p = mapping_table->At(i);
       bool ret;
       ret = \
@@ -64,12 +76,18 @@ BEGIN_DEBUG_TEST(MappingTableTest) {
   test_printf("Single thread test\n");
   // Single thread allocation test
   func(0, 1);
+  always_assert(mapping_table->GetUsedSize() == size * sizeof(char *));
   verify();
+  // The rest of the new block is reserved but not used
+  mapping_table->AllocateNodeID(nullptr);
+  always_assert(mapping_table->GetNextSlot() == size + MappingTableType::ID_BLOCK_SIZE);
+  always_assert(mapping_table->GetUsedSize() == (size + 1) * sizeof(char *));
   // Reset
   mapping_table->Reset();
   test_printf("Multithread test\n");
   // Multithreaded test
   StartThread(thread_num, func, thread_num);
+  always_assert(mapping_table->GetUsedSize() == size * sizeof(char *));
   verify();
 
   MappingTableType::Destroy(mapping_table);
@@ -552,14 +570,1553 @@ BEGIN_DEBUG_TEST(InnerConsolidationTest) {
   MappingTableType::Destroy(table_p);
 } END_TEST
 
+/*
+ * BwTreeBasicTest() - Tests single threaded tree operations
+ * 
+ * 1. Insert enough keys to trigger consolidation and splits on both levels
+ * 2. Duplicated insert and non-existing delete should fail
+ * 3. Point search and scan after deleting half of the keys
+ */
+BEGIN_DEBUG_TEST(BwTreeBasicTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  constexpr int key_num = 100000;
+  TreeType *tree_p = new TreeType{};
+  NodeIDType root_id = tree_p->GetRootID();
+
+  for(int i = 0;i < key_num;i++) { always_assert(tree_p->Insert(i, i + 1) == true); }
+  for(int i = 0;i < key_num;i++) { always_assert(tree_p->Insert(i, i + 2) == false); }
+  // The root must have been split
+  always_assert(tree_p->GetRootID() != root_id);
+  test_printf("Root ID %lu -> %lu after %d inserts\n", root_id, tree_p->GetRootID(), key_num);
+
+  for(int i = 0;i < key_num;i += 2) { always_assert(tree_p->Delete(i) == true); }
+  for(int i = 0;i < key_num;i += 2) { always_assert(tree_p->Delete(i) == false); }
+
+  for(int i = 0;i < key_num;i++) {
+    int value = -1;
+    bool ret = tree_p->GetValue(i, &value);
+    always_assert(ret == (i % 2 == 1));
+    always_assert(ret == false || value == i + 1);
+  }
+
+  std::vector<std::pair<int, int>> result{};
+  always_assert(tree_p->Scan(-100, key_num, &result) == key_num / 2);
+  for(int i = 0;i < key_num / 2;i++) {
+    always_assert(result[i].first == i * 2 + 1);
+    always_assert(result[i].second == i * 2 + 2);
+  }
+
+  result.clear();
+  always_assert(tree_p->Scan(1000, 10, &result) == 10);
+  always_assert(result[0].first == 1001 && result[9].first == 1019);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeMultiThreadTest() - Tests concurrent insert and delete
+ * 
+ * Threads insert disjoint sets of keys and then delete half of them
+ */
+BEGIN_DEBUG_TEST(BwTreeMultiThreadTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  constexpr int thread_num = 8;
+  constexpr int key_num = 20000;
+  TreeType *tree_p = new TreeType{};
+
+  auto func = [tree_p](size_t thread_id, int key_num) {
+    // Interleave keys of threads such that they compete on the same leaves
+    for(int i = 0;i < key_num;i++) { always_assert(tree_p->Insert(i * thread_num + (int)thread_id, i) == true); }
+    for(int i = 0;i < key_num;i += 2) { always_assert(tree_p->Delete(i * thread_num + (int)thread_id) == true); }
+    return;
+  };
+
+  StartThread(thread_num, func, key_num);
+
+  for(int i = 0;i < key_num * thread_num;i++) {
+    int value = -1;
+    bool ret = tree_p->GetValue(i, &value);
+    always_assert(ret == ((i / thread_num) % 2 == 1));
+    always_assert(ret == false || value == i / thread_num);
+  }
+
+  std::vector<std::pair<int, int>> result{};
+  always_assert(tree_p->Scan(0, key_num * thread_num, &result) == (size_t)key_num * thread_num / 2);
+  for(size_t i = 1;i < result.size();i++) { always_assert(result[i - 1].first < result[i].first); }
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * LatencyRecorderTest() - Tests thread indices and merging of per-thread histograms
+ */
+BEGIN_DEBUG_TEST(LatencyRecorderTest) {
+  constexpr size_t thread_num = 8;
+  constexpr uint64_t sample_num = 1000;
+  using LatencyRecorderType = LatencyRecorder<2>;
+  LatencyRecorderType *recorder_p = new LatencyRecorderType{};
+  std::atomic<bool> index_used[ThreadIndex::MAX_THREAD];
+  for(size_t i = 0;i < ThreadIndex::MAX_THREAD;i++) { index_used[i].store(false); }
+  std::atomic<size_t> ready_num{0};
+
+  auto func = [&](size_t thread_id, LatencyRecorderType *recorder_p) {
+    // Indices of threads that are alive at the same time must be distinct, and
+    // indices of exited threads are reused (the main thread may hold one)
+    always_assert(index_used[ThreadIndex::Get()].exchange(true) == false);
+    always_assert(ThreadIndex::Get() <= thread_num);
+    ready_num.fetch_add(1);
+    while(ready_num.load() != thread_num) {}
+    for(uint64_t i = 1;i <= sample_num;i++) { recorder_p->Record(thread_id % 2, i); }
+    { LatencyRecorderType::Scope scope{recorder_p, 1}; }
+    return;
+  };
+
+  StartThread(thread_num, func, recorder_p);
+  LatencyHistogram h0 = recorder_p->Merge(0), h1 = recorder_p->Merge(1);
+  always_assert(h0.GetCount() == sample_num * thread_num / 2);
+  always_assert(h1.GetCount() == sample_num * thread_num / 2 + thread_num);
+  always_assert(h0.GetMax() == sample_num);
+
+  // Indices are reused after threads exit
+  ready_num.store(0);
+  for(size_t i = 0;i < ThreadIndex::MAX_THREAD;i++) { index_used[i].store(false); }
+  StartThread(thread_num, func, recorder_p);
+  always_assert(recorder_p->Merge(0).GetCount() == sample_num * thread_num);
+
+  recorder_p->Reset();
+  always_assert(recorder_p->Merge(0).GetCount() == 0 && recorder_p->Merge(1).GetCount() == 0);
+  delete recorder_p;
+
+  return;
+} END_TEST
+
+/*
+ * BwTreeStatisticsTest() - Tests the statistics snapshot
+ * 
+ * 1. Structural statistics after single threaded inserts and deletes
+ * 2. Event counters of consolidation, split and GC
+ */
+BEGIN_DEBUG_TEST(BwTreeStatisticsTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using StatisticsType = typename TreeType::Statistics;
+  constexpr int key_num = 50000;
+  TreeType *tree_p = new TreeType{};
+
+  StatisticsType stat = tree_p->GetStatistics();
+  always_assert(stat.level_list.size() == 2);
+  always_assert(stat.level_list[1].leaf == true && stat.level_list[1].item_count == 0);
+  always_assert(stat.GetCounter(TreeType::StatConsolidation) == 0);
+
+  for(int i = 0;i < key_num;i++) { tree_p->Insert(i, i); }
+  for(int i = 0;i < key_num;i += 2) { tree_p->Delete(i); }
+  stat = tree_p->GetStatistics();
+  test_printf("Consolidations %lu; splits %lu\n", stat.GetCounter(TreeType::StatConsolidation), stat.GetCounter(TreeType::StatSplit));
+
+  // Exactly one root, and the leaf level holds all live keys
+  always_assert(stat.level_list.size() >= 3);
+  always_assert(stat.level_list[0].node_count == 1);
+  always_assert(stat.level_list.back().leaf == true);
+  always_assert(stat.level_list.back().item_count == key_num / 2);
+  uint64_t node_count = 0, height_count = 0, fill_count = 0;
+  for(const auto &level : stat.level_list) { node_count += level.node_count; }
+  for(uint64_t count : stat.chain_height_list) { height_count += count; }
+  for(uint64_t count : stat.fill_list) { fill_count += count; }
+  always_assert(height_count == node_count && fill_count == node_count);
+
+  // Single threaded: no CAS failure
+  always_assert(stat.GetCounter(TreeType::StatAppendCASFailure) == 0);
+  always_assert(stat.GetCounter(TreeType::StatConsolidation) > 0);
+  always_assert(stat.GetCounter(TreeType::StatConsolidationBytes) > 0);
+  // Each split adds a sibling, and each root split also adds a new root
+  always_assert(stat.GetCounter(TreeType::StatSplit) + stat.level_list.size() == node_count);
+
+  // No thread is in an epoch, so two rounds of GC free everything
+  always_assert(stat.GetGCPendingBytes() > 0);
+  tree_p->PerformGC();
+  tree_p->PerformGC();
+  always_assert(tree_p->GetStatistics().GetGCPendingBytes() == 0);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeMemoryUsageTest() - Tests memory accounting against a walk of the mapping table
+ * 
+ * 1. After concurrent inserts and deletes, base node and delta bytes equal the
+ *    sizes of all chains installed in the mapping table
+ * 2. The GC backlog drops to zero after two rounds of GC
+ * 3. Versions kept for a snapshot are included in base node bytes
+ */
+BEGIN_DEBUG_TEST(BwTreeMemoryUsageTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using MemoryUsageType = typename TreeType::MemoryUsage;
+  constexpr int thread_num = 4;
+  constexpr int key_num = 20000;
+  TreeType *tree_p = new TreeType{};
+
+  MemoryUsageType usage = tree_p->GetMemoryUsage();
+  always_assert(usage.base_node > 0 && usage.delta == 0 && usage.gc_backlog == 0);
+  always_assert(usage.mapping_table_used > 0 && usage.mapping_table_used < usage.mapping_table_reserved);
+
+  auto func = [tree_p](size_t thread_id, int key_num) {
+    for(int i = (int)thread_id;i < key_num;i += thread_num) { tree_p->Insert(i, i); }
+    for(int i = (int)thread_id;i < key_num;i += thread_num * 2) { tree_p->Delete(i); }
+    return;
+  };
+  StartThread(thread_num, func, key_num);
+  usage = tree_p->GetMemoryUsage();
+  test_printf("Total memory %lu bytes\n", usage.GetTotal());
+
+  // Released slots of failed root splits are null and skipped
+  size_t base_size = 0, delta_size = 0;
+  typename TreeType::MappingTableType *table_p = tree_p->GetMappingTable();
+  for(size_t i = 0;i < table_p->GetNextSlot();i++) {
+    if(table_p->At(i) == nullptr) { continue; }
+    typename TreeType::DeltaChainSizeHelperType dcsh{};
+    TreeType::SizeTraverserType::Traverse(table_p->At(i), &dcsh);
+    base_size += dcsh.GetBaseSize();
+    delta_size += dcsh.GetDeltaSize();
+  }
+  always_assert(usage.base_node == base_size);
+  always_assert(usage.delta == delta_size);
+  always_assert(usage.gc_backlog > 0);
+  always_assert(usage.GetTotal() == usage.mapping_table_used + base_size + delta_size + usage.gc_backlog);
+
+  tree_p->PerformGC();
+  tree_p->PerformGC();
+  always_assert(tree_p->GetMemoryUsage().gc_backlog == 0);
+  always_assert(tree_p->GetMemoryUsage().base_node == base_size);
+
+  // Versions that leaves keep for a snapshot are counted in base nodes
+  uint64_t snapshot = tree_p->CreateSnapshot();
+  for(int i = 1;i < key_num;i += 2) { tree_p->Delete(i); }
+  base_size = 0;
+  size_t version_size = 0;
+  for(size_t i = 0;i < table_p->GetNextSlot();i++) {
+    if(table_p->At(i) == nullptr) { continue; }
+    typename TreeType::DeltaChainSizeHelperType dcsh{};
+    TreeType::SizeTraverserType::Traverse(table_p->At(i), &dcsh);
+    base_size += dcsh.GetBaseSize();
+    if(table_p->At(i)->IsLeaf() == false) { continue; }
+    auto base_p = static_cast<typename TreeType::LeafBaseType *>(table_p->At(i)->template GetBase<DefaultDeltaChainType>());
+    auto version_list_p = base_p->GetVersionList();
+    if(version_list_p != nullptr) { version_size += version_list_p->capacity(); }
+  }
+  always_assert(version_size > 0);
+  always_assert(tree_p->GetMemoryUsage().base_node == base_size);
+  tree_p->ReleaseSnapshot(snapshot);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeAnalyzeTest() - Tests the structure verifier and analyzer
+ * 
+ * 1. A tree built by concurrent inserts and deletes is valid, and the result does
+ *    not depend on the number of threads
+ * 2. An unreachable node and unsorted keys in a base node are detected
+ */
+BEGIN_DEBUG_TEST(BwTreeAnalyzeTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using AnalysisType = typename TreeType::Analysis;
+  using LeafBaseType = typename TreeType::LeafBaseType;
+  constexpr int thread_num = 4;
+  constexpr int key_num = 40000;
+  TreeType *tree_p = new TreeType{};
+  always_assert(tree_p->Verify() == true);
+
+  auto func = [tree_p](size_t thread_id, int key_num) {
+    for(int i = (int)thread_id;i < key_num;i += thread_num) { tree_p->Insert(i, i); }
+    for(int i = (int)thread_id;i < key_num;i += thread_num * 2) { tree_p->Delete(i); }
+    return;
+  };
+  StartThread(thread_num, func, key_num);
+
+  AnalysisType result = tree_p->Analyze();
+  test_printf("Depth %lu; leaves %lu; items %lu\n", result.GetDepth(), result.leaf_count, result.item_count);
+  always_assert(result.IsValid() == true);
+  always_assert(result.item_count == key_num / 2);
+  always_assert(result.GetDepth() == tree_p->GetStatistics().level_list.size());
+  always_assert(result.unreachable_count == 0 && result.wasted_bytes < result.total_bytes);
+  AnalysisType parallel_result = tree_p->Analyze(thread_num);
+  always_assert(parallel_result.IsValid() == true);
+  always_assert(parallel_result.node_count == result.node_count && parallel_result.item_count == result.item_count);
+  always_assert(parallel_result.total_bytes == result.total_bytes);
+
+  // A node that is allocated but not linked
+  typename TreeType::MappingTableType *table_p = tree_p->GetMappingTable();
+  LeafBaseType *leaf_p = LeafBaseType::Get(NodeType::LeafBase, 0, TreeType::BoundKeyType::GetInf(), TreeType::BoundKeyType::GetInf());
+  auto node_id = table_p->AllocateNodeID(leaf_p);
+  result = tree_p->Analyze(thread_num);
+  test_printf("Found error: %s\n", result.error_list[0].c_str());
+  always_assert(result.IsValid() == false && result.unreachable_count == 1);
+  table_p->ReleaseNodeID(node_id);
+  LeafBaseType::Destroy(leaf_p);
+  always_assert(tree_p->Verify(thread_num) == true);
+
+  // Swaps two keys in a leaf base node
+  leaf_p = nullptr;
+  for(size_t i = 0;i < table_p->GetNextSlot() && leaf_p == nullptr;i++) {
+    auto node_p = table_p->At(i);
+    if(node_p != nullptr && node_p->GetType() == NodeType::LeafBase && node_p->GetSize() > 2) { 
+      leaf_p = static_cast<LeafBaseType *>(node_p); 
+    }
+  }
+  always_assert(leaf_p != nullptr);
+  std::swap(leaf_p->KeyAt(1), leaf_p->KeyAt(2));
+  result = tree_p->Analyze(thread_num);
+  test_printf("Found error: %s\n", result.error_list[0].c_str());
+  always_assert(result.IsValid() == false && result.error_count == 1);
+  std::swap(leaf_p->KeyAt(1), leaf_p->KeyAt(2));
+  always_assert(tree_p->Verify(thread_num) == true);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeHugePageTest() - Tests a tree whose mapping table and nodes are backed by huge pages
+ * 
+ * Explicit huge pages fall back to transparent huge pages if none is reserved
+ */
+BEGIN_DEBUG_TEST(BwTreeHugePageTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, HugePageDeltaChainType<HugePageMode::Explicit>, 
+                          DefaultBaseNode, DefaultConsolidator>;
+  constexpr int thread_num = 4;
+  constexpr int key_num = 40000;
+  TreeType *tree_p = new TreeType{HugePageMode::Explicit};
+  always_assert(tree_p->GetMappingTable()->GetHugePageMode() == HugePageMode::Explicit);
+
+  auto func = [tree_p](size_t thread_id, int key_num) {
+    for(int i = (int)thread_id;i < key_num;i += thread_num) { always_assert(tree_p->Insert(i, i) == true); }
+    for(int i = (int)thread_id;i < key_num;i += thread_num * 2) { always_assert(tree_p->Delete(i) == true); }
+    return;
+  };
+  StartThread(thread_num, func, key_num);
+
+  for(int i = 0;i < key_num;i++) {
+    int value = -1;
+    bool ret = tree_p->GetValue(i, &value);
+    always_assert(ret == ((i / thread_num) % 2 == 1));
+    always_assert(ret == false || value == i);
+  }
+  always_assert(tree_p->Verify() == true);
+  tree_p->PerformGC();
+  tree_p->PerformGC();
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeCheckpointTest() - Tests bulk load, checkpoint and reload
+ * 
+ * 1. A reloaded tree has the same content and structure is valid
+ * 2. Checkpoints of the original and reloaded trees have the same content
+ * 3. Empty trees, unsorted bulk load input and broken files
+ */
+BEGIN_DEBUG_TEST(BwTreeCheckpointTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  const std::string path = "/tmp/bwtree-checkpoint-test.bin";
+  const std::string reload_path = "/tmp/bwtree-checkpoint-test-reload.bin";
+  constexpr int key_num = 30000;
+  auto read_file = [](const std::string &file_path) {
+    std::string content{};
+    FILE *fp = fopen(file_path.c_str(), "rb");
+    always_assert(fp != nullptr);
+    char buffer[4096];
+    size_t size;
+    while((size = fread(buffer, 1, sizeof(buffer), fp)) != 0) { content.append(buffer, size); }
+    fclose(fp);
+    return content;
+  };
+
+  TreeType *tree_p = new TreeType{};
+  for(int i = 0;i < key_num;i++) { always_assert(tree_p->Insert((i * 7919) % key_num, i) == true); }
+  for(int i = 0;i < key_num;i += 3) { always_assert(tree_p->Delete(i) == true); }
+  always_assert(tree_p->Checkpoint(path) == true);
+
+  TreeType *load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Load(path) == true);
+  always_assert(load_tree_p->Verify() == true);
+  std::vector<KeyValuePairType> result{}, load_result{};
+  always_assert(tree_p->Scan(0, key_num, &result) == load_tree_p->Scan(0, key_num, &load_result));
+  always_assert(result == load_result);
+  for(int i = 0;i < key_num;i++) {
+    int value = -1;
+    always_assert(load_tree_p->GetValue(i, &value) == (i % 3 != 0));
+  }
+  always_assert(load_tree_p->Checkpoint(reload_path) == true);
+  always_assert(read_file(path).size() == read_file(reload_path).size());
+  TreeType *reload_tree_p = new TreeType{};
+  always_assert(reload_tree_p->Load(reload_path) == true);
+  load_result.clear();
+  always_assert(reload_tree_p->Scan(0, key_num, &load_result) == result.size() && result == load_result);
+  delete reload_tree_p;
+  test_printf("Checkpoint of %lu items: %lu bytes\n", result.size(), read_file(path).size());
+
+  // The loaded tree accepts updates like any other tree
+  for(int i = 0;i < key_num;i += 3) { always_assert(load_tree_p->Insert(i, i) == true); }
+  for(int i = 1;i < key_num;i += 3) { always_assert(load_tree_p->Delete(i) == true); }
+  always_assert(load_tree_p->Verify() == true);
+  always_assert(load_tree_p->GetMemoryUsage().base_node > 0);
+
+  // An empty tree yields an empty checkpoint
+  TreeType *empty_tree_p = new TreeType{};
+  always_assert(empty_tree_p->Checkpoint(reload_path) == true);
+  TreeType *empty_load_tree_p = new TreeType{};
+  always_assert(empty_load_tree_p->Load(reload_path) == true);
+  always_assert(empty_load_tree_p->Scan(0, 10, &result) == 0);
+  always_assert(empty_load_tree_p->Verify() == true);
+
+  // Broken files are rejected and the tree is not changed
+  std::string content = read_file(path);
+  FILE *fp = fopen(reload_path.c_str(), "wb");
+  fwrite(content.data(), 1, content.size() / 2, fp);
+  fclose(fp);
+  always_assert(empty_load_tree_p->Load(reload_path) == false);
+  size_t block_offset = (sizeof(CheckpointHeader) + CheckpointHeader::BLOCK_ALIGNMENT - 1) / 
+                        CheckpointHeader::BLOCK_ALIGNMENT * CheckpointHeader::BLOCK_ALIGNMENT;
+  content[block_offset + TreeType::LeafBaseType::GetItemOffset() + sizeof(int) + 1] ^= 0x7F;
+  fp = fopen(reload_path.c_str(), "wb");
+  fwrite(content.data(), 1, content.size(), fp);
+  fclose(fp);
+  always_assert(empty_load_tree_p->Load(reload_path) == false);
+  always_assert(empty_load_tree_p->Load("/tmp/bwtree-checkpoint-test-missing.bin") == false);
+  always_assert(empty_load_tree_p->Verify() == true);
+
+  // Bulk load requires strictly increasing keys
+  std::vector<KeyValuePairType> item_list{{1, 1}, {3, 3}, {2, 2}};
+  always_assert(empty_load_tree_p->BulkLoad(item_list) == false);
+  item_list.clear();
+  for(int i = 0;i < key_num;i++) { item_list.emplace_back(i * 2, i); }
+  always_assert(empty_load_tree_p->BulkLoad(item_list) == true);
+  always_assert(empty_load_tree_p->Verify() == true);
+  for(int i = 0;i < key_num * 2;i++) {
+    int value = -1;
+    always_assert(empty_load_tree_p->GetValue(i, &value) == (i % 2 == 0));
+    always_assert(i % 2 != 0 || value == i / 2);
+  }
+
+  remove(path.c_str());
+  remove(reload_path.c_str());
+  delete tree_p;
+  delete load_tree_p;
+  delete empty_tree_p;
+  delete empty_load_tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeResidentLoadTest() - Tests leaves used in place in a mapped checkpoint
+ * 
+ * 1. Only inner nodes are built on the heap
+ * 2. Updates on mapped leaves are posted as deltas and consolidated to the heap
+ * 3. Mapped leaves are not freed by GC or the destructor
+ */
+BEGIN_DEBUG_TEST(BwTreeResidentLoadTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  const std::string path = "/tmp/bwtree-resident-test.bin";
+  constexpr int key_num = 30000;
+
+  TreeType *tree_p = new TreeType{};
+  for(int i = 0;i < key_num;i += 2) { always_assert(tree_p->Insert(i, i) == true); }
+  always_assert(tree_p->Checkpoint(path) == true);
+
+  TreeType *load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Load(path, TreeType::LoadMode::Resident) == true);
+  always_assert(load_tree_p->IsResident() == true);
+  always_assert(load_tree_p->Verify() == true);
+  typename TreeType::MemoryUsage usage = load_tree_p->GetMemoryUsage();
+  test_printf("Resident load: heap base nodes %lu bytes, mapped file %lu bytes\n", usage.base_node, usage.mapped_file);
+  always_assert(usage.mapped_file > 0 && usage.base_node < usage.mapped_file / 10);
+
+  std::vector<KeyValuePairType> result{}, load_result{};
+  tree_p->Scan(0, key_num, &result);
+  load_tree_p->Scan(0, key_num, &load_result);
+  always_assert(result == load_result);
+
+  // Writes go on top of the mapped leaves, and consolidation copies them out
+  for(int i = 1;i < key_num;i += 2) { always_assert(load_tree_p->Insert(i, i) == true); }
+  for(int i = 0;i < key_num;i += 4) { always_assert(load_tree_p->Delete(i) == true); }
+  always_assert(load_tree_p->Verify() == true);
+  for(int i = 0;i < key_num;i++) {
+    int value = -1;
+    always_assert(load_tree_p->GetValue(i, &value) == (i % 4 != 0));
+    always_assert(i % 4 == 0 || value == i);
+  }
+  always_assert(load_tree_p->GetMemoryUsage().base_node > usage.base_node);
+  load_tree_p->PerformGC();
+  load_tree_p->PerformGC();
+  always_assert(load_tree_p->GetMemoryUsage().gc_backlog == 0);
+
+  // The file can be replaced while it is mapped
+  always_assert(load_tree_p->Checkpoint(path) == true);
+  TreeType *reload_tree_p = new TreeType{};
+  always_assert(reload_tree_p->Load(path, TreeType::LoadMode::Resident) == true);
+  always_assert(reload_tree_p->Verify() == true);
+  result.clear();
+  load_result.clear();
+  load_tree_p->Scan(0, key_num, &result);
+  reload_tree_p->Scan(0, key_num, &load_result);
+  always_assert(result == load_result && result.size() == key_num - key_num / 4);
+
+  remove(path.c_str());
+  delete tree_p;
+  delete load_tree_p;
+  delete reload_tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeLogTest() - Tests the write-ahead log and recovery
+ * 
+ * 1. A checkpoint taken while threads are writing, plus the log, recovers the
+ *    final content of the tree
+ * 2. The log alone also recovers the content
+ */
+BEGIN_DEBUG_TEST(BwTreeLogTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  const std::string path = "/tmp/bwtree-log-test.bin";
+  const std::string log_path = "/tmp/bwtree-log-test.log";
+  const std::string missing_path = "/tmp/bwtree-log-test-missing.bin";
+  constexpr int thread_num = 4;
+  constexpr int key_num = 8000;
+  remove(path.c_str());
+  remove(log_path.c_str());
+
+  WriteAheadLog::Config config{};
+  config.flush_interval_us = 100;
+  config.sync_mode = WriteAheadLog::SyncMode::None;
+  TreeType *tree_p = new TreeType{};
+  always_assert(tree_p->EnableLog(log_path, config) == true);
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = i;key < key_num;key += thread_num) { always_assert(tree_p->Insert(key, key) == true); }
+      for(int key = i;key < key_num;key += thread_num * 3) { always_assert(tree_p->Delete(key) == true); }
+      for(int key = i;key < key_num;key += thread_num * 6) { always_assert(tree_p->Insert(key, -key) == true); }
+    });
+  }
+  // The checkpoint is taken while threads are writing
+  while(tree_p->GetLog()->GetRecordCount() < key_num / 2) { std::this_thread::yield(); }
+  always_assert(tree_p->Checkpoint(path) == true);
+  for(std::thread &t : thread_list) { t.join(); }
+  WriteAheadLog *log_p = tree_p->GetLog();
+  always_assert(log_p->GetGroupCount() > 0 && log_p->GetGroupCount() < log_p->GetRecordCount());
+  test_printf("%lu records in %lu groups\n", log_p->GetRecordCount(), log_p->GetGroupCount());
+  tree_p->DisableLog();
+
+  std::vector<KeyValuePairType> result{}, recover_result{};
+  tree_p->Scan(0, key_num, &result);
+  // The j-th key of a thread is deleted if j % 3 == 0, and inserted again if j % 6 == 0
+  size_t expected_size = 0;
+  for(int key = 0;key < key_num;key++) { expected_size += (key / thread_num) % 3 != 0 || (key / thread_num) % 6 == 0; }
+  always_assert(result.size() == expected_size);
+  TreeType *recover_tree_p = new TreeType{};
+  always_assert(recover_tree_p->Recover(path, log_path) == true);
+  always_assert(recover_tree_p->Verify() == true);
+  recover_tree_p->Scan(0, key_num, &recover_result);
+  always_assert(result == recover_result);
+  delete recover_tree_p;
+
+  // Without a checkpoint the whole log is replayed
+  recover_tree_p = new TreeType{};
+  always_assert(recover_tree_p->Recover(missing_path, log_path) == true);
+  recover_result.clear();
+  recover_tree_p->Scan(0, key_num, &recover_result);
+  always_assert(result == recover_result);
+
+  // Logging continues on the recovered tree, and a later recovery sees both parts
+  always_assert(recover_tree_p->EnableLog(log_path, config) == true);
+  for(int key = key_num;key < key_num * 2;key++) { always_assert(recover_tree_p->Insert(key, key) == true); }
+  recover_tree_p->DisableLog();
+  TreeType *second_tree_p = new TreeType{};
+  always_assert(second_tree_p->Recover(path, log_path) == true);
+  result.clear();
+  recover_result.clear();
+  recover_tree_p->Scan(0, key_num * 2, &result);
+  second_tree_p->Scan(0, key_num * 2, &recover_result);
+  always_assert(result == recover_result && result.size() > static_cast<size_t>(key_num));
+
+  remove(path.c_str());
+  remove(log_path.c_str());
+  delete tree_p;
+  delete recover_tree_p;
+  delete second_tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeIncrementalCheckpointTest() - Tests incremental checkpoints
+ * 
+ * 1. Segments only contain changed leaves, and a full checkpoint plus any 
+ *    prefix of its segments loads the content at the time of the last segment
+ * 2. Segments are rejected out of order or on another base
+ * 3. A split sibling whose CAS fails between two segments is not written, and
+ *    the leaf that keeps its range is
+ * 4. Segments taken while threads are writing, plus the log, recover the tree
+ */
+BEGIN_DEBUG_TEST(BwTreeIncrementalCheckpointTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  using LeafBaseType = typename TreeType::LeafBaseType;
+  using BoundKeyType = typename TreeType::BoundKeyType;
+  const std::string path = "/tmp/bwtree-incremental-test.bin";
+  const std::string log_path = "/tmp/bwtree-incremental-test.log";
+  const std::vector<std::string> segment_path_list = {
+    "/tmp/bwtree-incremental-test.1", "/tmp/bwtree-incremental-test.2", "/tmp/bwtree-incremental-test.3"};
+  constexpr int key_num = 40000;
+  auto file_size = [](const std::string &file_path) {
+    FILE *fp = fopen(file_path.c_str(), "rb");
+    always_assert(fp != nullptr);
+    fseek(fp, 0, SEEK_END);
+    size_t size = static_cast<size_t>(ftell(fp));
+    fclose(fp);
+    return size;
+  };
+  auto scan_all = [](TreeType *t_p) {
+    std::vector<KeyValuePairType> result{};
+    t_p->Scan(0, key_num * 4, &result);
+    return result;
+  };
+
+  TreeType *tree_p = new TreeType{};
+  for(int i = 0;i < key_num;i++) { always_assert(tree_p->Insert((i * 7919) % key_num * 2, i) == true); }
+  always_assert(tree_p->CheckpointIncremental(segment_path_list[0]) == false);
+  always_assert(tree_p->Checkpoint(path) == true);
+
+  // Changes in a tenth of the key space
+  for(int key = 0;key < key_num / 5;key += 4) { always_assert(tree_p->Delete(key) == true); }
+  always_assert(tree_p->CheckpointIncremental(segment_path_list[0]) == true);
+  std::vector<KeyValuePairType> first_result = scan_all(tree_p);
+  test_printf("Full checkpoint %lu bytes, segment %lu bytes\n", file_size(path), file_size(segment_path_list[0]));
+  always_assert(file_size(segment_path_list[0]) < file_size(path) / 5);
+
+  // Inserts split leaves of the first segment, and the remaining space is also changed
+  for(int key = 1;key < key_num / 5;key += 2) { always_assert(tree_p->Insert(key, -key) == true); }
+  for(int key = key_num;key < key_num * 2;key += 6) { always_assert(tree_p->Delete(key) == true); }
+  always_assert(tree_p->CheckpointIncremental(segment_path_list[1]) == true);
+  std::vector<KeyValuePairType> second_result = scan_all(tree_p);
+
+  TreeType *load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Load(path, {segment_path_list[0]}) == true);
+  always_assert(load_tree_p->Verify() == true && scan_all(load_tree_p) == first_result);
+  delete load_tree_p;
+  load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Load(path, {segment_path_list[1]}) == false);
+  always_assert(load_tree_p->Load(path, {segment_path_list[0], segment_path_list[1]}) == true);
+  always_assert(load_tree_p->Verify() == true && scan_all(load_tree_p) == second_result);
+
+  // The loaded tree continues the sequence
+  for(int key = key_num * 2 - 1;key > key_num;key -= 10) { always_assert(load_tree_p->Insert(key, key) == true); }
+  always_assert(load_tree_p->CheckpointIncremental(segment_path_list[2]) == true);
+  TreeType *reload_tree_p = new TreeType{};
+  always_assert(reload_tree_p->Load(path, segment_path_list) == true);
+  always_assert(reload_tree_p->Verify() == true && scan_all(reload_tree_p) == scan_all(load_tree_p));
+  delete reload_tree_p;
+
+  // Segments of another base are rejected
+  always_assert(load_tree_p->Checkpoint(path) == true);
+  reload_tree_p = new TreeType{};
+  always_assert(reload_tree_p->Load(path, {segment_path_list[0]}) == false);
+  always_assert(reload_tree_p->Load(path, std::vector<std::string>{}) == true);
+  always_assert(scan_all(reload_tree_p) == scan_all(load_tree_p));
+  delete reload_tree_p;
+  delete load_tree_p;
+
+  // As in SplitNode(), the sibling is in the mapping table with a copy of the upper half of the
+  // leaf before its CAS, which fails since the leaf changes. It has a larger ID than the leaf
+  TreeType *split_tree_p = new TreeType{};
+  for(int key = 0;key < key_num;key++) { always_assert(split_tree_p->Insert(key, key) == true); }
+  always_assert(split_tree_p->Checkpoint(path) == true);
+  typename TreeType::MappingTableType *table_p = split_tree_p->GetMappingTable();
+  constexpr int split_key = key_num / 2;
+  LeafBaseType *sibling_p = LeafBaseType::Get(NodeType::LeafBase, 2, BoundKeyType::Get(split_key), BoundKeyType::Get(split_key + 2));
+  for(int i = 0;i < 2;i++) {
+    sibling_p->KeyAt(i) = split_key + i;
+    sibling_p->ValueAt(i) = -1;
+  }
+  auto sibling_id = table_p->AllocateNodeID(sibling_p);
+  always_assert(split_tree_p->Delete(split_key + 1) == true);
+  always_assert(split_tree_p->CheckpointIncremental(segment_path_list[0]) == true);
+  // The sibling is released after the first segment, and its slot is dirty again
+  table_p->ReleaseNodeID(sibling_id);
+  LeafBaseType::Destroy(sibling_p);
+  always_assert(split_tree_p->Insert(key_num * 2, 0) == true);
+  always_assert(split_tree_p->CheckpointIncremental(segment_path_list[1]) == true);
+  load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Load(path, {segment_path_list[0]}) == true);
+  std::vector<KeyValuePairType> split_result = scan_all(load_tree_p);
+  always_assert(split_result.size() == static_cast<size_t>(key_num - 1));
+  for(const KeyValuePairType &item : split_result) { always_assert(item.first == item.second); }
+  delete load_tree_p;
+  load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Load(path, {segment_path_list[0], segment_path_list[1]}) == true);
+  always_assert(load_tree_p->Verify() == true && scan_all(load_tree_p) == scan_all(split_tree_p));
+  delete load_tree_p;
+  delete split_tree_p;
+
+  // Segments taken while threads are writing
+  constexpr int thread_num = 4;
+  WriteAheadLog::Config config{};
+  config.flush_interval_us = 100;
+  config.sync_mode = WriteAheadLog::SyncMode::None;
+  remove(log_path.c_str());
+  always_assert(tree_p->EnableLog(log_path, config) == true);
+  always_assert(tree_p->Checkpoint(path) == true);
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = key_num * 2 + i;key < key_num * 3;key += thread_num) { always_assert(tree_p->Insert(key, key) == true); }
+      for(int key = i * 2;key < key_num * 2;key += thread_num * 6) { tree_p->Delete(key); }
+    });
+  }
+  always_assert(tree_p->CheckpointIncremental(segment_path_list[0]) == true);
+  always_assert(tree_p->CheckpointIncremental(segment_path_list[1]) == true);
+  for(std::thread &t : thread_list) { t.join(); }
+  tree_p->DisableLog();
+  load_tree_p = new TreeType{};
+  always_assert(load_tree_p->Recover(path, {segment_path_list[0], segment_path_list[1]}, log_path) == true);
+  always_assert(load_tree_p->Verify() == true && scan_all(load_tree_p) == scan_all(tree_p));
+
+  remove(path.c_str());
+  remove(log_path.c_str());
+  for(const std::string &segment_path : segment_path_list) { remove(segment_path.c_str()); }
+  delete tree_p;
+  delete load_tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeFuzzyCheckpointTest() - Tests checkpoints taken while threads insert
+ *                               and delete keys and split leaves
+ * 
+ * 1. Every checkpoint is a valid file containing all keys that are not changed
+ * 2. The last checkpoint and the log recover the final content
+ * 3. Split siblings in the mapping table that are not in the tree are not in
+ *    the checkpoint, including one with the low key of a leaf in the tree
+ */
+BEGIN_DEBUG_TEST(BwTreeFuzzyCheckpointTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  using LeafBaseType = typename TreeType::LeafBaseType;
+  using BoundKeyType = typename TreeType::BoundKeyType;
+  const std::string path = "/tmp/bwtree-fuzzy-test.bin";
+  const std::string log_path = "/tmp/bwtree-fuzzy-test.log";
+  constexpr int thread_num = 4;
+  constexpr int key_num = 20000;
+  constexpr int checkpoint_num = 4;
+  remove(log_path.c_str());
+
+  // Even keys are never changed, and odd keys are inserted and deleted by writers
+  TreeType *tree_p = new TreeType{};
+  for(int key = 0;key < key_num * 2;key += 2) { always_assert(tree_p->Insert(key, key) == true); }
+  WriteAheadLog::Config config{};
+  config.wait_durable = false;
+  config.sync_mode = WriteAheadLog::SyncMode::None;
+  always_assert(tree_p->EnableLog(log_path, config) == true);
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i, &stop]() {
+      for(int round = 0;stop.load() == false;round++) {
+        for(int key = i * 2 + 1;key < key_num * 2;key += thread_num * 2) {
+          if(round % 2 == 0) { always_assert(tree_p->Insert(key, key) == true); }
+          else { always_assert(tree_p->Delete(key) == true); }
+        }
+      }
+    });
+  }
+
+  for(int i = 0;i < checkpoint_num;i++) {
+    always_assert(tree_p->Checkpoint(path) == true);
+    TreeType *load_tree_p = new TreeType{};
+    always_assert(load_tree_p->Load(path) == true);
+    always_assert(load_tree_p->Verify() == true);
+    std::vector<KeyValuePairType> result{};
+    load_tree_p->Scan(0, key_num * 2, &result);
+    int even_count = 0;
+    for(const KeyValuePairType &item : result) {
+      always_assert(item.first == item.second);
+      even_count += item.first % 2 == 0;
+    }
+    always_assert(even_count == key_num);
+    test_printf("Checkpoint %d: %lu items\n", i, result.size());
+    delete load_tree_p;
+  }
+
+  stop.store(true);
+  for(std::thread &t : thread_list) { t.join(); }
+  tree_p->DisableLog();
+  TreeType *recover_tree_p = new TreeType{};
+  always_assert(recover_tree_p->Recover(path, log_path) == true);
+  std::vector<KeyValuePairType> result{}, recover_result{};
+  tree_p->Scan(0, key_num * 2, &result);
+  recover_tree_p->Scan(0, key_num * 2, &recover_result);
+  always_assert(result == recover_result);
+  delete recover_tree_p;
+
+  typename TreeType::MappingTableType *table_p = tree_p->GetMappingTable();
+  int boundary_key = -1;
+  for(auto node_id = table_p->FIRST_NODE_ID;node_id < table_p->GetNextSlot() && boundary_key < 0;node_id++) {
+    auto *node_p = table_p->At(node_id);
+    if(node_p != nullptr && node_p->IsLeaf() == true && node_p->GetLowKey()->IsInf() == false) { boundary_key = node_p->GetLowKey()->key; }
+  }
+  always_assert(boundary_key > 0);
+  std::vector<std::pair<decltype(table_p->GetNextSlot()), LeafBaseType *>> sibling_list{};
+  for(int low_key : {boundary_key, boundary_key + 3}) {
+    LeafBaseType *sibling_p = LeafBaseType::Get(NodeType::LeafBase, 2, BoundKeyType::Get(low_key), BoundKeyType::Get(low_key + 2));
+    for(int i = 0;i < 2;i++) {
+      sibling_p->KeyAt(i) = low_key + i;
+      sibling_p->ValueAt(i) = -1;
+    }
+    sibling_list.emplace_back(table_p->AllocateNodeID(sibling_p), sibling_p);
+  }
+  always_assert(tree_p->Checkpoint(path) == true);
+  recover_tree_p = new TreeType{};
+  always_assert(recover_tree_p->Load(path) == true);
+  recover_result.clear();
+  recover_tree_p->Scan(0, key_num * 2, &recover_result);
+  always_assert(result == recover_result);
+  for(auto &sibling : sibling_list) {
+    table_p->ReleaseNodeID(sibling.first);
+    LeafBaseType::Destroy(sibling.second);
+  }
+
+  remove(path.c_str());
+  remove(log_path.c_str());
+  delete tree_p;
+  delete recover_tree_p;
+  return;
+} END_TEST
+
+BEGIN_DEBUG_TEST(BwTreeSnapshotTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  constexpr int key_num = 4000;
+  constexpr int thread_num = 4;
+  constexpr int round_num = 4;
+
+  // * CheckSnapshot() - Compares point reads and a scan at the snapshot with the expected content
+  auto CheckSnapshot = [](TreeType *tree_p, uint64_t snapshot, const std::map<int, int> &expected) {
+    for(int key = 0;key < key_num * 2;key++) {
+      int value = -1;
+      bool found = tree_p->GetValue(key, &value, snapshot);
+      auto it = expected.find(key);
+      always_assert(found == (it != expected.end()));
+      always_assert(found == false || value == it->second);
+    }
+
+    std::vector<KeyValuePairType> result{};
+    tree_p->Scan(0, key_num * 4, &result, snapshot);
+    always_assert(result == std::vector<KeyValuePairType>(expected.begin(), expected.end()));
+    return;
+  };
+
+  TreeType *tree_p = new TreeType{};
+  std::map<int, int> current{};
+  for(int key = 0;key < key_num;key++) { tree_p->Insert(key, key); current[key] = key; }
+  uint64_t snapshot1 = tree_p->CreateSnapshot();
+  std::map<int, int> expected1 = current;
+  // Multiples of 3 are deleted, multiples of 5 get a new value, and new keys are added
+  for(int key = 0;key < key_num;key++) {
+    if(key % 3 == 0) { always_assert(tree_p->Delete(key) == true); current.erase(key); }
+    else if(key % 5 == 0) { tree_p->Delete(key); tree_p->Insert(key, key + key_num); current[key] = key + key_num; }
+  }
+  for(int key = key_num;key < key_num * 2;key++) { tree_p->Insert(key, key); current[key] = key; }
+  uint64_t snapshot2 = tree_p->CreateSnapshot();
+  std::map<int, int> expected2 = current;
+  for(int key = 0;key < key_num * 2;key += 2) { if(tree_p->Delete(key) == true) { current.erase(key); } }
+  CheckSnapshot(tree_p, snapshot1, expected1);
+  CheckSnapshot(tree_p, snapshot2, expected2);
+  uint64_t snapshot3 = tree_p->CreateSnapshot();
+  CheckSnapshot(tree_p, snapshot3, current);
+  tree_p->ReleaseSnapshot(snapshot3);
+  std::vector<KeyValuePairType> result{};
+  tree_p->Scan(0, key_num * 4, &result);
+  always_assert(result == std::vector<KeyValuePairType>(current.begin(), current.end()));
+
+  // Versions only needed by the first snapshot are dropped by later consolidations
+  tree_p->ReleaseSnapshot(snapshot1);
+  for(int key = 0;key < key_num * 2;key += 4) { tree_p->Insert(key, key); current[key] = key; }
+  CheckSnapshot(tree_p, snapshot2, expected2);
+  tree_p->ReleaseSnapshot(snapshot2);
+  always_assert(tree_p->Verify() == true);
+  delete tree_p;
+
+  // Even keys are never changed, and odd keys are inserted and deleted by writers.
+  // Reads at a snapshot return the same content while the writers continue
+  tree_p = new TreeType{};
+  for(int key = 0;key < key_num * 2;key += 2) { tree_p->Insert(key, key); }
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i, &stop]() {
+      for(int round = 0;stop.load() == false;round++) {
+        for(int key = i * 2 + 1;key < key_num * 2;key += thread_num * 2) {
+          if(round % 2 == 0) { always_assert(tree_p->Insert(key, key) == true); }
+          else { always_assert(tree_p->Delete(key) == true); }
+        }
+      }
+    });
+  }
+
+  for(int i = 0;i < round_num;i++) {
+    uint64_t snapshot = tree_p->CreateSnapshot();
+    std::vector<KeyValuePairType> first{};
+    tree_p->Scan(0, key_num * 2, &first, snapshot);
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    std::map<int, int> expected{first.begin(), first.end()};
+    int even_count = 0;
+    for(const KeyValuePairType &item : first) {
+      always_assert(item.first == item.second);
+      even_count += item.first % 2 == 0;
+    }
+    always_assert(even_count == key_num);
+    CheckSnapshot(tree_p, snapshot, expected);
+    tree_p->ReleaseSnapshot(snapshot);
+    test_printf("Snapshot %d: %lu items\n", i, first.size());
+  }
+
+  stop.store(true);
+  for(std::thread &t : thread_list) { t.join(); }
+  always_assert(tree_p->Verify() == true);
+  delete tree_p;
+  return;
+} END_TEST
+
+BEGIN_DEBUG_TEST(BwTreeShardedTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using ShardedTreeType = ShardedBwTree<TreeType>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  constexpr int thread_num = 4;
+  constexpr int key_num = 20000;
+
+  ShardedTreeType hash_tree{4};
+  ShardedTreeType range_tree{std::vector<int>{key_num / 4, key_num / 2, key_num * 3 / 4}};
+  for(ShardedTreeType *tree_p : {&hash_tree, &range_tree}) {
+    // Each thread inserts its keys, and then deletes multiples of 3
+    std::vector<std::thread> thread_list{};
+    for(int i = 0;i < thread_num;i++) {
+      thread_list.emplace_back([tree_p, i]() {
+        for(int key = i;key < key_num;key += thread_num) { always_assert(tree_p->Insert(key, key) == true); }
+        for(int key = i;key < key_num;key += thread_num) { 
+          if(key % 3 == 0) { always_assert(tree_p->Delete(key) == true); }
+        }
+      });
+    }
+    for(std::thread &t : thread_list) { t.join(); }
+
+    for(int key = 0;key < key_num;key++) {
+      int value = -1;
+      always_assert(tree_p->GetValue(key, &value) == (key % 3 != 0));
+      always_assert(key % 3 == 0 || value == key);
+    }
+
+    // Scans within a shard, across shards, and past the end
+    for(int start_key : {0, key_num / 4 - 10, key_num / 2 + 1, key_num - 5}) {
+      std::vector<KeyValuePairType> result{};
+      size_t copied = tree_p->Scan(start_key, 1000, &result);
+      always_assert(copied == result.size());
+      int expected_key = start_key;
+      for(const KeyValuePairType &item : result) {
+        while(expected_key % 3 == 0) { expected_key++; }
+        always_assert(item.first == expected_key && item.second == expected_key);
+        expected_key++;
+      }
+      while(expected_key % 3 == 0) { expected_key++; }
+      always_assert(copied == 1000 || expected_key >= key_num);
+    }
+
+    for(size_t i = 0;i < tree_p->GetShardNum();i++) { 
+      test_printf("Shard %lu: %lu slots\n", i, tree_p->GetShard(i)->GetMappingTable()->GetNextSlot()); 
+    }
+    always_assert(tree_p->Verify() == true);
+  }
+
+  always_assert(range_tree.GetShardIndex(0) == 0 && range_tree.GetShardIndex(key_num / 4) == 1);
+  always_assert(range_tree.GetShardIndex(key_num) == 3);
+  return;
+} END_TEST
+
+/*
+ * BwTreeStridedTest() - Tests the strided mapping table layout
+ * 
+ * 1. The layout is a permutation of slots, with and without a partial stride
+ * 2. Consecutive IDs in a full stride are on different cache lines
+ * 3. Concurrent inserts and deletes on a tree using the strided table
+ */
+BEGIN_DEBUG_TEST(BwTreeStridedTest) {
+  constexpr size_t line_size = StridedSlotLayout::SLOTS_PER_LINE;
+  for(size_t table_size : {line_size * 125, line_size * 125 + 3, line_size - 1}) {
+    std::vector<bool> used(table_size, false);
+    for(size_t i = 0;i < table_size;i++) {
+      size_t slot = StridedSlotLayout::GetSlot(i, table_size);
+      always_assert(slot < table_size && used[slot] == false);
+      used[slot] = true;
+      if(i + 1 < table_size / line_size * line_size) {
+        always_assert(slot / line_size != StridedSlotLayout::GetSlot(i + 1, table_size) / line_size);
+      }
+    }
+  }
+
+  using TreeType = BwTree<int, int, StridedMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  constexpr int key_num = 100000;
+  constexpr int thread_num = 4;
+  TreeType *tree_p = new TreeType{};
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = i;key < key_num;key += thread_num) { always_assert(tree_p->Insert(key, key + 1) == true); }
+      // Each thread only deletes its own keys, which are inserted before
+      for(int key = i;key < key_num;key += thread_num * 2) { always_assert(tree_p->Delete(key) == true); }
+    });
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+
+  for(int i = 0;i < key_num;i++) {
+    int value = -1;
+    bool ret = tree_p->GetValue(i, &value);
+    always_assert(ret == (i % (thread_num * 2) >= thread_num));
+    always_assert(ret == false || value == i + 1);
+  }
+  std::vector<std::pair<int, int>> result{};
+  always_assert(tree_p->Scan(0, key_num, &result) == key_num / 2);
+  always_assert(tree_p->Verify() == true);
+  test_printf("Strided table: %lu slots\n", tree_p->GetMappingTable()->GetNextSlot());
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeHTMTest() - Tests splits with and without the RTM path
+ * 
+ * 1. CASMulti() swaps all slots or none, and fails without RTM
+ * 2. Concurrent inserts with RTM enabled if supported. Every split is either
+ *    posted by RTM or by the multi-step protocol
+ */
+BEGIN_DEBUG_TEST(BwTreeHTMTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using NodeBaseType = typename TreeType::NodeBaseType;
+  using StatisticsType = typename TreeType::Statistics;
+  test_printf("RTM supported: %d\n", HTMIsSupported());
+  TreeType *tree_p = new TreeType{};
+  always_assert(tree_p->IsHTMEnabled() == HTMIsSupported());
+  typename TreeType::MappingTableType *table_p = tree_p->GetMappingTable();
+  NodeBaseType *node_list[2] = {reinterpret_cast<NodeBaseType *>(0x10), reinterpret_cast<NodeBaseType *>(0x20)};
+  NodeIDType id_list[2] = {table_p->AllocateNodeID(node_list[0]), table_p->AllocateNodeID(node_list[1])};
+  NodeBaseType *new_list[2] = {reinterpret_cast<NodeBaseType *>(0x30), reinterpret_cast<NodeBaseType *>(0x40)};
+  NodeBaseType *stale_list[2] = {node_list[0], new_list[0]};
+  always_assert(table_p->CASMulti(2, id_list, stale_list, new_list) == false);
+  always_assert(table_p->At(id_list[0]) == node_list[0] && table_p->At(id_list[1]) == node_list[1]);
+  always_assert(table_p->CASMulti(2, id_list, node_list, new_list) == HTMIsSupported());
+  table_p->ReleaseNodeID(id_list[0]);
+  table_p->ReleaseNodeID(id_list[1]);
+
+  constexpr int key_num = 200000;
+  constexpr int thread_num = 4;
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = i;key < key_num;key += thread_num) { always_assert(tree_p->Insert(key, key) == true); }
+    });
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+
+  StatisticsType stat = tree_p->GetStatistics();
+  test_printf("Splits %lu, by RTM %lu\n", stat.GetCounter(TreeType::StatSplit), stat.GetCounter(TreeType::StatSplitHTM));
+  always_assert(stat.GetCounter(TreeType::StatSplit) > 0);
+  always_assert(HTMIsSupported() || stat.GetCounter(TreeType::StatSplitHTM) == 0);
+  std::vector<std::pair<int, int>> result{};
+  always_assert(tree_p->Scan(0, key_num, &result) == key_num);
+  for(int i = 0;i < key_num;i++) { always_assert(result[i].first == i); }
+  always_assert(tree_p->Verify() == true);
+  always_assert(tree_p->SetHTMEnabled(false) == false && tree_p->IsHTMEnabled() == false);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeThreadContextTest() - Tests operations with registered thread contexts
+ * 
+ * 1. Registered contexts have distinct indices, which are reused after unregistering
+ * 2. Concurrent operations with contexts, mixed with operations without one
+ * 3. Counters updated through contexts sum up to the tree state
+ */
+BEGIN_DEBUG_TEST(BwTreeThreadContextTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using ThreadContextType = typename TreeType::ThreadContext;
+  constexpr int key_num = 100000;
+  constexpr int thread_num = 4;
+  TreeType *tree_p = new TreeType{};
+
+  ThreadContextType *context_list[thread_num];
+  std::set<size_t> index_set{};
+  for(int i = 0;i < thread_num;i++) {
+    context_list[i] = tree_p->RegisterThread();
+    always_assert(context_list[i]->GetThreadIndex() != ThreadIndex::Get());
+    always_assert(index_set.insert(context_list[i]->GetThreadIndex()).second == true);
+  }
+  size_t last_index = context_list[thread_num - 1]->GetThreadIndex();
+  tree_p->UnregisterThread(context_list[thread_num - 1]);
+  context_list[thread_num - 1] = tree_p->RegisterThread();
+  always_assert(context_list[thread_num - 1]->GetThreadIndex() == last_index);
+
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i, &context_list]() {
+      // Odd threads only use the context for updates
+      ThreadContextType *thread_p = context_list[i];
+      ThreadContextType *read_thread_p = i % 2 == 0 ? thread_p : nullptr;
+      for(int key = i;key < key_num;key += thread_num) { always_assert(tree_p->Insert(key, key + 1, thread_p) == true); }
+      for(int key = i;key < key_num;key += thread_num * 2) { always_assert(tree_p->Delete(key, thread_p) == true); }
+      for(int key = i;key < key_num;key += thread_num) {
+        int value = -1;
+        bool ret = tree_p->GetValue(key, &value, read_thread_p);
+        always_assert(ret == ((key / thread_num) % 2 == 1) && (ret == false || value == key + 1));
+      }
+    });
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+  for(int i = 0;i < thread_num;i++) { tree_p->UnregisterThread(context_list[i]); }
+
+  std::vector<std::pair<int, int>> result{};
+  always_assert(tree_p->Scan(0, key_num, &result) == key_num / 2);
+  always_assert(tree_p->Verify() == true);
+  typename TreeType::Statistics stat = tree_p->GetStatistics();
+  test_printf("Splits %lu, consolidations %lu\n", 
+              stat.GetCounter(TreeType::StatSplit), stat.GetCounter(TreeType::StatConsolidation));
+  uint64_t node_count = 0;
+  for(const typename TreeType::Statistics::LevelStatistics &level : stat.level_list) { node_count += level.node_count; }
+  always_assert(stat.GetCounter(TreeType::StatSplit) + stat.level_list.size() == node_count);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeDeleteRangeTest() - Tests range delete deltas
+ * 
+ * 1. Keys in the range are deleted, and keys outside it are kept
+ * 2. Keys can be inserted again into a deleted range
+ * 3. A snapshot taken before the range delete still sees the keys
+ * 4. Range deletes run concurrently with inserts outside the range
+ * 5. Range deletes are logged and replayed
+ * 6. Leaves covered by the range are dropped, and their memory is reclaimed by GC
+ */
+BEGIN_DEBUG_TEST(BwTreeDeleteRangeTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  const std::string log_path = "/tmp/bwtree-delete-range-test.log";
+  const std::string missing_path = "/tmp/bwtree-delete-range-test-missing.bin";
+  constexpr int key_num = 20000;
+  constexpr int thread_num = 4;
+  remove(log_path.c_str());
+
+  TreeType *tree_p = new TreeType{};
+  std::map<int, int> current{};
+  // Only even keys exist, such that range bounds fall between keys
+  for(int key = 0;key < key_num;key += 2) { tree_p->Insert(key, key); current[key] = key; }
+  uint64_t snapshot = tree_p->CreateSnapshot();
+  std::map<int, int> expected = current;
+  always_assert(tree_p->DeleteRange(key_num / 4 + 1, key_num / 2 + 1) == static_cast<size_t>(key_num / 8));
+  current.erase(current.lower_bound(key_num / 4 + 1), current.lower_bound(key_num / 2 + 1));
+  always_assert(tree_p->DeleteRange(key_num / 4, key_num / 2) == 1);
+  current.erase(key_num / 4);
+  always_assert(tree_p->DeleteRange(key_num / 4, key_num / 2) == 0);
+  always_assert(tree_p->DeleteRange(key_num / 2, key_num / 4) == 0);
+  for(int key = 0;key < key_num;key++) {
+    int value = -1;
+    bool found = tree_p->GetValue(key, &value);
+    always_assert(found == (current.count(key) == 1) && (found == false || value == key));
+    found = tree_p->GetValue(key, &value, snapshot);
+    always_assert(found == (expected.count(key) == 1) && (found == false || value == key));
+  }
+  std::vector<KeyValuePairType> result{};
+  tree_p->Scan(0, key_num, &result);
+  always_assert(result == std::vector<KeyValuePairType>(current.begin(), current.end()));
+  result.clear();
+  tree_p->Scan(0, key_num, &result, snapshot);
+  always_assert(result == std::vector<KeyValuePairType>(expected.begin(), expected.end()));
+
+  // Keys inserted after the delete are visible. Inserts also consolidate the leaves
+  for(int key = key_num / 4;key < key_num / 2;key += 3) { 
+    always_assert(tree_p->Insert(key, -key) == true); 
+    current[key] = -key;
+  }
+  result.clear();
+  tree_p->Scan(0, key_num, &result);
+  always_assert(result == std::vector<KeyValuePairType>(current.begin(), current.end()));
+  result.clear();
+  tree_p->Scan(0, key_num, &result, snapshot);
+  always_assert(result == std::vector<KeyValuePairType>(expected.begin(), expected.end()));
+  tree_p->ReleaseSnapshot(snapshot);
+  always_assert(tree_p->Verify() == true);
+  delete tree_p;
+
+  // Writers insert odd keys while the even keys in the middle are deleted in small ranges
+  WriteAheadLog::Config config{};
+  config.flush_interval_us = 100;
+  config.sync_mode = WriteAheadLog::SyncMode::None;
+  tree_p = new TreeType{};
+  always_assert(tree_p->EnableLog(log_path, config) == true);
+  for(int key = 0;key < key_num;key += 2) { tree_p->Insert(key, key); }
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = i * 2 + 1;key < key_num;key += thread_num * 2) { always_assert(tree_p->Insert(key, key) == true); }
+    });
+  }
+  size_t deleted = 0;
+  for(int key = key_num / 4;key < key_num / 4 * 3;key += 100) {
+    // Only even keys are deleted, since odd keys may or may not have been inserted
+    for(int even_key = key;even_key < key + 100;even_key += 2) { deleted += tree_p->DeleteRange(even_key, even_key + 1); }
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+  tree_p->DisableLog();
+  always_assert(deleted == static_cast<size_t>(key_num / 4));
+  result.clear();
+  tree_p->Scan(0, key_num, &result);
+  always_assert(result.size() == static_cast<size_t>(key_num / 4 * 3));
+  for(const KeyValuePairType &item : result) { 
+    always_assert(item.first % 2 == 1 || item.first < key_num / 4 || item.first >= key_num / 4 * 3); 
+  }
+  always_assert(tree_p->Verify() == true);
+
+  TreeType *recover_tree_p = new TreeType{};
+  always_assert(recover_tree_p->Recover(missing_path, log_path) == true);
+  std::vector<KeyValuePairType> recover_result{};
+  recover_tree_p->Scan(0, key_num, &recover_result);
+  always_assert(result == recover_result);
+  delete recover_tree_p;
+  delete tree_p;
+  remove(log_path.c_str());
+
+  tree_p = new TreeType{};
+  for(int key = 0;key < key_num * 4;key++) { tree_p->Insert(key, key); }
+  tree_p->PerformGC();
+  tree_p->PerformGC();
+  typename TreeType::MemoryUsage usage = tree_p->GetMemoryUsage();
+  always_assert(tree_p->DeleteRange(key_num, key_num * 3) == static_cast<size_t>(key_num * 2));
+  typename TreeType::Statistics stat = tree_p->GetStatistics();
+  always_assert(stat.GetCounter(TreeType::StatLeafEmptied) > 0);
+  // At least the items of deleted keys are no longer in base nodes
+  always_assert(tree_p->GetMemoryUsage().base_node + key_num * 2 * sizeof(int) * 2 <= usage.base_node);
+  always_assert(tree_p->GetMemoryUsage().gc_backlog > 0);
+  tree_p->PerformGC();
+  tree_p->PerformGC();
+  always_assert(tree_p->GetMemoryUsage().gc_backlog == 0);
+  always_assert(tree_p->GetMemoryUsage().GetTotal() < usage.GetTotal());
+  result.clear();
+  tree_p->Scan(0, key_num * 4, &result);
+  always_assert(result.size() == static_cast<size_t>(key_num * 2));
+  always_assert(result[key_num - 1].first == key_num - 1 && result[key_num].first == key_num * 3);
+  // Dropped leaves still accept inserts
+  for(int key = key_num;key < key_num * 3;key += 7) { always_assert(tree_p->Insert(key, key) == true); }
+  always_assert(tree_p->Verify() == true);
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeExportTest() - Tests ordered export with parallel leaf consolidation
+ * 
+ * 1. The export equals a scan of the whole tree for any number of threads,
+ *    including on a tree with a single leaf and on leaves with deltas
+ * 2. While writers insert odd keys, the export is in key order and contains
+ *    all even keys
+ */
+BEGIN_DEBUG_TEST(BwTreeExportTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  constexpr int key_num = 100000;
+  constexpr int thread_num = 4;
+  TreeType *tree_p = new TreeType{};
+
+  std::vector<KeyValuePairType> result{}, export_result{};
+  tree_p->ExportSorted(&export_result, thread_num);
+  always_assert(export_result.empty() == true);
+  for(int key = 0;key < 10;key++) { tree_p->Insert(key, key); }
+  tree_p->ExportSorted(&export_result, thread_num);
+  always_assert(export_result.size() == 10);
+
+  for(int key = 10;key < key_num;key += 2) { tree_p->Insert(key, key); }
+  for(int key = 10;key < key_num;key += 6) { tree_p->Delete(key); }
+  tree_p->Scan(0, key_num, &result);
+  for(size_t export_thread_num : {1, 2, 4, 7}) {
+    export_result.clear();
+    tree_p->ExportSorted(&export_result, export_thread_num);
+    always_assert(result == export_result);
+  }
+  // The callback receives the pairs in order, one partition at a time
+  size_t call_count = 0;
+  export_result.clear();
+  tree_p->ExportSorted([&call_count, &export_result](const KeyValuePairType *item_list, size_t count) {
+    always_assert(count > 0);
+    export_result.insert(export_result.end(), item_list, item_list + count);
+    call_count++;
+  }, thread_num);
+  always_assert(result == export_result && call_count > 1 && call_count <= thread_num * TreeType::EXPORT_PARTITION_PER_THREAD);
+  test_printf("Exported %lu pairs in %lu calls\n", export_result.size(), call_count);
+
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = key_num + i * 2 + 1;key < key_num * 2;key += thread_num * 2) { tree_p->Insert(key, key); }
+      for(int key = i * 2 + 11;key < key_num;key += thread_num * 2) { tree_p->Insert(key, key); }
+    });
+  }
+  size_t expected_even_count = 0;
+  for(const KeyValuePairType &item : result) { expected_even_count += item.first % 2 == 0; }
+  for(int i = 0;i < 4;i++) {
+    export_result.clear();
+    tree_p->ExportSorted(&export_result, thread_num);
+    for(size_t j = 1;j < export_result.size();j++) { always_assert(export_result[j - 1].first < export_result[j].first); }
+    size_t even_count = 0;
+    for(const KeyValuePairType &item : export_result) { even_count += item.first % 2 == 0; }
+    always_assert(even_count == expected_even_count);
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+  always_assert(tree_p->Verify() == true);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeParallelScanTest() - Tests parallel range scans with work stealing
+ * 
+ * 1. Counts, sums and the ordered key list of ranges equal those of a scan, for
+ *    any number of threads and for ranges within one leaf or across the tree
+ * 2. Threads that finish early steal chunks from a slow thread
+ */
+BEGIN_DEBUG_TEST(BwTreeParallelScanTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  using CountSumType = std::pair<size_t, int64_t>;
+  constexpr int key_num = 100000;
+  TreeType *tree_p = new TreeType{};
+  for(int key = 0;key < key_num;key++) { tree_p->Insert(key, key); }
+  for(int key = 0;key < key_num;key += 3) { tree_p->Delete(key); }
+
+  auto add = [](CountSumType *result_p, const int &, const int &value) { result_p->first++; result_p->second += value; };
+  auto reduce = [](CountSumType *result_p, const CountSumType &other) { 
+    result_p->first += other.first; 
+    result_p->second += other.second; 
+  };
+  std::vector<std::pair<int, int>> range_list{{0, key_num}, {-100, key_num * 2}, {5000, 5010}, {1234, 98765}, {10, 10}, {20, 10}};
+  for(const std::pair<int, int> &range : range_list) {
+    std::vector<KeyValuePairType> result{};
+    tree_p->Scan(range.first, key_num, &result);
+    CountSumType expected{0, 0};
+    for(const KeyValuePairType &item : result) { if(item.first < range.second) { add(&expected, item.first, item.second); } }
+    for(size_t thread_num : {1, 2, 4, 7}) {
+      CountSumType actual = tree_p->ParallelScan(range.first, range.second, CountSumType{0, 0}, add, reduce, thread_num);
+      always_assert(actual == expected);
+    }
+  }
+
+  // Chunk results are reduced in key order
+  std::vector<int> key_list = tree_p->ParallelScan(100, key_num - 100, std::vector<int>{}, 
+    [](std::vector<int> *list_p, const int &key, const int &) { list_p->push_back(key); },
+    [](std::vector<int> *list_p, const std::vector<int> &other) { list_p->insert(list_p->end(), other.begin(), other.end()); }, 4);
+  std::vector<KeyValuePairType> result{};
+  tree_p->Scan(100, key_num, &result);
+  while(result.empty() == false && result.back().first >= key_num - 100) { result.pop_back(); }
+  always_assert(key_list.size() == result.size());
+  for(size_t i = 0;i < result.size();i++) { always_assert(key_list[i] == result[i].first); }
+
+  // Keys at the front of the range are slow, so the other threads take chunks of the first thread
+  CountSumType slow_result = tree_p->ParallelScan(0, key_num, CountSumType{0, 0}, 
+    [&add](CountSumType *result_p, const int &key, const int &value) {
+      if(key < key_num / 8) { std::this_thread::sleep_for(std::chrono::microseconds{5}); }
+      add(result_p, key, value);
+    }, reduce, 4);
+  always_assert(slow_result.first == static_cast<size_t>(key_num - (key_num + 2) / 3));
+  typename TreeType::Statistics stat = tree_p->GetStatistics();
+  test_printf("Scan steals %lu\n", stat.GetCounter(TreeType::StatScanSteal));
+  always_assert(stat.GetCounter(TreeType::StatScanSteal) > 0);
+
+  delete tree_p;
+  return;
+} END_TEST
+
+/*
+ * BwTreeScanAggregateTest() - Tests scans with a predicate and an aggregator
+ * 
+ * 1. Counts and sums with a value filter equal those of a scan, on leaves that
+ *    are base nodes and on leaves with insert, delete and range delete deltas
+ * 2. Vectorized key counts equal scalar counts for integral types of all sizes
+ */
+BEGIN_DEBUG_TEST(BwTreeScanAggregateTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  constexpr int key_num = 50000;
+  TreeType *tree_p = new TreeType{};
+
+  // * Check() - Compares the count and sum of odd values in ranges with a scan
+  auto Check = [tree_p, key_num]() {
+    std::vector<std::pair<int, int>> range_list{{0, key_num}, {-5, key_num * 2}, {100, 101}, {777, 31234}, {5, 5}};
+    for(const std::pair<int, int> &range : range_list) {
+      std::vector<KeyValuePairType> result{};
+      tree_p->Scan(range.first, key_num * 2, &result);
+      size_t expected_count = 0;
+      int64_t expected_sum = 0;
+      for(const KeyValuePairType &item : result) { 
+        if(item.first < range.second && item.second % 2 == 1) { expected_count++; expected_sum += item.second; }
+      }
+      int64_t sum = 0;
+      size_t count = tree_p->ScanAggregate(range.first, range.second, 
+        [](const int &, const int &value) { return value % 2 == 1; },
+        [&sum](const int &, const int &value) { sum += value; });
+      always_assert(count == expected_count && sum == expected_sum);
+    }
+  };
+
+  // Leaves built by bulk load are base nodes
+  std::vector<KeyValuePairType> item_list{};
+  for(int key = 0;key < key_num;key++) { item_list.emplace_back(key, key * 3); }
+  always_assert(tree_p->BulkLoad(item_list) == true);
+  Check();
+  // Deltas on top of the base nodes, including range deletes
+  for(int key = 0;key < key_num;key += 7) { tree_p->Delete(key); }
+  for(int key = key_num;key < key_num + 1000;key += 3) { tree_p->Insert(key, key); }
+  tree_p->DeleteRange(1000, 1500);
+  tree_p->DeleteRange(20003, 20011);
+  Check();
+  always_assert(tree_p->Verify() == true);
+  delete tree_p;
+
+  std::mt19937_64 generator{1};
+  for(size_t num : {0, 1, 31, 32, 33, 100, 5000}) {
+    std::vector<int8_t> int8_list(num);
+    std::vector<uint16_t> uint16_list(num);
+    std::vector<int32_t> int32_list(num);
+    std::vector<uint64_t> uint64_list(num);
+    for(size_t i = 0;i < num;i++) {
+      int8_list[i] = static_cast<int8_t>(generator());
+      uint16_list[i] = static_cast<uint16_t>(generator());
+      int32_list[i] = static_cast<int32_t>(generator());
+      uint64_list[i] = generator();
+    }
+    for(int i = 0;i < 16;i++) {
+      uint64_t key = generator();
+      always_assert(CountLess(int8_list.data(), num, static_cast<int8_t>(key)) == CountLessScalar(int8_list.data(), num, static_cast<int8_t>(key)));
+      always_assert(CountLess(uint16_list.data(), num, static_cast<uint16_t>(key)) == CountLessScalar(uint16_list.data(), num, static_cast<uint16_t>(key)));
+      always_assert(CountLess(int32_list.data(), num, static_cast<int32_t>(key)) == CountLessScalar(int32_list.data(), num, static_cast<int32_t>(key)));
+      always_assert(CountLess(uint64_list.data(), num, key) == CountLessScalar(uint64_list.data(), num, key));
+    }
+  }
+
+  return;
+} END_TEST
+
+/*
+ * BwTreeReverseScanTest() - Tests scans in descending key order
+ * 
+ * 1. Results equal a reversed forward scan for start keys inside, between, 
+ *    below and above the keys, and from the maximum key, on leaves with deltas
+ * 2. Most leaves on the left are found in the cached parent without a descent
+ * 3. While writers insert odd keys, the scan is in descending order and 
+ *    contains all even keys
+ */
+BEGIN_DEBUG_TEST(BwTreeReverseScanTest) {
+  using TreeType = BwTree<int, int, DefaultMappingTable, DefaultDeltaChainType, DefaultBaseNode, DefaultConsolidator>;
+  using KeyValuePairType = typename TreeType::KeyValuePairType;
+  constexpr int key_num = 100000;
+  constexpr int thread_num = 4;
+  TreeType *tree_p = new TreeType{};
+
+  std::vector<KeyValuePairType> result{}, reverse_result{};
+  always_assert(tree_p->ReverseScan(10, &reverse_result) == 0);
+  for(int key = 0;key < key_num;key += 2) { tree_p->Insert(key, key); }
+  for(int key = 0;key < key_num;key += 10) { tree_p->Delete(key); }
+  tree_p->DeleteRange(30000, 32000);
+  tree_p->Scan(-1, key_num, &result);
+
+  for(int start_key : {-1, 0, 2, 1001, 1002, 31000, 32002, key_num - 2, key_num * 2}) {
+    std::vector<KeyValuePairType> expected{};
+    for(const KeyValuePairType &item : result) { if(item.first <= start_key) { expected.push_back(item); } }
+    std::reverse(expected.begin(), expected.end());
+    for(size_t count : {size_t{1}, size_t{100}, size_t{key_num}}) {
+      reverse_result.clear();
+      size_t copied = tree_p->ReverseScan(start_key, count, &reverse_result);
+      always_assert(copied == std::min(count, expected.size()) && copied == reverse_result.size());
+      always_assert(std::equal(reverse_result.begin(), reverse_result.end(), expected.begin()));
+    }
+  }
+  // The latest pairs are those with the largest keys
+  size_t descent_count = tree_p->GetStatistics().GetCounter(TreeType::StatReverseDescent);
+  reverse_result.clear();
+  always_assert(tree_p->ReverseScan(key_num, &reverse_result) == result.size());
+  always_assert(std::equal(reverse_result.begin(), reverse_result.end(), result.rbegin()));
+  descent_count = tree_p->GetStatistics().GetCounter(TreeType::StatReverseDescent) - descent_count;
+  test_printf("Reverse descents %lu\n", descent_count);
+  always_assert(descent_count < result.size() / 1000);
+
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([tree_p, i]() {
+      for(int key = i * 2 + 1;key < key_num;key += thread_num * 2) { tree_p->Insert(key, key); }
+    });
+  }
+  for(int i = 0;i < 4;i++) {
+    reverse_result.clear();
+    tree_p->ReverseScan(key_num * 2, &reverse_result);
+    for(size_t j = 1;j < reverse_result.size();j++) { always_assert(reverse_result[j - 1].first > reverse_result[j].first); }
+    size_t even_count = 0;
+    for(const KeyValuePairType &item : reverse_result) { even_count += item.first % 2 == 0; }
+    always_assert(even_count == result.size());
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+  reverse_result.clear();
+  always_assert(tree_p->ReverseScan(key_num * 2, &reverse_result) == result.size() + key_num / 2);
+  always_assert(tree_p->Verify() == true);
+
+  delete tree_p;
+  return;
+} END_TEST
+
 int main() {
-  //MappingTableTest();
+  MappingTableTest();
   //BoundKeyTest();
   //BaseNodeTest();
   DeltaNodeTest();
   AppendTest();
   LeafConsolidationTest();
   InnerConsolidationTest();
+  BwTreeBasicTest();
+  BwTreeMultiThreadTest();
+  LatencyRecorderTest();
+  BwTreeStatisticsTest();
+  BwTreeMemoryUsageTest();
+  BwTreeAnalyzeTest();
+  BwTreeHugePageTest();
+  BwTreeCheckpointTest();
+  BwTreeResidentLoadTest();
+  BwTreeLogTest();
+  BwTreeIncrementalCheckpointTest();
+  BwTreeFuzzyCheckpointTest();
+  BwTreeSnapshotTest();
+  BwTreeShardedTest();
+  BwTreeStridedTest();
+  BwTreeHTMTest();
+  BwTreeThreadContextTest();
+  BwTreeDeleteRangeTest();
+  BwTreeExportTest();
+  BwTreeParallelScanTest();
+  BwTreeScanAggregateTest();
+  BwTreeReverseScanTest();
 
   return 0;
 }
\ No newline at end of file
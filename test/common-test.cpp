@@ -1,10 +1,19 @@
 
 #include "common.h"
 #include "test-util.h"
+#include "latency-histogram.h"
+#include "perf-counter.h"
+#include "huge-page.h"
+#include "wal.h"
+#include <thread>
+#include <chrono>
 // We use fork() to test whether err printing works
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/wait.h>
+// The file size limit is used to fail writes of the log
+#include <sys/resource.h>
+#include <signal.h>
 
 using namespace wangziqi2013;
 using namespace index_building_block;
@@ -72,10 +81,270 @@ BEGIN_TEST(TestAlwaysAssert) {
   return;
 } END_TEST
 
+/*
+ * TestLatencyHistogram() - Tests bucketing, percentiles and merging
+ */
+BEGIN_TEST(TestLatencyHistogram) {
+  // Values below the sub-bucket count are exact, and larger values fall into
+  // a bucket whose lower bound is within the relative error
+  for(uint64_t value = 0;value < 1000000;value = value * 3 / 2 + 1) {
+    size_t index = LatencyHistogram::GetIndex(value);
+    always_assert(LatencyHistogram::GetLowerBound(index) <= value);
+    always_assert(LatencyHistogram::GetLowerBound(index + 1) > value);
+    if(value < LatencyHistogram::SUB_BUCKET_COUNT) { always_assert(LatencyHistogram::GetLowerBound(index) == value); }
+  }
+
+  LatencyHistogram h1{}, h2{};
+  for(uint64_t i = 1;i <= 1000;i++) { h1.Record(i); }
+  for(uint64_t i = 1001;i <= 2000;i++) { h2.Record(i); }
+  always_assert(h1.GetPercentile(50.0) <= 500 && h1.GetPercentile(50.0) >= 500 - 500 / 32);
+  h1.Merge(h2);
+  always_assert(h1.GetCount() == 2000 && h1.GetMin() == 1 && h1.GetMax() == 2000);
+  always_assert(h1.GetPercentile(100.0) == 2000);
+  always_assert(h1.GetPercentile(99.0) >= 1980 - 1980 / 32 && h1.GetPercentile(99.0) <= 1980);
+  test_printf("p50 = %lu p99 = %lu p99.9 = %lu\n", h1.GetPercentile(50.0), h1.GetPercentile(99.0), h1.GetPercentile(99.9));
+
+  h1.Reset();
+  always_assert(h1.GetCount() == 0 && h1.GetPercentile(50.0) == 0);
+
+  return;
+} END_TEST
+
+/*
+ * TestPerfCounter() - Tests hardware event counters
+ * 
+ * Counters may not be available in the test environment, in which case they
+ * must read as 0 without failing
+ */
+BEGIN_TEST(TestPerfCounter) {
+  PerfCounter disabled{false};
+  disabled.Start();
+  disabled.Stop();
+  always_assert(disabled.Read().IsAnyAvailable() == false);
+
+  PerfCounter perf{};
+  uint64_t sum = 0;
+  perf.Start();
+  for(uint64_t i = 0;i < 1000000;i++) { sum += i * i; }
+  perf.Stop();
+  PerfCounter::Result result = perf.Read();
+  always_assert(sum != 0);
+  if(result.IsAvailable(PerfCounter::Instructions)) { always_assert(result.Get(PerfCounter::Instructions) > 0); }
+  result.Print(stderr, 1000000);
+  fputc('\n', stderr);
+
+  PerfCounter::Result merged{};
+  merged.Merge(result);
+  merged.Merge(result);
+  for(size_t i = 0;i < PerfCounter::EVENT_COUNT;i++) {
+    PerfCounter::Event event = static_cast<PerfCounter::Event>(i);
+    always_assert(merged.IsAvailable(event) == result.IsAvailable(event));
+    always_assert(merged.Get(event) == result.Get(event) * 2);
+  }
+
+  return;
+} END_TEST
+
+/*
+ * TestHugePage() - Tests huge page allocation and the huge page arena
+ */
+BEGIN_TEST(TestHugePage) {
+  size_t mapped = HugePageGetMappedBytes();
+  HugePageMode mode_list[] = {HugePageMode::None, HugePageMode::Transparent, HugePageMode::Explicit};
+  for(HugePageMode mode : mode_list) {
+    size_t size = HUGE_PAGE_SIZE + 100;
+    char *p = static_cast<char *>(HugePageAllocate(size, mode));
+    uintptr_t offset = reinterpret_cast<uintptr_t>(p) & (HUGE_PAGE_SIZE - 1);
+    always_assert(mode == HugePageMode::None || offset == 0);
+    always_assert(p[0] == 0 && p[size - 1] == 0);
+    memset(p, 0xAB, size);
+    always_assert(HugePageGetMappedBytes() > mapped);
+    HugePageFree(p, size, mode);
+    always_assert(HugePageGetMappedBytes() == mapped);
+  }
+
+  // Size classes cover every size, and blocks are not much larger than requested
+  using ArenaType = HugePageArena<HugePageMode::Transparent>;
+  size_t prev_class = 0;
+  for(size_t size = 1;size <= ArenaType::MAX_BLOCK_SIZE;size++) {
+    size_t size_class = ArenaType::GetClass(size);
+    always_assert(size_class < ArenaType::CLASS_COUNT && size_class >= prev_class);
+    always_assert(ArenaType::GetClassSize(size_class) >= size);
+    always_assert(ArenaType::GetClassSize(size_class) <= std::max<size_t>(size * 5 / 4 + 16, 16));
+    prev_class = size_class;
+  }
+
+  // Blocks do not overlap, and freed blocks are reused
+  std::vector<std::pair<char *, size_t>> block_list{};
+  for(size_t i = 0;i < 10000;i++) {
+    size_t size = (i * 7919) % 4096 + 1;
+    char *p = static_cast<char *>(ArenaType::Allocate(size));
+    always_assert((reinterpret_cast<uintptr_t>(p) & 15) == 0);
+    memset(p, static_cast<int>(i & 0xFF), size);
+    block_list.emplace_back(p, size);
+  }
+  for(size_t i = 0;i < block_list.size();i++) {
+    for(size_t j = 0;j < block_list[i].second;j++) { always_assert(block_list[i].first[j] == static_cast<char>(i & 0xFF)); }
+  }
+  char *last_p = block_list.back().first;
+  ArenaType::Free(last_p);
+  always_assert(ArenaType::Allocate(block_list.back().second) == last_p);
+  for(auto &block : block_list) { ArenaType::Free(block.first); }
+
+  // Large blocks are mapped individually
+  mapped = HugePageGetMappedBytes();
+  char *large_p = static_cast<char *>(ArenaType::Allocate(ArenaType::MAX_BLOCK_SIZE * 4));
+  memset(large_p, 0, ArenaType::MAX_BLOCK_SIZE * 4);
+  always_assert(HugePageGetMappedBytes() > mapped);
+  ArenaType::Free(large_p);
+  always_assert(HugePageGetMappedBytes() == mapped);
+
+  return;
+} END_TEST
+
+/*
+ * TestWriteAheadLog() - Tests group commit, replay and reopening of the log
+ * 
+ * 1. Records of concurrent threads are replayed in LSN order
+ * 2. Reopening continues the LSN, and a torn tail is dropped
+ * 3. A change is not reported durable before all changes with smaller LSNs,
+ *    even if it is written first
+ * 4. Groups that cannot be written are never reported durable
+ */
+BEGIN_TEST(TestWriteAheadLog) {
+  const std::string path = "/tmp/common-test-wal.bin";
+  constexpr int thread_num = 4;
+  constexpr uint64_t record_num = 2000;
+  remove(path.c_str());
+
+  WriteAheadLog::Config config{};
+  config.flush_interval_us = 200;
+  WriteAheadLog *log_p = new WriteAheadLog{};
+  always_assert(log_p->Open(path, config) == true);
+  std::vector<std::thread> thread_list{};
+  for(int i = 0;i < thread_num;i++) {
+    thread_list.emplace_back([log_p, i]() {
+      for(uint64_t j = 0;j < record_num;j++) {
+        uint64_t lsn = log_p->Begin();
+        if(j % 10 == 9) { log_p->Abort(); continue; }
+        uint64_t payload[2] = {lsn, static_cast<uint64_t>(i)};
+        uint64_t ticket = log_p->Commit(lsn, static_cast<uint32_t>(i), payload, j % 2 == 0 ? sizeof(payload) : sizeof(uint64_t));
+        if(j % 100 == 0) { log_p->WaitDurable(ticket); }
+      }
+    });
+  }
+  for(std::thread &t : thread_list) { t.join(); }
+  uint64_t replay_lsn = log_p->GetReplayLSN();
+  always_assert(replay_lsn == thread_num * record_num + 1);
+  log_p->Flush();
+  uint64_t committed = thread_num * (record_num - record_num / 10);
+  always_assert(log_p->GetRecordCount() == committed);
+  always_assert(log_p->GetGroupCount() > 0 && log_p->GetGroupCount() < committed);
+  always_assert(log_p->GetSyncCount() == log_p->GetGroupCount());
+  test_printf("%lu records in %lu groups\n", log_p->GetRecordCount(), log_p->GetGroupCount());
+  delete log_p;
+
+  size_t count = 0;
+  uint64_t prev_lsn = 0;
+  bool ret = WriteAheadLog::Replay(path, 0, [&prev_lsn](uint32_t type, const char *data_p, size_t size) {
+    uint64_t payload[2];
+    memcpy(payload, data_p, size);
+    always_assert(payload[0] > prev_lsn && type < thread_num);
+    always_assert(size == sizeof(uint64_t) || payload[1] == type);
+    prev_lsn = payload[0];
+  }, &count);
+  always_assert(ret == true && count == committed);
+  always_assert(WriteAheadLog::Replay(path, replay_lsn / 2, [](uint32_t, const char *, size_t) {}, &count) == true);
+  always_assert(count > 0 && count < committed);
+
+  // Reopening continues after the largest LSN
+  log_p = new WriteAheadLog{};
+  always_assert(log_p->Open(path, config) == true);
+  uint64_t lsn = log_p->Begin();
+  always_assert(lsn == prev_lsn + 1);
+  log_p->Commit(lsn, 0, &lsn, sizeof(lsn));
+  delete log_p;
+  always_assert(WriteAheadLog::Replay(path, lsn, [](uint32_t, const char *, size_t) {}, &count) == true && count == 1);
+
+  // A torn record at the end is ignored and then truncated
+  FILE *fp = fopen(path.c_str(), "ab");
+  uint64_t garbage[3] = {64, 12345, 0};
+  fwrite(garbage, 1, sizeof(garbage), fp);
+  fclose(fp);
+  always_assert(WriteAheadLog::Replay(path, 0, [](uint32_t, const char *, size_t) {}, &count) == true && count == committed + 1);
+  log_p = new WriteAheadLog{};
+  always_assert(log_p->Open(path, config) == true);
+  always_assert(log_p->Begin() == lsn + 1);
+  log_p->Abort();
+  delete log_p;
+  always_assert(WriteAheadLog::Replay(path, 0, [](uint32_t, const char *, size_t) {}, &count) == true && count == committed + 1);
+
+  // A change is not durable while a change with a smaller LSN has not committed
+  remove(path.c_str());
+  log_p = new WriteAheadLog{};
+  always_assert(log_p->Open(path, config) == true);
+  uint64_t pending_lsn = log_p->Begin();
+  std::atomic<bool> durable_flag{false};
+  std::thread writer{[log_p, &durable_flag]() {
+    uint64_t writer_lsn = log_p->Begin();
+    always_assert(log_p->WaitDurable(log_p->Commit(writer_lsn, 0, &writer_lsn, sizeof(writer_lsn))) == true);
+    durable_flag.store(true);
+  }};
+  // Many groups are written while the change is pending
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  always_assert(log_p->Flush() == true && durable_flag.load() == false);
+  always_assert(log_p->WaitDurable(log_p->Commit(pending_lsn, 0, &pending_lsn, sizeof(pending_lsn))) == true);
+  writer.join();
+  always_assert(durable_flag.load() == true);
+  delete log_p;
+
+  // Writes beyond the file size limit fail. The log fails, and later groups are not written either
+  remove(path.c_str());
+  log_p = new WriteAheadLog{};
+  always_assert(log_p->Open(path, config) == true);
+  struct rlimit old_limit{};
+  always_assert(getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = 4096;
+  signal(SIGXFSZ, SIG_IGN);
+  always_assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  std::vector<char> large_payload(limit.rlim_cur * 2, 1);
+  lsn = log_p->Begin();
+  uint64_t ticket = log_p->Commit(lsn, 0, large_payload.data(), large_payload.size());
+  bool durable = log_p->WaitDurable(ticket);
+  always_assert(durable == false && log_p->IsFailed() == true);
+  lsn = log_p->Begin();
+  ticket = log_p->Commit(lsn, 0, &lsn, sizeof(lsn));
+  durable = log_p->WaitDurable(ticket);
+  always_assert(durable == false && log_p->Flush() == false);
+  always_assert(setrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+  signal(SIGXFSZ, SIG_DFL);
+  delete log_p;
+  always_assert(WriteAheadLog::Replay(path, 0, [](uint32_t, const char *, size_t) {}, &count) == true && count == 0);
+
+  // Missing files have no records, and other files are rejected
+  always_assert(WriteAheadLog::Replay("/tmp/common-test-wal-missing.bin", 0, [](uint32_t, const char *, size_t) {}, &count) == true);
+  always_assert(count == 0);
+  fp = fopen(path.c_str(), "wb");
+  fwrite(garbage, 1, sizeof(garbage), fp);
+  fclose(fp);
+  always_assert(WriteAheadLog::Replay(path, 0, [](uint32_t, const char *, size_t) {}) == false);
+  log_p = new WriteAheadLog{};
+  always_assert(log_p->Open(path, config) == false);
+  delete log_p;
+
+  remove(path.c_str());
+  return;
+} END_TEST
+
 int main() {
   TestDebugPrint();
   TestErrorPrint();
   TestAlwaysAssert();
+  TestLatencyHistogram();
+  TestPerfCounter();
+  TestHugePage();
+  TestWriteAheadLog();
 
   return 0;
 }
\ No newline at end of file